@@ -33,13 +33,20 @@
 #ifndef VELODYNE_DRIVER_DRIVER_H
 #define VELODYNE_DRIVER_DRIVER_H
 
+#include <atomic>
 #include <string>
+#include <vector>
+#include <boost/thread.hpp>
 #include <ros/ros.h>
 #include <diagnostic_updater/diagnostic_updater.h>
 #include <diagnostic_updater/publisher.h>
 #include <dynamic_reconfigure/server.h>
 
 #include <velodyne_driver/input.h>
+#include <velodyne_driver/packet_recorder.h>
+#include <velodyne_driver/packet_ring.h>
+#include <velodyne_driver/pcap_index.h>
+#include <velodyne_driver/scan_pool.h>
 #include <velodyne_driver/VelodyneNodeConfig.h>
 
 namespace velodyne_driver
@@ -51,11 +58,22 @@ public:
   VelodyneDriver(ros::NodeHandle node,
                  ros::NodeHandle private_nh,
                  std::string const & node_name = ros::this_node::getName());
-  ~VelodyneDriver() {}
+  ~VelodyneDriver();
 
   bool poll(void);
 
 private:
+  // Get up to max_packets packets from the receive thread or the input
+  int receivePackets(velodyne_msgs::VelodynePacket *pkts, int max_packets);
+  // Receive thread main loop, feeding ring_
+  void receiveLoop();
+  // Wake up the assembly thread waiting in receivePackets()
+  void notifyAssembler();
+  // Diagnostics of the packet ring
+  void ringDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &status);
+  // Diagnostics of the packet recorder
+  void recorderDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &status);
+
   // Callback for dynamic reconfigure
   void callback(velodyne_driver::VelodyneNodeConfig &config,
               uint32_t level);
@@ -75,15 +93,41 @@ private:
     double rpm;                      // device rotation rate (RPMs)
     int cut_angle;                   // cutting angle in 1/100°
     double time_offset;              // time in seconds added to each velodyne time stamp
-    bool enabled;                    // polling is enabled
     bool timestamp_first_packet;
   }
   config_;
 
   boost::shared_ptr<Input> input_;
+  boost::shared_ptr<ScanPool> scan_pool_;
   ros::Publisher output_;
   int last_azimuth_;
 
+  std::atomic<bool> enabled_;       // polling is enabled
+
+  // packets read but not yet published, when cutting at an angle
+  static const int RECEIVE_BATCH = 64;
+  std::vector<velodyne_msgs::VelodynePacket> pending_packets_;
+  size_t pending_next_;
+  size_t pending_count_;
+
+  // Packets received by a dedicated thread, so a slow publish can not
+  // make the socket overflow.  Only used with ~receive_thread, on a
+  // live socket.
+  typedef PacketRing<velodyne_msgs::VelodynePacket> Ring;
+  boost::shared_ptr<Ring> ring_;
+  boost::thread receive_thread_;
+  std::atomic<bool> receiving_;         // receive thread keeps running
+  std::atomic<bool> input_failed_;      // input reported an error, not yet passed on
+  std::atomic<bool> assembler_waiting_;
+  boost::mutex wakeup_mutex_;
+  boost::condition_variable wakeup_;
+  uint64_t reported_drops_;
+
+  // Optional recording of all packets received, fed by the thread
+  // reading the input.
+  boost::shared_ptr<PacketRecorder> recorder_;
+  uint64_t reported_record_drops_;
+
   /* diagnostics updater */
   ros::Timer diag_timer_;
   diagnostic_updater::Updater diagnostics_;
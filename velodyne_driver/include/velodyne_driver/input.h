@@ -35,8 +35,8 @@
  *  Velodyne 3D LIDAR data input classes
  *
  *    These classes provide raw Velodyne LIDAR input packets from
- *    either a live socket interface or a previously-saved PCAP dump
- *    file.
+ *    either a live socket interface, a previously-saved PCAP dump
+ *    file or a raw packet log.
  *
  *  Classes:
  *
@@ -46,8 +46,13 @@
  *     velodyne::InputSocket -- derived class reads live data from the
  *                      device via a UDP socket
  *
+ *     velodyne::InputFile -- base class replaying recorded packets
+ *
  *     velodyne::InputPCAP -- derived class provides a similar interface
  *                      from a PCAP dump file
+ *
+ *     velodyne::InputRawLog -- derived class provides a similar interface
+ *                      from a raw packet log
  */
 
 #ifndef VELODYNE_DRIVER_INPUT_H
@@ -55,12 +60,16 @@
 
 #include <unistd.h>
 #include <stdio.h>
-#include <pcap.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include <string>
+#include <vector>
 
 #include <ros/ros.h>
 #include <velodyne_msgs/VelodynePacket.h>
+#include <velodyne_driver/pcap_reader.h>
+#include <velodyne_driver/raw_log.h>
+#include <velodyne_driver/replay_scheduler.h>
 
 namespace velodyne_driver
 {
@@ -75,6 +84,9 @@ public:
   Input(ros::NodeHandle private_nh, uint16_t port);
   virtual ~Input() {}
 
+  /** getPackets() result when nothing arrived in time, reading may go on */
+  static const int TIMEOUT = -2;
+
   /** @brief Read one Velodyne packet.
    *
    * @param pkt points to VelodynePacket message
@@ -86,6 +98,21 @@ public:
   virtual int getPacket(velodyne_msgs::VelodynePacket *pkt,
                         const double time_offset) = 0;
 
+  /** @brief Read up to max_packets Velodyne packets.
+   *
+   * The default implementation reads a single packet with
+   * getPacket(), sources which can do better override it.
+   *
+   * @param pkts array of at least max_packets VelodynePacket messages
+   *
+   * @returns number of packets read (may be 0),
+   *          TIMEOUT if a live input received nothing for a while,
+   *          -1 if end of file or error
+   */
+  virtual int getPackets(velodyne_msgs::VelodynePacket *pkts,
+                         int max_packets,
+                         const double time_offset);
+
 protected:
   ros::NodeHandle private_nh_;
   uint16_t port_;
@@ -98,25 +125,111 @@ class InputSocket: public Input
 {
 public:
   InputSocket(ros::NodeHandle private_nh,
-              uint16_t port = DATA_PORT_NUMBER);
+              uint16_t port = DATA_PORT_NUMBER,
+              double packet_rate = 0.0);
   virtual ~InputSocket();
 
   virtual int getPacket(velodyne_msgs::VelodynePacket *pkt,
                         const double time_offset);
+  virtual int getPackets(velodyne_msgs::VelodynePacket *pkts,
+                         int max_packets,
+                         const double time_offset);
   void setDeviceIP(const std::string& ip);
 
 private:
+  int waitForInput();
+
   int sockfd_;
   in_addr devip_;
+  int batch_size_;                  ///< most datagrams read per recvmmsg() call
+  double packet_period_;            ///< expected time between packets (s), 0 if unknown
+  bool kernel_timestamps_;          ///< stamp packets with their SO_TIMESTAMPNS arrival time
+  std::vector<mmsghdr> msgs_;       ///< recvmmsg() headers, one per datagram
+  std::vector<iovec> iovecs_;
+  std::vector<sockaddr_in> senders_;
+  std::vector<uint64_t> control_;   ///< ancillary data buffers, control_stride_ words per datagram
+  size_t control_stride_;
 };
 
 
+/** @brief Velodyne input from a file of previously received packets.
+ *
+ * Replays the packets of a file, paced by their capture time stamps
+ * or as fast as possible, optionally only a range of revolutions.
+ * Derived classes read the file format.
+ */
+class InputFile: public Input
+{
+public:
+  InputFile(ros::NodeHandle private_nh,
+            uint16_t port,
+            double packet_rate);
+  virtual ~InputFile() {}
+
+  virtual int getPacket(velodyne_msgs::VelodynePacket *pkt,
+                        const double time_offset);
+  virtual int getPackets(velodyne_msgs::VelodynePacket *pkts,
+                         int max_packets,
+                         const double time_offset);
+
+protected:
+  /** @brief Get the next packet in the range read.
+   *
+   *  @param payload packet data, valid until nextPacket() is called twice more
+   *  @param stamp_ns capture time, 0 if unknown
+   *  @returns false at the end of the range
+   */
+  virtual bool nextPacket(const uint8_t *&payload, uint64_t &stamp_ns) = 0;
+
+  /** @brief Continue reading at the start of the range. */
+  virtual void restart() = 0;
+
+  virtual bool isOpen() const = 0;
+
+  /** @returns why reading stopped early, empty if it did not */
+  virtual std::string readError() const = 0;
+
+  /** @returns true if only some revolutions were asked for */
+  bool rangeRequested() const;
+
+  /** @brief Revolutions [first, end) to read out of count.
+   *
+   *  @param start_revolution the one containing the requested start time
+   *
+   *  An empty range if count is 0.
+   */
+  void selectRevolutions(size_t count, size_t start_revolution,
+                         size_t &first, size_t &end) const;
+
+  double start_;                    ///< seconds after the first packet
+  int first_revolution_;
+  int revolutions_;                 ///< 0 for all
+
+private:
+  int readFast(velodyne_msgs::VelodynePacket *pkts, int max_packets);
+  int readScheduled(velodyne_msgs::VelodynePacket *pkts, int max_packets);
+
+  uint64_t bytes_read_;             ///< payload bytes since the last restart
+  ros::WallTime read_start_;
+  ReplayScheduler scheduler_;       ///< replay timing, unless read_fast
+  std::vector<int64_t> deadlines_;  ///< of the packets in the current batch
+  const uint8_t *pending_payload_;  ///< read, but due in the next batch
+  uint64_t pending_stamp_;
+  bool have_pending_;
+  int64_t pending_deadline_;
+  bool empty_;
+  bool read_once_;
+  bool read_fast_;
+  double repeat_delay_;
+};
+
 /** @brief Velodyne input from PCAP dump file.
  *
  * Dump files can be grabbed by libpcap, Velodyne's DSR software,
- * ethereal, wireshark, tcpdump, or the \ref vdump_command.
+ * ethereal, wireshark, tcpdump, or the driver (see \ref recording), in either
+ * PCAP or PCAPNG format.  The file is memory mapped and read in place.
  */
-class InputPCAP: public Input
+class InputPCAP: public InputFile
 {
 public:
   InputPCAP(ros::NodeHandle private_nh,
@@ -128,20 +241,47 @@ public:
             double repeat_delay = 0.0);
   virtual ~InputPCAP();
 
-  virtual int getPacket(velodyne_msgs::VelodynePacket *pkt,
-                        const double time_offset);
   void setDeviceIP(const std::string& ip);
 
+protected:
+  virtual bool nextPacket(const uint8_t *&payload, uint64_t &stamp_ns);
+  virtual void restart();
+  virtual bool isOpen() const { return reader_.isOpen(); }
+  virtual std::string readError() const { return reader_.error(); }
+
 private:
-  ros::Rate packet_rate_;
   std::string filename_;
-  pcap_t *pcap_;
-  bpf_program pcap_packet_filter_;
-  char errbuf_[PCAP_ERRBUF_SIZE];
-  bool empty_;
-  bool read_once_;
-  bool read_fast_;
-  double repeat_delay_;
+  PcapReader reader_;
+  size_t range_begin_;              ///< offset of the first record to read, 0 for all
+  size_t range_end_;                ///< offset past the last record to read
+};
+
+/** @brief Velodyne input from a raw packet log.
+ *
+ * Raw packet logs are recorded by the driver (see \ref recording).
+ * Ranges of revolutions are found in the index of the log, which was
+ * cut at the ~cut_angle of the recording driver.
+ */
+class InputRawLog: public InputFile
+{
+public:
+  InputRawLog(ros::NodeHandle private_nh,
+              uint16_t port = DATA_PORT_NUMBER,
+              double packet_rate = 0.0,
+              std::string filename = "");
+  virtual ~InputRawLog() {}
+
+protected:
+  virtual bool nextPacket(const uint8_t *&payload, uint64_t &stamp_ns);
+  virtual void restart();
+  virtual bool isOpen() const { return reader_.isOpen(); }
+  virtual std::string readError() const { return reader_.error(); }
+
+private:
+  std::string filename_;
+  RawLogReader reader_;
+  size_t first_;                    ///< first revolution read
+  uint64_t end_packet_;             ///< number of the packet after the last one read
 };
 
 }  // namespace velodyne_driver
@@ -0,0 +1,150 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Recorder of received packets into rotating PCAP files or raw
+ *  packet logs.
+ *
+ *  Packets handed to record() are copied into a ring buffer, which a
+ *  background thread drains into large buffered writes.  record()
+ *  never waits: when the writer falls behind, packets which do not fit
+ *  into the ring are dropped and counted, so recording can never slow
+ *  down receiving.
+ *
+ *  Each packet is written with synthetic Ethernet, IPv4 and UDP
+ *  headers, so the files can be read by InputPCAP, wireshark or
+ *  tcpdump.  Raw packet logs (see raw_log.h) only keep the payload and
+ *  time stamp, optionally compressed, and are read by InputRawLog.  A
+ *  new file is started at the first revolution boundary after the
+ *  current one reached its size limit.
+ */
+
+#ifndef VELODYNE_DRIVER_PACKET_RECORDER_H
+#define VELODYNE_DRIVER_PACKET_RECORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <velodyne_msgs/VelodynePacket.h>
+#include <velodyne_driver/packet_ring.h>
+#include <velodyne_driver/raw_log.h>
+
+namespace velodyne_driver
+{
+
+class PacketRecorder
+{
+public:
+  struct Options
+  {
+    Options():
+      file_size(100 * 1000 * 1000),
+      max_files(0),
+      ring_size(16384),
+      cut_angle(0),
+      port(2368),
+      src_addr(0),
+      raw(false),
+      compression(RAW_LOG_UNCOMPRESSED)
+    {}
+
+    std::string prefix;     ///< files are named <prefix>NNNN.pcap or .vlog
+    size_t file_size;       ///< bytes after which a new file is started
+    int max_files;          ///< oldest files are removed beyond this, 0 keeps all
+    size_t ring_size;       ///< packets buffered for the writer thread
+    int cut_angle;          ///< where revolutions start, 1/100 degree
+    uint16_t port;          ///< UDP destination port written
+    uint32_t src_addr;      ///< IPv4 source address written, network byte order
+    bool raw;               ///< write raw packet logs instead of PCAP files
+    RawLogCompression compression;  ///< of raw packet logs
+  };
+
+  /** @brief Start the writer thread. */
+  explicit PacketRecorder(const Options &options);
+
+  /** @brief Write all packets recorded so far, and stop. */
+  ~PacketRecorder();
+
+  /** @brief Queue packets for writing, never waits.
+   *
+   *  Must always be called from the same thread.
+   */
+  void record(const velodyne_msgs::VelodynePacket *pkts, size_t count);
+
+  uint64_t drops() const { return ring_.drops(); }
+  uint64_t packetsWritten() const { return packets_written_; }
+  uint64_t bytesWritten() const { return bytes_written_; }
+  uint64_t filesWritten() const { return files_written_; }
+
+  /** @returns true if writing failed, recording stopped then */
+  bool failed() const { return failed_; }
+
+private:
+  void writeLoop();
+  void write(const velodyne_msgs::VelodynePacket &pkt);
+  void writeRaw(const velodyne_msgs::VelodynePacket &pkt);
+  bool openFile();
+  void closeFile();
+  bool flush();
+
+  Options options_;
+  PacketRing<velodyne_msgs::VelodynePacket> ring_;
+  boost::thread thread_;
+  std::atomic<bool> running_;
+
+  // writer thread only
+  std::vector<uint8_t> headers_;    ///< link, IPv4 and UDP headers of every packet
+  std::vector<uint8_t> buffer_;
+  size_t buffered_;
+  int fd_;
+  RawLogWriter raw_log_;            ///< current file, if options_.raw
+  size_t file_bytes_;
+  int file_number_;
+  std::deque<std::string> files_;   ///< names of the files written, oldest first
+  int last_azimuth_;
+  bool new_revolution_;             ///< the last packet written ended a revolution
+
+  std::atomic<uint64_t> packets_written_;
+  std::atomic<uint64_t> bytes_written_;
+  std::atomic<uint64_t> files_written_;
+  std::atomic<bool> failed_;
+};
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_PACKET_RECORDER_H
@@ -0,0 +1,165 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Bounded single-producer single-consumer ring buffer.
+ *
+ *  The slots are allocated once.  The producer fills free slots in
+ *  place and then publishes them, the consumer reads published slots
+ *  in place and then releases them.  Neither side ever takes a lock,
+ *  so a slow consumer can not stall the producer: when the ring is
+ *  full the producer decides what to do with the data, and counts it
+ *  as a drop.
+ */
+
+#ifndef VELODYNE_DRIVER_PACKET_RING_H
+#define VELODYNE_DRIVER_PACKET_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace velodyne_driver
+{
+
+template <typename T>
+class PacketRing
+{
+public:
+  /** @param capacity minimum number of slots, rounded up to a power of two */
+  explicit PacketRing(size_t capacity):
+    head_(0),
+    tail_(0),
+    drops_(0),
+    max_occupancy_(0)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    slots_.resize(size);
+    mask_ = size - 1;
+  }
+
+  size_t capacity() const { return slots_.size(); }
+
+  /** @returns number of published slots not yet released */
+  size_t occupancy() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  /** @brief Producer: contiguous free slots.
+   *
+   *  @param count in: slots wanted, out: slots available (may be 0)
+   *  @returns first free slot
+   */
+  T* acquire(size_t &count)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t free = capacity() - (head - tail_.load(std::memory_order_acquire));
+    size_t contiguous = capacity() - (head & mask_);
+    if (count > free)
+      count = free;
+    if (count > contiguous)
+      count = contiguous;
+    return &slots_[head & mask_];
+  }
+
+  /** @brief Producer: hand the first n acquired slots to the consumer. */
+  void publish(size_t n)
+  {
+    size_t head = head_.load(std::memory_order_relaxed) + n;
+    head_.store(head, std::memory_order_release);
+
+    size_t occupancy = head - tail_.load(std::memory_order_acquire);
+    if (occupancy > max_occupancy_.load(std::memory_order_relaxed))
+      max_occupancy_.store(occupancy, std::memory_order_relaxed);
+  }
+
+  /** @brief Producer: count data which did not fit. */
+  void drop(size_t n)
+  {
+    drops_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /** @brief Consumer: contiguous published slots.
+   *
+   *  @param count in: slots wanted, out: slots available (may be 0)
+   *  @returns first published slot
+   */
+  T* peek(size_t &count)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t available = head_.load(std::memory_order_acquire) - tail;
+    size_t contiguous = capacity() - (tail & mask_);
+    if (count > available)
+      count = available;
+    if (count > contiguous)
+      count = contiguous;
+    return &slots_[tail & mask_];
+  }
+
+  /** @brief Consumer: return the first n peeked slots to the producer. */
+  void release(size_t n)
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+
+  /** @returns total number of dropped items */
+  uint64_t drops() const { return drops_.load(std::memory_order_relaxed); }
+
+  /** @returns highest occupancy since the last call, and restarts tracking */
+  size_t takeMaxOccupancy()
+  {
+    return max_occupancy_.exchange(occupancy(), std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<T> slots_;
+  size_t mask_;
+
+  // written by one side each, padded onto separate cache lines
+  static const size_t CACHE_LINE = 64;
+  char pad0_[CACHE_LINE];
+  std::atomic<size_t> head_;            ///< next slot to publish (producer)
+  char pad1_[CACHE_LINE - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_;            ///< next slot to release (consumer)
+  char pad2_[CACHE_LINE - sizeof(std::atomic<size_t>)];
+  std::atomic<uint64_t> drops_;         ///< producer
+  std::atomic<size_t> max_occupancy_;   ///< producer
+};
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_PACKET_RING_H
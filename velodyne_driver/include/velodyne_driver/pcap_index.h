@@ -0,0 +1,140 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Revolution index of a PCAP dump file.
+ *
+ *  The index holds the file offset, capture time and first block
+ *  azimuth of the first packet of every revolution, so readers can
+ *  start at a given time or revolution, and several readers can work
+ *  on disjoint revolution ranges of one file.  Building it takes one
+ *  pass over the file, afterwards it is cached in a sidecar file next
+ *  to the dump ("<dump>.idx"), which is rebuilt when the dump or the
+ *  indexing parameters change.
+ */
+
+#ifndef VELODYNE_DRIVER_PCAP_INDEX_H
+#define VELODYNE_DRIVER_PCAP_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <velodyne_driver/pcap_reader.h>
+
+namespace velodyne_driver
+{
+
+/** @brief Does a rotation pass the cut angle?
+ *
+ *  All angles in 1/100 degree, as in the packets.
+ *
+ *  @param last_azimuth first block azimuth of the previous packet
+ *  @param azimuth first block azimuth of this packet
+ *  @param cut_angle where revolutions start
+ */
+inline bool passesCutAngle(int last_azimuth, int azimuth, int cut_angle)
+{
+  return (last_azimuth < cut_angle && cut_angle <= azimuth)
+    || (cut_angle <= azimuth && azimuth < last_azimuth)
+    || (azimuth < last_azimuth && last_azimuth < cut_angle);
+}
+
+/** @brief Where a revolution starts in the dump file. */
+struct RevolutionEntry
+{
+  uint64_t offset;          ///< record offset of its first packet
+  uint64_t stamp_ns;        ///< capture time of its first packet
+  uint16_t azimuth;         ///< first block azimuth of its first packet, 1/100 degree
+};
+
+class PcapIndex
+{
+public:
+  /** @brief What an index was built from, to detect stale sidecar files. */
+  struct Key
+  {
+    uint64_t file_size;
+    int64_t mtime_ns;
+    int32_t cut_angle;      ///< 1/100 degree
+    uint16_t port;
+    uint32_t src_addr;      ///< network byte order, 0 for any
+  };
+
+  PcapIndex();
+
+  /** @brief Load the sidecar index of a dump file, or build and save it.
+   *
+   *  Failing to save the sidecar file is not an error, the index is
+   *  just built again next time.
+   *
+   *  @param filename dump file name
+   *  @param reader the dump file, opened with the filter set to port and src_addr
+   *  @returns false if the dump can not be indexed
+   */
+  bool open(const std::string &filename, PcapReader &reader,
+            int cut_angle, uint16_t port, uint32_t src_addr);
+
+  /** @brief Index all packets of at least min_length bytes.
+   *
+   *  Leaves the reader rewound.  The first revolution starts at the
+   *  first packet, even if it is incomplete.
+   */
+  void build(PcapReader &reader, const Key &key, size_t min_length);
+
+  /** @returns true if the file holds an index built with this key */
+  bool load(const std::string &filename, const Key &key);
+  bool save(const std::string &filename) const;
+
+  static std::string sidecarName(const std::string &filename)
+  {
+    return filename + ".idx";
+  }
+
+  size_t size() const { return revolutions_.size(); }
+  const RevolutionEntry &operator[](size_t i) const { return revolutions_[i]; }
+
+  /** @returns the revolution containing a capture time, 0 if it is
+   *           before the first one
+   */
+  size_t find(uint64_t stamp_ns) const;
+
+private:
+  Key key_;
+  std::vector<RevolutionEntry> revolutions_;
+};
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_PCAP_INDEX_H
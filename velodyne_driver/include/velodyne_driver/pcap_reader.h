@@ -0,0 +1,162 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Memory mapped reader for PCAP and PCAPNG capture files.
+ *
+ *  The whole file is mapped read-only and walked record by record in
+ *  place.  Instead of compiling a BPF filter, the link layer, IPv4 and
+ *  UDP headers of each frame are checked directly for the wanted
+ *  destination port and, optionally, source address.  Rewinding or
+ *  seeking just resets the current offset.
+ *
+ *  Supported link types are Ethernet (with VLAN tags), Linux cooked
+ *  capture (v1 and v2), BSD loopback and raw IPv4.  Fragmented IPv4
+ *  datagrams are skipped.
+ */
+
+#ifndef VELODYNE_DRIVER_PCAP_READER_H
+#define VELODYNE_DRIVER_PCAP_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace velodyne_driver
+{
+
+/** @brief UDP payload of a captured packet, pointing into the mapped file. */
+struct PcapRecord
+{
+  const uint8_t *payload;   ///< first byte of the UDP payload
+  size_t length;            ///< captured payload bytes
+  uint64_t stamp_ns;        ///< capture time, nanoseconds since the epoch
+  size_t offset;            ///< file offset of the record, for seek()
+};
+
+class PcapReader
+{
+public:
+  PcapReader();
+  ~PcapReader();
+
+  /** @brief Map a capture file.
+   *
+   *  @returns true if successful, otherwise error() describes the problem
+   */
+  bool open(const std::string &filename);
+  void close();
+  bool isOpen() const { return data_ != NULL; }
+  const std::string &error() const { return error_; }
+
+  /** @brief Only return UDP packets to this port.
+   *
+   *  @param port destination port, host byte order
+   *  @param src_addr source IPv4 address, network byte order, 0 for any
+   */
+  void setFilter(uint16_t port, uint32_t src_addr = 0);
+
+  /** @brief Get the next packet passing the filter.
+   *
+   *  @returns false at the end of the file, or if the rest of the file
+   *           is malformed (see error())
+   */
+  bool next(PcapRecord &record);
+
+  /** @brief Continue reading at the first record. */
+  void rewind();
+
+  /** @brief Continue reading at a record offset returned by next().
+   *
+   *  @returns false if the offset is not inside the file
+   */
+  bool seek(size_t offset);
+
+  /** @returns offset of the next record */
+  size_t offset() const { return offset_; }
+
+  /** @returns size of the mapped file in bytes */
+  size_t size() const { return size_; }
+
+private:
+  enum Format
+  {
+    FORMAT_PCAP,
+    FORMAT_PCAPNG
+  };
+
+  struct Interface
+  {
+    uint16_t link_type;
+    uint64_t ts_units;              ///< timestamp units per second
+  };
+
+  /** a PCAP file, or a PCAPNG section with its interfaces */
+  struct Section
+  {
+    size_t begin;                   ///< file offset of the section
+    bool swapped;                   ///< byte order differs from ours
+    std::vector<Interface> interfaces;
+  };
+
+  bool openPcap();
+  bool openPcapng();
+  bool nextPcap(PcapRecord &record);
+  bool nextPcapng(PcapRecord &record);
+  bool blockHeader(size_t offset, uint32_t &type, uint32_t &length);
+  void readInterface(Section &section, const uint8_t *body, size_t length);
+  bool udpPayload(const Interface &interface, const uint8_t *frame,
+                  size_t length, PcapRecord &record) const;
+
+  uint16_t get16(const uint8_t *p) const;
+  uint32_t get32(const uint8_t *p) const;
+
+  const uint8_t *data_;
+  size_t size_;
+  size_t offset_;
+  size_t first_record_;
+  std::string error_;
+
+  Format format_;
+  std::vector<Section> sections_;   ///< all sections, found when opening
+  size_t section_;                  ///< section of offset_
+  bool swapped_;                    ///< byte order of the current section differs from ours
+
+  uint16_t port_;
+  uint32_t src_addr_;
+};
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_PCAP_READER_H
@@ -0,0 +1,226 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Compact log of raw Velodyne packets.
+ *
+ *  PCAP files store 58 bytes of record, Ethernet, IP and UDP headers
+ *  with every 1206 byte packet, and rosbag adds ROS message headers.
+ *  A raw packet log only keeps the payload and an 8 byte capture time
+ *  stamp, in chunks which may be compressed, followed by an index of
+ *  the revolutions for seeking.  All fields are in host byte order:
+ *
+ *    RawLogHeader
+ *    chunks:  RawLogChunk, then stored_size bytes holding, after
+ *             decompression, the time stamps (uint64_t) of its packets
+ *             followed by their payloads
+ *    index:   RawLogRevolution[revolutions]
+ *    RawLogTrailer
+ *
+ *  A log which was not closed has no index and trailer.  It can still
+ *  be read sequentially, up to its last complete chunk.
+ */
+
+#ifndef VELODYNE_DRIVER_RAW_LOG_H
+#define VELODYNE_DRIVER_RAW_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace velodyne_driver
+{
+
+static const size_t RAW_LOG_PACKET_SIZE = 1206;
+
+enum RawLogCompression
+{
+  RAW_LOG_UNCOMPRESSED = 0,
+  RAW_LOG_LZ4 = 1,
+  RAW_LOG_ZSTD = 2
+};
+
+struct RawLogHeader
+{
+  char magic[8];            ///< "VLRAWLOG"
+  uint32_t version;
+  uint32_t packet_size;     ///< RAW_LOG_PACKET_SIZE
+  uint32_t compression;     ///< RawLogCompression
+  int32_t cut_angle;        ///< where revolutions start, 1/100 degree
+};
+
+struct RawLogChunk
+{
+  uint32_t packets;
+  uint32_t stored_size;     ///< bytes following this header
+  uint64_t first_stamp_ns;
+};
+
+/** @brief Where a revolution starts in a raw log. */
+struct RawLogRevolution
+{
+  uint64_t chunk_offset;    ///< file offset of the chunk holding its first packet
+  uint64_t packet_number;   ///< of its first packet, counted from the start of the log
+  uint64_t stamp_ns;        ///< capture time of its first packet
+  uint32_t chunk_packet;    ///< its first packet within the chunk
+  uint16_t azimuth;         ///< first block azimuth of its first packet, 1/100 degree
+  uint16_t reserved;
+};
+
+struct RawLogTrailer
+{
+  uint64_t index_offset;
+  uint64_t revolutions;
+  char magic[8];            ///< "VLRAWIDX"
+};
+
+/** @returns true if this build can read and write a compression */
+bool rawLogCompressionSupported(RawLogCompression compression);
+
+class RawLogWriter
+{
+public:
+  RawLogWriter();
+  ~RawLogWriter();
+
+  /** @brief Create a log file.
+   *
+   *  @param chunk_packets packets per chunk
+   *  @returns true if successful, otherwise error() describes the problem
+   */
+  bool open(const std::string &filename, RawLogCompression compression,
+            int cut_angle, size_t chunk_packets = 1024);
+
+  /** @brief Append a packet of RAW_LOG_PACKET_SIZE bytes.
+   *
+   *  @param starts_revolution the packet is the first of a revolution,
+   *         the first packet of the log always is
+   */
+  bool write(uint64_t stamp_ns, const uint8_t *data, bool starts_revolution);
+
+  /** @brief Write the last chunk and the index, and close the file. */
+  bool close();
+
+  bool isOpen() const { return fd_ >= 0; }
+  const std::string &error() const { return error_; }
+
+  /** @returns bytes written to the file so far */
+  uint64_t bytesWritten() const { return offset_; }
+
+private:
+  bool writeChunk();
+  bool writeAll(const void *data, size_t size);
+
+  int fd_;
+  std::string error_;
+  RawLogCompression compression_;
+  size_t chunk_packets_;
+  uint64_t offset_;                 ///< file offset of the chunk being filled
+  uint64_t packets_;
+  std::vector<uint8_t> chunk_;      ///< time stamps, then payloads
+  size_t count_;                    ///< packets in chunk_
+  std::vector<uint8_t> compressed_;
+  std::vector<RawLogRevolution> revolutions_;
+};
+
+class RawLogReader
+{
+public:
+  RawLogReader();
+  ~RawLogReader();
+
+  /** @returns true if a file starts like a raw log */
+  static bool isRawLog(const std::string &filename);
+
+  /** @brief Map a log file.
+   *
+   *  @returns true if successful, otherwise error() describes the problem
+   */
+  bool open(const std::string &filename);
+  void close();
+  bool isOpen() const { return data_ != NULL; }
+  const std::string &error() const { return error_; }
+
+  /** @brief Get the next packet.
+   *
+   *  @param payload RAW_LOG_PACKET_SIZE bytes, valid until the chunk
+   *         after the next one is read
+   *  @returns false at the end of the log, or if the rest of it is
+   *           malformed (see error())
+   */
+  bool next(const uint8_t *&payload, uint64_t &stamp_ns);
+
+  /** @brief Continue reading at the first packet. */
+  void rewind();
+
+  /** @brief Continue reading at the first packet of a revolution. */
+  bool seek(size_t revolution);
+
+  /** @returns number of the packet next() returns next */
+  uint64_t packetNumber() const { return packet_number_; }
+
+  /** @returns indexed revolutions, none if the log was not closed */
+  const std::vector<RawLogRevolution> &revolutions() const { return revolutions_; }
+
+  /** @returns the revolution containing a capture time, 0 if it is
+   *           before the first one
+   */
+  size_t findRevolution(uint64_t stamp_ns) const;
+
+  int cutAngle() const { return header_.cut_angle; }
+
+private:
+  bool loadChunk(uint64_t offset);
+
+  const uint8_t *data_;
+  size_t size_;
+  std::string error_;
+  RawLogHeader header_;
+  uint64_t chunks_end_;             ///< offset of the index, or of the end of file
+  std::vector<RawLogRevolution> revolutions_;
+
+  // the current chunk
+  uint64_t chunk_offset_;
+  uint64_t next_chunk_;
+  size_t chunk_packets_;
+  size_t chunk_next_;               ///< next packet within the chunk
+  const uint8_t *chunk_data_;       ///< time stamps, then payloads
+  std::vector<uint8_t> chunk_buffers_[2];   ///< decompressed chunks, alternating
+  int chunk_buffer_;
+  uint64_t packet_number_;
+};
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_RAW_LOG_H
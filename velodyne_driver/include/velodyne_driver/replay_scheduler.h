@@ -0,0 +1,208 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Replay schedule of captured packets.
+ *
+ *  Every packet is due at a fixed wall clock deadline derived from its
+ *  capture time, relative to the first packet and divided by the replay
+ *  speed.  Deadlines are absolute, so sleeping late for one batch of
+ *  packets is made up by the following ones instead of accumulating.
+ *  The schedule starts over when the capture time jumps backwards, e.g.
+ *  when the file is replayed again, or pauses for longer than a
+ *  maximum gap.
+ */
+
+#ifndef VELODYNE_DRIVER_REPLAY_SCHEDULER_H
+#define VELODYNE_DRIVER_REPLAY_SCHEDULER_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+
+namespace velodyne_driver
+{
+
+class ReplayScheduler
+{
+public:
+  static const int64_t NSEC_PER_SEC = 1000000000ll;
+
+  /** @param speed replay speed, clamped to [MIN_SPEED, MAX_SPEED]
+   *  @param packet_period time between packets without capture time (s)
+   *  @param max_gap longest pause in the capture replayed (s)
+   */
+  explicit ReplayScheduler(double speed = 1.0, double packet_period = 0.0,
+                           double max_gap = 1.0):
+    speed_(clampSpeed(speed)),
+    packet_period_ns_(packet_period * NSEC_PER_SEC),
+    max_gap_ns_(max_gap * NSEC_PER_SEC),
+    capture_origin_ns_(0),
+    wall_origin_ns_(0),
+    last_stamp_ns_(0),
+    last_deadline_ns_(0)
+  {
+    reset();
+    resetStatistics();
+  }
+
+  static constexpr double MIN_SPEED = 0.5;
+  static constexpr double MAX_SPEED = 20.0;
+  static double clampSpeed(double speed)
+  {
+    if (speed < MIN_SPEED)
+      return MIN_SPEED;
+    if (speed > MAX_SPEED)
+      return MAX_SPEED;
+    return speed;
+  }
+
+  double speed() const { return speed_; }
+
+  /** @brief Start over at the next packet. */
+  void reset()
+  {
+    anchored_ = false;
+  }
+
+  /** @brief Schedule the next packet.
+   *
+   *  @param stamp_ns capture time, 0 if unknown
+   *  @param now_ns current time, see now()
+   *  @returns when the packet is due, in the time base of now()
+   */
+  int64_t schedule(uint64_t stamp_ns, int64_t now_ns)
+  {
+    if (stamp_ns == 0)                // assume the nominal packet rate
+      stamp_ns = anchored_ ? last_stamp_ns_ + packet_period_ns_ : 0;
+
+    if (!anchored_
+        || stamp_ns < last_stamp_ns_
+        || stamp_ns - last_stamp_ns_ > max_gap_ns_)
+      {
+        // continue right after the previous packet, or now if we are late
+        capture_origin_ns_ = stamp_ns;
+        wall_origin_ns_ = anchored_ ? std::max(now_ns, last_deadline_ns_) : now_ns;
+        anchored_ = true;
+      }
+
+    int64_t deadline = wall_origin_ns_ + (int64_t) ((stamp_ns - capture_origin_ns_) / speed_);
+    last_stamp_ns_ = stamp_ns;
+    last_deadline_ns_ = deadline;
+
+    if (packets_ == 0)
+      {
+        first_deadline_ns_ = deadline;
+        start_ns_ = now_ns;
+      }
+    ++packets_;
+    return deadline;
+  }
+
+  /** @brief Record when a batch due at deadline_ns was actually released. */
+  void released(int64_t deadline_ns, int64_t now_ns)
+  {
+    max_lateness_ns_ = std::max(max_lateness_ns_, now_ns - deadline_ns);
+    released_ns_ = now_ns;
+  }
+
+  void resetStatistics()
+  {
+    packets_ = 0;
+    first_deadline_ns_ = 0;
+    start_ns_ = 0;
+    released_ns_ = 0;
+    max_lateness_ns_ = 0;
+  }
+
+  /** @returns packets scheduled since resetStatistics() */
+  uint64_t packets() const { return packets_; }
+
+  /** @returns packet rate the schedule asked for (Hz) */
+  double targetRate() const
+  {
+    int64_t span = last_deadline_ns_ - first_deadline_ns_;
+    return (packets_ > 1 && span > 0) ? (packets_ - 1) * 1e9 / span : 0.0;
+  }
+
+  /** @returns packet rate actually released (Hz) */
+  double achievedRate() const
+  {
+    int64_t span = released_ns_ - start_ns_;
+    return (packets_ > 1 && span > 0) ? (packets_ - 1) * 1e9 / span : 0.0;
+  }
+
+  /** @returns latest release after a deadline (s) */
+  double maxLateness() const { return max_lateness_ns_ * 1e-9; }
+
+  /** @returns current time of the monotonic clock (ns) */
+  static int64_t now()
+  {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+  }
+
+  /** @brief Sleep until an absolute time of now(). */
+  static void sleepUntil(int64_t deadline_ns)
+  {
+    timespec ts;
+    ts.tv_sec = deadline_ns / NSEC_PER_SEC;
+    ts.tv_nsec = deadline_ns % NSEC_PER_SEC;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+      continue;
+  }
+
+private:
+  double speed_;
+  uint64_t packet_period_ns_;
+  uint64_t max_gap_ns_;
+
+  bool anchored_;
+  uint64_t capture_origin_ns_;      ///< capture time of the packet starting the schedule
+  int64_t wall_origin_ns_;          ///< when that packet was due
+  uint64_t last_stamp_ns_;
+  int64_t last_deadline_ns_;
+
+  // statistics
+  uint64_t packets_;
+  int64_t first_deadline_ns_;
+  int64_t start_ns_;
+  int64_t released_ns_;
+  int64_t max_lateness_ns_;
+};
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_REPLAY_SCHEDULER_H
@@ -0,0 +1,110 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Pool of recycled VelodyneScan messages.
+ *
+ *  Published scans are shared with intra-process subscribers through
+ *  their shared_ptr.  The pool keeps its own reference to every scan
+ *  it created, and hands a scan out again once it holds the only
+ *  reference left, i.e. after every subscriber has released it.  The
+ *  packet storage of a recycled scan is kept, so in steady state
+ *  assembling a scan does not allocate.
+ */
+
+#ifndef VELODYNE_DRIVER_SCAN_POOL_H
+#define VELODYNE_DRIVER_SCAN_POOL_H
+
+#include <stddef.h>
+#include <vector>
+#include <velodyne_msgs/VelodyneScan.h>
+
+namespace velodyne_driver
+{
+
+class ScanPool
+{
+public:
+  /** @param size most scans kept for recycling
+   *  @param packets_per_scan packet capacity reserved in every scan
+   */
+  ScanPool(size_t size, size_t packets_per_scan):
+    packets_per_scan_(packets_per_scan),
+    next_(0),
+    allocations_(0)
+  {
+    scans_.reserve(size);
+  }
+
+  /** @brief Get an empty scan, recycled if possible.
+   *
+   *  Scans still referenced elsewhere are skipped.  When all pooled
+   *  scans are in use, a new one is created and kept if the pool is
+   *  not full yet.
+   */
+  velodyne_msgs::VelodyneScanPtr get()
+  {
+    for (size_t i = 0; i < scans_.size(); ++i)
+      {
+        // start after the scan handed out last, it is the least
+        // likely one to be released already
+        const velodyne_msgs::VelodyneScanPtr &scan = scans_[next_];
+        next_ = (next_ + 1) % scans_.size();
+        if (scan.unique())
+          {
+            scan->packets.clear();
+            return scan;
+          }
+      }
+
+    velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+    scan->packets.reserve(packets_per_scan_);
+    ++allocations_;
+    if (scans_.size() < scans_.capacity())
+      scans_.push_back(scan);
+    return scan;
+  }
+
+  /** @returns number of scans created so far */
+  size_t allocations() const { return allocations_; }
+
+private:
+  size_t packets_per_scan_;
+  std::vector<velodyne_msgs::VelodyneScanPtr> scans_;
+  size_t next_;
+  size_t allocations_;
+};
+
+}  // namespace velodyne_driver
+
+#endif  // VELODYNE_DRIVER_SCAN_POOL_H
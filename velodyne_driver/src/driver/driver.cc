@@ -35,8 +35,10 @@
  *  ROS driver implementation for the Velodyne 3D LIDARs
  */
 
+#include <algorithm>
 #include <string>
 #include <cmath>
+#include <arpa/inet.h>
 
 #include <ros/ros.h>
 #include <tf/transform_listener.h>
@@ -173,10 +175,17 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
                                         TimeStampStatusParam()));
   diag_timer_ = private_nh.createTimer(ros::Duration(0.2), &VelodyneDriver::diagTimerCallback,this);
 
-  config_.enabled = true;
+  enabled_ = true;
 
   // open Velodyne input device or file
-  if (dump_file != "")                  // have PCAP file?
+  bool live_input = false;
+  if (dump_file != "" && RawLogReader::isRawLog(dump_file))
+    {
+      // read data from raw packet log
+      input_.reset(new velodyne_driver::InputRawLog(private_nh, udp_port,
+                                                    packet_rate, dump_file));
+    }
+  else if (dump_file != "")             // have PCAP file?
     {
       // read data from packet capture file
       input_.reset(new velodyne_driver::InputPCAP(private_nh, udp_port,
@@ -185,14 +194,110 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
   else
     {
       // read data from live socket
-      input_.reset(new velodyne_driver::InputSocket(private_nh, udp_port));
+      input_.reset(new velodyne_driver::InputSocket(private_nh, udp_port,
+                                                    packet_rate));
+      live_input = true;
     }
 
+  // scans released by all subscribers are reused
+  int scan_pool_size;
+  private_nh.param("scan_pool_size", scan_pool_size, 32);
+  scan_pool_.reset(new ScanPool(std::max(scan_pool_size, 0), config_.npackets));
+
   // raw packet output topic
   output_ =
     node.advertise<velodyne_msgs::VelodyneScan>("velodyne_packets", 10);
 
   last_azimuth_ = -1;
+  pending_packets_.resize(RECEIVE_BATCH);
+  pending_next_ = 0;
+  pending_count_ = 0;
+
+  // optionally record all packets received
+  std::string record_prefix;
+  private_nh.param("record", record_prefix, std::string(""));
+  if (record_prefix != "")
+    {
+      PacketRecorder::Options options;
+      options.prefix = record_prefix;
+      double file_size;
+      private_nh.param("record_file_size", file_size, 100.0);
+      options.file_size = std::max(file_size, 0.0) * 1e6;
+      private_nh.param("record_max_files", options.max_files, 0);
+      int record_ring_size;
+      private_nh.param("record_ring_size", record_ring_size, 16384);
+      options.ring_size = std::max(record_ring_size, RECEIVE_BATCH);
+      options.cut_angle = std::max(config_.cut_angle, 0);
+      options.port = udp_port;
+      std::string devip;
+      private_nh.param("device_ip", devip, std::string(""));
+      in_addr addr;
+      if (devip != "" && inet_aton(devip.c_str(), &addr))
+        options.src_addr = addr.s_addr;
+
+      // raw packet logs are smaller, and optionally compressed
+      std::string format;
+      private_nh.param("record_format", format, std::string("pcap"));
+      std::string compression;
+      private_nh.param("record_compression", compression, std::string("none"));
+      options.raw = (format == "raw");
+      if (!options.raw && format != "pcap")
+        ROS_WARN_STREAM("unknown record_format " << format << ", recording PCAP files");
+      if (compression == "lz4")
+        options.compression = RAW_LOG_LZ4;
+      else if (compression == "zstd")
+        options.compression = RAW_LOG_ZSTD;
+      else if (compression != "none")
+        ROS_WARN_STREAM("unknown record_compression " << compression);
+      if (options.raw && !rawLogCompressionSupported(options.compression))
+        {
+          ROS_WARN_STREAM("record_compression " << compression
+                          << " not supported by this build, not compressing");
+          options.compression = RAW_LOG_UNCOMPRESSED;
+        }
+
+      ROS_INFO_STREAM("recording packets to " << record_prefix
+                      << (options.raw ? "NNNN.vlog, " : "NNNN.pcap, ")
+                      << file_size << " MB per file");
+      recorder_.reset(new PacketRecorder(options));
+      diagnostics_.add("Packet recorder", this, &VelodyneDriver::recorderDiagnostics);
+    }
+  reported_record_drops_ = 0;
+
+  // receive packets on a separate thread, so publishing can not stall the
+  // socket.  Files are read directly: they can not overflow, and must
+  // neither lose packets to a full ring nor be read while disabled.
+  bool receive_thread;
+  private_nh.param("receive_thread", receive_thread, true);
+  if (receive_thread && !live_input)
+    {
+      ROS_INFO("reading a file, ignoring receive_thread");
+      receive_thread = false;
+    }
+  int ring_size;
+  private_nh.param("packet_ring_size", ring_size, 4096);
+  receiving_ = false;
+  input_failed_ = false;
+  assembler_waiting_ = false;
+  reported_drops_ = 0;
+  if (receive_thread)
+    {
+      ring_.reset(new Ring(std::max(ring_size, RECEIVE_BATCH)));
+      ROS_INFO_STREAM("receiving on a separate thread, buffering up to "
+                      << ring_->capacity() << " packets");
+      diagnostics_.add("Packet ring", this, &VelodyneDriver::ringDiagnostics);
+      receiving_ = true;
+      receive_thread_ = boost::thread(boost::bind(&VelodyneDriver::receiveLoop, this));
+    }
+}
+
+VelodyneDriver::~VelodyneDriver()
+{
+  if (receiving_)
+    {
+      receiving_ = false;
+      receive_thread_.join();
+    }
 }
 
 /** poll the device
@@ -201,28 +306,31 @@ VelodyneDriver::VelodyneDriver(ros::NodeHandle node,
  */
 bool VelodyneDriver::poll(void)
 {
-  if (!config_.enabled) {
+  if (!enabled_) {
     // If we are not enabled exit once a second to let the caller handle
     // anything it might need to, such as if it needs to exit.
     ros::Duration(1).sleep();
     return true;
   }
 
-  // Allocate a new shared pointer for zero-copy sharing with other nodelets.
-  velodyne_msgs::VelodyneScanPtr scan(new velodyne_msgs::VelodyneScan);
+  // Get a shared pointer for zero-copy sharing with other nodelets,
+  // reusing one they have released.
+  velodyne_msgs::VelodyneScanPtr scan = scan_pool_->get();
 
   if( config_.cut_angle >= 0) //Cut at specific angle feature enabled
   {
-    scan->packets.reserve(config_.npackets);
-    velodyne_msgs::VelodynePacket tmp_packet;
     while(true)
     {
-      while(true)
+      // packets are read in batches, the ones after the cut angle are
+      // kept for the next scan
+      while (pending_next_ == pending_count_)
       {
-        int rc = input_->getPacket(&tmp_packet, config_.time_offset);
-        if (rc == 0) break;       // got a full packet?
+        int rc = receivePackets(&pending_packets_[0], pending_packets_.size());
         if (rc < 0) return false; // end of file reached?
+        pending_next_ = 0;
+        pending_count_ = rc;
       }
+      const velodyne_msgs::VelodynePacket &tmp_packet = pending_packets_[pending_next_++];
       scan->packets.push_back(tmp_packet);
 
       // Extract base rotation of first block in packet
@@ -234,9 +342,7 @@ bool VelodyneDriver::poll(void)
       	 last_azimuth_ = azimuth;
       	 continue;
       }
-      if((last_azimuth_ < config_.cut_angle && config_.cut_angle <= azimuth)
-      	 || ( config_.cut_angle <= azimuth && azimuth < last_azimuth_)
-      	 || (azimuth < last_azimuth_ && last_azimuth_ < config_.cut_angle))
+      if (passesCutAngle(last_azimuth_, azimuth, config_.cut_angle))
       {
         last_azimuth_ = azimuth;
         break; // Cut angle passed, one full revolution collected
@@ -249,15 +355,12 @@ bool VelodyneDriver::poll(void)
   // Since the velodyne delivers data at a very high rate, keep
   // reading and publishing scans as fast as possible.
     scan->packets.resize(config_.npackets);
-    for (int i = 0; i < config_.npackets; ++i)
+    for (int i = 0; i < config_.npackets; )
     {
-      while (true)
-        {
-          // keep reading until full packet received
-          int rc = input_->getPacket(&scan->packets[i], config_.time_offset);
-          if (rc == 0) break;       // got a full packet?
-          if (rc < 0) return false; // end of file reached?
-        }
+      // read as many packets as are available straight into the scan
+      int rc = receivePackets(&scan->packets[i], config_.npackets - i);
+      if (rc < 0) return false; // end of file reached?
+      i += rc;
     }
   }
 
@@ -280,6 +383,146 @@ bool VelodyneDriver::poll(void)
   return true;
 }
 
+/** @brief Get up to max_packets packets.
+ *
+ *  Reads the input directly, or takes packets from the receive thread,
+ *  waiting until there are some.
+ *
+ *  @returns number of packets (may be 0), -1 if the input failed
+ */
+int VelodyneDriver::receivePackets(velodyne_msgs::VelodynePacket *pkts,
+                                   int max_packets)
+{
+  if (!ring_)
+    {
+      int rc = input_->getPackets(pkts, max_packets, config_.time_offset);
+      if (recorder_ && rc > 0)
+        recorder_->record(pkts, rc);
+      return rc;
+    }
+
+  size_t count = max_packets;
+  velodyne_msgs::VelodynePacket *ready = ring_->peek(count);
+  if (count == 0)
+    {
+      // give up after as long as a socket read times out, so poll()
+      // still returns while the device is silent
+      boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(1);
+      boost::unique_lock<boost::mutex> lock(wakeup_mutex_);
+      assembler_waiting_ = true;
+      while (true)
+        {
+          count = max_packets;
+          ready = ring_->peek(count);
+          if (count > 0)
+            break;
+          if (input_failed_.exchange(false) || boost::get_system_time() >= deadline)
+            {
+              assembler_waiting_ = false;
+              return -1;
+            }
+          wakeup_.timed_wait(lock, boost::posix_time::milliseconds(100));
+        }
+      assembler_waiting_ = false;
+    }
+
+  std::copy(ready, ready + count, pkts);
+  ring_->release(count);
+  return count;
+}
+
+/** @brief Receive thread main loop.
+ *
+ *  Keeps reading the socket into free ring slots.  When the ring is
+ *  full, or the driver is disabled, the packets are still read, so the
+ *  socket does not overflow, but dropped.  Keeps waiting while the
+ *  device is silent, and retries after errors.
+ */
+void VelodyneDriver::receiveLoop()
+{
+  std::vector<velodyne_msgs::VelodynePacket> overflow(RECEIVE_BATCH);
+  while (receiving_)
+    {
+      size_t count = RECEIVE_BATCH;
+      velodyne_msgs::VelodynePacket *slots = ring_->acquire(count);
+      bool full = (count == 0);
+      if (full)
+        {
+          slots = &overflow[0];
+          count = overflow.size();
+        }
+
+      int rc = input_->getPackets(slots, count, config_.time_offset);
+      if (rc == Input::TIMEOUT)
+        continue;
+      if (rc < 0)
+        {
+          // fail the next poll(), and retry a little later instead of
+          // spinning on an error reported right away
+          input_failed_ = true;
+          notifyAssembler();
+          ros::Duration(0.1).sleep();
+          continue;
+        }
+      if (rc == 0 || !enabled_)
+        continue;
+      if (recorder_)
+        recorder_->record(slots, rc);
+
+      if (full)
+        {
+          ring_->drop(rc);
+          ROS_WARN_THROTTLE(1.0, "packet ring full, dropping packets");
+          continue;
+        }
+      ring_->publish(rc);
+      notifyAssembler();
+    }
+}
+
+void VelodyneDriver::notifyAssembler()
+{
+  // pairs with setting assembler_waiting_ before checking the ring
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (assembler_waiting_)
+    {
+      boost::lock_guard<boost::mutex> lock(wakeup_mutex_);
+      wakeup_.notify_one();
+    }
+}
+
+void VelodyneDriver::ringDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &status)
+{
+  uint64_t drops = ring_->drops();
+  if (drops > reported_drops_)
+    status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "packets dropped");
+  else
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, "no packets dropped");
+  reported_drops_ = drops;
+
+  status.add("capacity", ring_->capacity());
+  status.add("occupancy", ring_->occupancy());
+  status.add("max occupancy", ring_->takeMaxOccupancy());
+  status.add("dropped packets", drops);
+}
+
+void VelodyneDriver::recorderDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &status)
+{
+  uint64_t drops = recorder_->drops();
+  if (recorder_->failed())
+    status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "writing failed");
+  else if (drops > reported_record_drops_)
+    status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "packets dropped");
+  else
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, "recording");
+  reported_record_drops_ = drops;
+
+  status.add("files", recorder_->filesWritten());
+  status.add("packets", recorder_->packetsWritten());
+  status.add("bytes", recorder_->bytesWritten());
+  status.add("dropped packets", drops);
+}
+
 void VelodyneDriver::callback(velodyne_driver::VelodyneNodeConfig &config,
               uint32_t level)
 {
@@ -290,7 +533,7 @@ void VelodyneDriver::callback(velodyne_driver::VelodyneNodeConfig &config,
   }
   if (level & 2)
   {
-    config_.enabled = config.enabled;
+    enabled_ = config.enabled;
   }
 }
 
@@ -40,11 +40,17 @@
  *     InputSocket -- derived class reads live data from the device
  *              via a UDP socket
  *
+ *     InputFile -- base class replaying recorded packets
+ *
  *     InputPCAP -- derived class provides a similar interface from a
  *              PCAP dump
+ *
+ *     InputRawLog -- derived class provides a similar interface from a
+ *              raw packet log
  */
 
 #include <unistd.h>
+#include <math.h>
 #include <string>
 #include <sstream>
 #include <sys/socket.h>
@@ -53,7 +59,9 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/file.h>
+#include <algorithm>
 #include <velodyne_driver/input.h>
+#include <velodyne_driver/pcap_index.h>
 #include <velodyne_driver/time_conversion.hpp>
 
 namespace velodyne_driver
@@ -81,6 +89,18 @@ namespace velodyne_driver
                       << devip_str_);
   }
 
+  /** @brief Read up to max_packets packets, one at a time. */
+  int Input::getPackets(velodyne_msgs::VelodynePacket *pkts,
+                        int max_packets, const double time_offset)
+  {
+    if (max_packets < 1)
+      return 0;
+    int rc = getPacket(pkts, time_offset);
+    if (rc < 0)
+      return -1;
+    return (rc == 0) ? 1 : 0;
+  }
+
   ////////////////////////////////////////////////////////////////////////
   // InputSocket class implementation
   ////////////////////////////////////////////////////////////////////////
@@ -89,11 +109,30 @@ namespace velodyne_driver
    *
    *  @param private_nh ROS private handle for calling node.
    *  @param port UDP port number
+   *  @param packet_rate expected device packet frequency (Hz), used to
+   *         estimate the receive times of packets read in one batch
    */
-  InputSocket::InputSocket(ros::NodeHandle private_nh, uint16_t port):
+  InputSocket::InputSocket(ros::NodeHandle private_nh, uint16_t port,
+                           double packet_rate):
     Input(private_nh, port)
   {
     sockfd_ = -1;
+    packet_period_ = (packet_rate > 0.0) ? 1.0 / packet_rate : 0.0;
+
+    // number of datagrams read with a single recvmmsg() call
+    private_nh.param("socket_batch_size", batch_size_, 16);
+    if (batch_size_ < 1)
+      batch_size_ = 1;
+    msgs_.resize(batch_size_);
+    iovecs_.resize(batch_size_);
+    senders_.resize(batch_size_);
+
+    // room for one SCM_TIMESTAMPNS control message per datagram
+    private_nh.param("kernel_timestamps", kernel_timestamps_, false);
+    control_stride_ = (CMSG_SPACE(sizeof(timespec)) + sizeof(uint64_t) - 1)
+                      / sizeof(uint64_t);
+    if (kernel_timestamps_)
+      control_.resize(batch_size_ * control_stride_);
     
     if (!devip_str_.empty()) {
       inet_aton(devip_str_.c_str(),&devip_);
@@ -126,6 +165,41 @@ namespace velodyne_driver
         return;
       }
 
+    // A larger kernel receive buffer absorbs bursts while the driver
+    // is busy publishing.  Linux caps it at net.core.rmem_max.
+    int rcvbuf = 0;
+    private_nh.param("socket_buffer_size", rcvbuf, 0);
+    if (rcvbuf > 0)
+      {
+        if (setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF,
+                       &rcvbuf, sizeof(rcvbuf)) < 0)
+          ROS_WARN("setsockopt(SO_RCVBUF) error: %s", strerror(errno));
+
+        // the kernel reports twice the usable size
+        int actual = 0;
+        socklen_t actual_len = sizeof(actual);
+        getsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &actual, &actual_len);
+        if (actual / 2 < rcvbuf)
+          ROS_WARN_STREAM("socket receive buffer limited to " << actual / 2
+                          << " bytes, requested " << rcvbuf
+                          << " (see net.core.rmem_max)");
+        else
+          ROS_INFO_STREAM("socket receive buffer: " << actual / 2 << " bytes");
+      }
+
+    if (kernel_timestamps_)
+      {
+        int enable = 1;
+        if (setsockopt(sockfd_, SOL_SOCKET, SO_TIMESTAMPNS,
+                       &enable, sizeof(enable)) < 0)
+          {
+            ROS_WARN("setsockopt(SO_TIMESTAMPNS) error: %s", strerror(errno));
+            kernel_timestamps_ = false;
+          }
+        else
+          ROS_INFO("Using kernel receive timestamps.");
+      }
+
     ROS_DEBUG("Velodyne socket fd is %d\n", sockfd_);
   }
 
@@ -135,61 +209,83 @@ namespace velodyne_driver
     (void) close(sockfd_);
   }
 
-  /** @brief Get one velodyne packet. */
-  int InputSocket::getPacket(velodyne_msgs::VelodynePacket *pkt, const double time_offset)
+  /** @brief Wait until the socket has data to read.
+   *
+   *  @returns 0 if it has, TIMEOUT if not yet, -1 on error
+   */
+  int InputSocket::waitForInput()
   {
-    double time1 = ros::Time::now().toSec();
-
     struct pollfd fds[1];
     fds[0].fd = sockfd_;
     fds[0].events = POLLIN;
     static const int POLL_TIMEOUT = 1000; // one second (in msec)
 
+    // Unfortunately, the Linux kernel recvfrom() implementation
+    // uses a non-interruptible sleep() when waiting for data,
+    // which would cause this method to hang if the device is not
+    // providing data.  We poll() the device first to make sure
+    // the recvfrom() will not block.
+    //
+    // Note, however, that there is a known Linux kernel bug:
+    //
+    //   Under Linux, select() may report a socket file descriptor
+    //   as "ready for reading", while nevertheless a subsequent
+    //   read blocks.  This could for example happen when data has
+    //   arrived but upon examination has wrong checksum and is
+    //   discarded.  There may be other circumstances in which a
+    //   file descriptor is spuriously reported as ready.  Thus it
+    //   may be safer to use O_NONBLOCK on sockets that should not
+    //   block.
+
+    // poll() until input available
+    do
+      {
+        int retval = poll(fds, 1, POLL_TIMEOUT);
+        if (retval < 0)             // poll() error?
+          {
+            if (errno == EINTR)
+              return TIMEOUT;
+            ROS_ERROR("poll() error: %s", strerror(errno));
+            return -1;
+          }
+        if (retval == 0)            // poll() timeout?
+          {
+            ROS_WARN("Velodyne poll() timeout");
+            return TIMEOUT;
+          }
+        if ((fds[0].revents & POLLERR)
+            || (fds[0].revents & POLLHUP)
+            || (fds[0].revents & POLLNVAL)) // device error?
+          {
+            ROS_ERROR("poll() reports Velodyne error");
+            return -1;
+          }
+      } while ((fds[0].revents & POLLIN) == 0);
+
+    return 0;
+  }
+
+  /** @brief Get one velodyne packet. */
+  int InputSocket::getPacket(velodyne_msgs::VelodynePacket *pkt, const double time_offset)
+  {
+    if (kernel_timestamps_)
+      {
+        // only recvmsg() provides the control messages
+        int rc = getPackets(pkt, 1, time_offset);
+        if (rc < 0)
+          return -1;
+        return (rc == 1) ? 0 : 1;
+      }
+
+    double time1 = ros::Time::now().toSec();
+
     sockaddr_in sender_address;
     socklen_t sender_address_len = sizeof(sender_address);
 
     while (true)
       {
-        // Unfortunately, the Linux kernel recvfrom() implementation
-        // uses a non-interruptible sleep() when waiting for data,
-        // which would cause this method to hang if the device is not
-        // providing data.  We poll() the device first to make sure
-        // the recvfrom() will not block.
-        //
-        // Note, however, that there is a known Linux kernel bug:
-        //
-        //   Under Linux, select() may report a socket file descriptor
-        //   as "ready for reading", while nevertheless a subsequent
-        //   read blocks.  This could for example happen when data has
-        //   arrived but upon examination has wrong checksum and is
-        //   discarded.  There may be other circumstances in which a
-        //   file descriptor is spuriously reported as ready.  Thus it
-        //   may be safer to use O_NONBLOCK on sockets that should not
-        //   block.
-
-        // poll() until input available
-        do
-          {
-            int retval = poll(fds, 1, POLL_TIMEOUT);
-            if (retval < 0)             // poll() error?
-              {
-                if (errno != EINTR)
-                  ROS_ERROR("poll() error: %s", strerror(errno));
-                return -1;
-              }
-            if (retval == 0)            // poll() timeout?
-              {
-                ROS_WARN("Velodyne poll() timeout");
-                return -1;
-              }
-            if ((fds[0].revents & POLLERR)
-                || (fds[0].revents & POLLHUP)
-                || (fds[0].revents & POLLNVAL)) // device error?
-              {
-                ROS_ERROR("poll() reports Velodyne error");
-                return -1;
-              }
-          } while ((fds[0].revents & POLLIN) == 0);
+        if (waitForInput() < 0)
+          return -1;
 
         // Receive packets that should now be available from the
         // socket using a blocking read.
@@ -237,8 +333,110 @@ namespace velodyne_driver
     return 0;
   }
 
+  /** @brief Get all queued velodyne packets, up to max_packets.
+   *
+   *  Reads every datagram the kernel has queued with a single
+   *  recvmmsg() call, directly into the packet messages.
+   */
+  int InputSocket::getPackets(velodyne_msgs::VelodynePacket *pkts,
+                              int max_packets, const double time_offset)
+  {
+    if (max_packets > batch_size_)
+      max_packets = batch_size_;
+    if (max_packets < 1)
+      return 0;
+
+    int ready = waitForInput();
+    if (ready < 0)
+      return ready;
+
+    for (int i = 0; i < max_packets; ++i)
+      {
+        iovecs_[i].iov_base = &pkts[i].data[0];
+        iovecs_[i].iov_len = packet_size;
+        memset(&msgs_[i].msg_hdr, 0, sizeof(msgs_[i].msg_hdr));
+        msgs_[i].msg_hdr.msg_iov = &iovecs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_name = &senders_[i];
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        if (kernel_timestamps_)
+          {
+            msgs_[i].msg_hdr.msg_control = &control_[i * control_stride_];
+            msgs_[i].msg_hdr.msg_controllen = control_stride_ * sizeof(uint64_t);
+          }
+      }
+
+    int nmsgs = recvmmsg(sockfd_, &msgs_[0], max_packets, MSG_DONTWAIT, NULL);
+    if (nmsgs < 0)
+      {
+        if (errno == EWOULDBLOCK || errno == EINTR)
+          return 0;
+        perror("recvfail");
+        ROS_INFO("recvfail");
+        return -1;
+      }
+
+    // drop incomplete packets and packets from other devices, keeping
+    // the remaining ones in order at the front of the array
+    int count = 0;
+    for (int i = 0; i < nmsgs; ++i)
+      {
+        if (msgs_[i].msg_len != packet_size)
+          {
+            ROS_DEBUG_STREAM("incomplete Velodyne packet read: "
+                             << msgs_[i].msg_len << " bytes");
+            continue;
+          }
+        if (devip_str_ != ""
+            && senders_[i].sin_addr.s_addr != devip_.s_addr)
+          continue;
+        if (count != i)
+          memcpy(&pkts[count].data[0], &pkts[i].data[0], packet_size);
+
+        pkts[count].stamp = ros::Time();
+        if (gps_time_)
+          {
+            pkts[count].stamp = rosTimeFromGpsTimestamp(&(pkts[count].data[1200]));
+          }
+        else if (kernel_timestamps_)
+          {
+            // arrival time of the datagram, taken by the kernel
+            for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs_[i].msg_hdr); cmsg != NULL;
+                 cmsg = CMSG_NXTHDR(&msgs_[i].msg_hdr, cmsg))
+              {
+                if (cmsg->cmsg_level == SOL_SOCKET
+                    && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+                  {
+                    timespec arrival;
+                    memcpy(&arrival, CMSG_DATA(cmsg), sizeof(arrival));
+                    pkts[count].stamp = ros::Time(arrival.tv_sec, arrival.tv_nsec)
+                                        + ros::Duration(time_offset);
+                  }
+              }
+          }
+        ++count;
+      }
+
+    // Without a kernel timestamp only the last packet of the batch was
+    // just received, the earlier ones were waiting in the socket buffer.
+    // Assume they arrived at the device packet rate.
+    ros::Time now;
+    for (int i = 0; i < count; ++i)
+      {
+        if (pkts[i].stamp.isZero())
+          {
+            if (now.isZero())
+              now = ros::Time::now();
+            double age = (count - 1 - i) * packet_period_;
+            pkts[i].stamp = ros::Time(now.toSec() - age + time_offset);
+          }
+      }
+
+    return count;
+  }
+
   ////////////////////////////////////////////////////////////////////////
-  // InputPCAP class implementation
+  // InputFile class implementation
   ////////////////////////////////////////////////////////////////////////
 
   /** @brief constructor
@@ -246,89 +444,209 @@ namespace velodyne_driver
    *  @param private_nh ROS private handle for calling node.
    *  @param port UDP port number
    *  @param packet_rate expected device packet frequency (Hz)
-   *  @param filename PCAP dump file name
    */
-  InputPCAP::InputPCAP(ros::NodeHandle private_nh, uint16_t port,
-                       double packet_rate, std::string filename,
-                       bool read_once, bool read_fast, double repeat_delay):
+  InputFile::InputFile(ros::NodeHandle private_nh, uint16_t port,
+                       double packet_rate):
     Input(private_nh, port),
-    packet_rate_(packet_rate),
-    filename_(filename)
+    bytes_read_(0),
+    pending_payload_(NULL),
+    pending_stamp_(0),
+    have_pending_(false),
+    pending_deadline_(0)
   {
-    pcap_ = NULL;  
     empty_ = true;
 
     // get parameters using private node handle
     private_nh.param("read_once", read_once_, false);
     private_nh.param("read_fast", read_fast_, false);
     private_nh.param("repeat_delay", repeat_delay_, 0.0);
+    double speed;
+    private_nh.param("replay_speed", speed, 1.0);
 
     if (read_once_)
       ROS_INFO("Read input file only once.");
     if (read_fast_)
       ROS_INFO("Read input file as quickly as possible.");
+    else
+      {
+        if (speed != ReplayScheduler::clampSpeed(speed))
+          ROS_WARN("replay_speed %.2f out of range [%.1f, %.1f]", speed,
+                   ReplayScheduler::MIN_SPEED, ReplayScheduler::MAX_SPEED);
+        // packets captured without a time stamp follow the device packet rate
+        scheduler_ = ReplayScheduler(speed, packet_rate > 0.0 ? 1.0 / packet_rate : 0.0);
+        ROS_INFO("Replay input file at %.2fx its capture speed.",
+                 scheduler_.speed());
+      }
     if (repeat_delay_ > 0.0)
       ROS_INFO("Delay %.3f seconds before repeating input file.",
                repeat_delay_);
 
-    // Open the PCAP dump file
-    ROS_INFO("Opening PCAP file \"%s\"", filename_.c_str());
-    if ((pcap_ = pcap_open_offline(filename_.c_str(), errbuf_) ) == NULL)
+    // optionally read only part of the file, by revolution or time
+    private_nh.param("pcap_start", start_, 0.0);
+    private_nh.param("pcap_first_revolution", first_revolution_, 0);
+    private_nh.param("pcap_revolutions", revolutions_, 0);
+
+    read_start_ = ros::WallTime::now();
+  }
+
+  bool InputFile::rangeRequested() const
+  {
+    return start_ > 0.0 || first_revolution_ > 0 || revolutions_ > 0;
+  }
+
+  void InputFile::selectRevolutions(size_t count, size_t start_revolution,
+                                    size_t &first, size_t &end) const
+  {
+    if (count == 0)
       {
-        ROS_FATAL("Error opening Velodyne socket dump file.");
+        first = end = 0;
         return;
       }
+    first = first_revolution_ > 0 ? first_revolution_ : 0;
+    if (start_ > 0.0)
+      first = std::max(first, start_revolution);
+    first = std::min(first, count - 1);
+    end = count;
+    if (revolutions_ > 0)
+      end = std::min(end, first + revolutions_);
+    ROS_INFO("reading revolutions %zu to %zu of %zu", first, end - 1, count);
+  }
 
-    std::stringstream filter;
-    if( devip_str_ != "" )              // using specific IP?
+  /** @brief Get one velodyne packet. */
+  int InputFile::getPacket(velodyne_msgs::VelodynePacket *pkt, const double time_offset)
+  {
+    return getPackets(pkt, 1, time_offset) > 0 ? 0 : -1;
+  }
+
+  /** @brief Copy the next max_packets packets, without delay. */
+  int InputFile::readFast(velodyne_msgs::VelodynePacket *pkts, int max_packets)
+  {
+    int count = 0;
+    const uint8_t *payload;
+    uint64_t stamp_ns;
+    while (count < max_packets && nextPacket(payload, stamp_ns))
       {
-        filter << "src host " << devip_str_ << " && ";
+        velodyne_msgs::VelodynePacket &pkt = pkts[count++];
+        memcpy(&pkt.data[0], payload, packet_size);
+        pkt.stamp = ros::Time::now(); // time_offset not considered here, as no synchronization required
       }
-    filter << "udp dst port " << port;
-    pcap_compile(pcap_, &pcap_packet_filter_,
-                 filter.str().c_str(), 1, PCAP_NETMASK_UNKNOWN);
+    bytes_read_ += count * packet_size;
+    return count;
   }
 
-  /** destructor */
-  InputPCAP::~InputPCAP(void)
+  /** @brief Release the packets due within the next batch period.
+   *
+   *  Reads packets while they are due less than REPLAY_BATCH after the
+   *  first one, then sleeps once, until the last one is due.  The
+   *  packets are stamped with the time they were due, so they keep
+   *  their captured spacing.
+   */
+  int InputFile::readScheduled(velodyne_msgs::VelodynePacket *pkts, int max_packets)
   {
-    pcap_close(pcap_);
+    static const int64_t REPLAY_BATCH = 5000000;    // ns
+
+    int count = 0;
+    int64_t now = ReplayScheduler::now();
+    int64_t first_deadline = 0;
+    int64_t last_deadline = 0;
+    deadlines_.resize(std::max<size_t>(deadlines_.size(), max_packets));
+    while (count < max_packets)
+      {
+        const uint8_t *payload;
+        int64_t deadline;
+        if (have_pending_)
+          {
+            payload = pending_payload_;
+            deadline = pending_deadline_;
+            have_pending_ = false;
+          }
+        else
+          {
+            uint64_t stamp_ns;
+            if (!nextPacket(payload, stamp_ns))
+              break;
+            deadline = scheduler_.schedule(stamp_ns, now);
+          }
+
+        if (count == 0)
+          first_deadline = deadline;
+        else if (deadline - first_deadline > REPLAY_BATCH)
+          {
+            // belongs to the next batch
+            pending_payload_ = payload;
+            pending_deadline_ = deadline;
+            have_pending_ = true;
+            break;
+          }
+
+        memcpy(&pkts[count].data[0], payload, packet_size);
+        deadlines_[count++] = deadline;
+        last_deadline = deadline;
+      }
+    if (count == 0)
+      return 0;
+
+    // Keep the reader from blowing through the file.
+    ReplayScheduler::sleepUntil(last_deadline);
+    now = ReplayScheduler::now();
+    ros::Time stamp = ros::Time::now();
+    scheduler_.released(last_deadline, now);
+
+    for (int i = 0; i < count; ++i)
+      {
+        // time_offset not considered here, as no synchronization required
+        int64_t age = std::max<int64_t>(now - deadlines_[i], 0);
+        pkts[i].stamp = stamp - ros::Duration(age * 1e-9);
+      }
+    bytes_read_ += count * packet_size;
+    return count;
   }
 
-  /** @brief Get one velodyne packet. */
-  int InputPCAP::getPacket(velodyne_msgs::VelodynePacket *pkt, const double time_offset)
+  /** @brief Get up to max_packets velodyne packets. */
+  int InputFile::getPackets(velodyne_msgs::VelodynePacket *pkts,
+                            int max_packets,
+                            const double time_offset)
   {
-    struct pcap_pkthdr *header;
-    const u_char *pkt_data;
+    if (!isOpen())
+      return -1;
 
     while (true)
       {
-        int res;
-        if ((res = pcap_next_ex(pcap_, &header, &pkt_data)) >= 0)
+        int count;
+        if (read_fast_)
+          count = readFast(pkts, max_packets);
+        else
+          count = readScheduled(pkts, max_packets);
+        if (count > 0)
           {
-            // Skip packets not for the correct port and from the
-            // selected IP address.
-            if (0 == pcap_offline_filter(&pcap_packet_filter_,
-                                          header, pkt_data))
-              continue;
-
-            // Keep the reader from blowing through the file.
-            if (read_fast_ == false)
-              packet_rate_.sleep();
-            
-            memcpy(&pkt->data[0], pkt_data+42, packet_size);
-            pkt->stamp = ros::Time::now(); // time_offset not considered here, as no synchronization required
             empty_ = false;
-            return 0;                   // success
+            return count;               // success
           }
 
         if (empty_)                 // no data in file?
           {
-            ROS_WARN("Error %d reading Velodyne packet: %s", 
-                     res, pcap_geterr(pcap_));
+            std::string error = readError();
+            ROS_WARN("Error reading Velodyne packet: %s",
+                     error.empty() ? "no data packets in file" : error.c_str());
             return -1;
           }
 
+        if (read_fast_)
+          {
+            double elapsed = (ros::WallTime::now() - read_start_).toSec();
+            if (elapsed > 0.0)
+              ROS_INFO("read %.1f MB of packet data at %.3f GB/s",
+                       bytes_read_ / 1e6, bytes_read_ / elapsed / 1e9);
+          }
+        else
+          {
+            ROS_INFO("replayed %llu packets at %.1f Hz, target %.1f Hz "
+                     "(%.2fx speed), released up to %.3f ms late",
+                     (unsigned long long) scheduler_.packets(),
+                     scheduler_.achievedRate(), scheduler_.targetRate(),
+                     scheduler_.speed(), scheduler_.maxLateness() * 1e3);
+          }
+
         if (read_once_)
           {
             ROS_INFO("end of file reached -- done reading.");
@@ -344,13 +662,172 @@ namespace velodyne_driver
 
         ROS_DEBUG("replaying Velodyne dump file");
 
-        // I can't figure out how to rewind the file, because it
-        // starts with some kind of header.  So, close the file
-        // and reopen it with pcap.
-        pcap_close(pcap_);
-        pcap_ = pcap_open_offline(filename_.c_str(), errbuf_);
-        empty_ = true;              // maybe the file disappeared?
+        // The file stays mapped, just start over.
+        restart();
+        empty_ = true;
+        bytes_read_ = 0;
+        read_start_ = ros::WallTime::now();
+        scheduler_.reset();
+        scheduler_.resetStatistics();
       } // loop back and try again
   }
 
+  ////////////////////////////////////////////////////////////////////////
+  // InputPCAP class implementation
+  ////////////////////////////////////////////////////////////////////////
+
+  /** @brief constructor
+   *
+   *  @param private_nh ROS private handle for calling node.
+   *  @param port UDP port number
+   *  @param packet_rate expected device packet frequency (Hz)
+   *  @param filename PCAP or PCAPNG dump file name
+   */
+  InputPCAP::InputPCAP(ros::NodeHandle private_nh, uint16_t port,
+                       double packet_rate, std::string filename,
+                       bool read_once, bool read_fast, double repeat_delay):
+    InputFile(private_nh, port, packet_rate),
+    filename_(filename),
+    range_begin_(0),
+    range_end_(0)
+  {
+    // Open the PCAP dump file
+    ROS_INFO("Opening PCAP file \"%s\"", filename_.c_str());
+    if (!reader_.open(filename_))
+      {
+        ROS_FATAL("Error opening Velodyne socket dump file: %s",
+                  reader_.error().c_str());
+        return;
+      }
+
+    in_addr devip;
+    devip.s_addr = 0;
+    if (devip_str_ != "")               // using specific IP?
+      inet_aton(devip_str_.c_str(), &devip);
+    reader_.setFilter(port, devip.s_addr);
+    range_begin_ = 0;
+    range_end_ = reader_.size();
+
+    if (rangeRequested())
+      {
+        // revolutions start where the driver cuts scans, or at 0 degrees
+        double cut_angle;
+        private_nh.param("cut_angle", cut_angle, -0.01);
+        int cut = (cut_angle < 0.0 || cut_angle >= 2*M_PI) ? 0
+          : int((cut_angle*360/(2*M_PI))*100);
+
+        PcapIndex index;
+        if (!index.open(filename_, reader_, cut, port, devip.s_addr)
+            || index.size() == 0)
+          {
+            ROS_ERROR("unable to index PCAP file, reading all of it");
+          }
+        else
+          {
+            size_t first;
+            size_t end;
+            selectRevolutions(index.size(),
+                              index.find(index[0].stamp_ns + start_ * 1e9),
+                              first, end);
+            range_begin_ = index[first].offset;
+            if (end < index.size())
+              range_end_ = index[end].offset;
+            reader_.seek(range_begin_);
+          }
+      }
+  }
+
+  /** destructor */
+  InputPCAP::~InputPCAP(void)
+  {
+  }
+
+  /** @brief Get the next data packet in the range read. */
+  bool InputPCAP::nextPacket(const uint8_t *&payload, uint64_t &stamp_ns)
+  {
+    PcapRecord record;
+    while (reader_.next(record))
+      {
+        if (record.offset >= range_end_)
+          return false;
+        // Skip datagrams too short to be data packets.
+        if (record.length >= packet_size)
+          {
+            payload = record.payload;
+            stamp_ns = record.stamp_ns;
+            return true;
+          }
+      }
+    return false;
+  }
+
+  void InputPCAP::restart()
+  {
+    if (range_begin_ > 0)
+      reader_.seek(range_begin_);
+    else
+      reader_.rewind();
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // InputRawLog class implementation
+  ////////////////////////////////////////////////////////////////////////
+
+  /** @brief constructor
+   *
+   *  @param private_nh ROS private handle for calling node.
+   *  @param port UDP port number, not used
+   *  @param packet_rate expected device packet frequency (Hz)
+   *  @param filename raw packet log file name
+   */
+  InputRawLog::InputRawLog(ros::NodeHandle private_nh, uint16_t port,
+                           double packet_rate, std::string filename):
+    InputFile(private_nh, port, packet_rate),
+    filename_(filename),
+    first_(0),
+    end_packet_(UINT64_MAX)
+  {
+    ROS_INFO("Opening raw packet log \"%s\"", filename_.c_str());
+    if (!reader_.open(filename_))
+      {
+        ROS_FATAL("Error opening raw packet log: %s", reader_.error().c_str());
+        return;
+      }
+
+    if (rangeRequested())
+      {
+        const std::vector<RawLogRevolution> &index = reader_.revolutions();
+        if (index.empty())
+          {
+            ROS_ERROR("raw packet log has no index, reading all of it");
+          }
+        else
+          {
+            size_t end;
+            selectRevolutions(index.size(),
+                              reader_.findRevolution(index[0].stamp_ns + start_ * 1e9),
+                              first_, end);
+            if (end < index.size())
+              end_packet_ = index[end].packet_number;
+            restart();
+          }
+      }
+  }
+
+  /** @brief Get the next packet in the range read. */
+  bool InputRawLog::nextPacket(const uint8_t *&payload, uint64_t &stamp_ns)
+  {
+    if (reader_.packetNumber() >= end_packet_)
+      return false;
+    return reader_.next(payload, stamp_ns);
+  }
+
+  void InputRawLog::restart()
+  {
+    if (first_ > 0)
+      reader_.seek(first_);
+    else
+      reader_.rewind();
+  }
+
 } // velodyne namespace
@@ -0,0 +1,334 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Recorder of received packets into rotating PCAP files or raw
+ *  packet logs.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <ros/ros.h>
+#include <velodyne_driver/packet_recorder.h>
+#include <velodyne_driver/pcap_index.h>
+
+namespace velodyne_driver
+{
+  static const size_t packet_size =
+    sizeof(velodyne_msgs::VelodynePacket().data);
+  static const size_t HEADERS_SIZE = 14 + 20 + 8;   // Ethernet, IPv4, UDP
+  static const size_t RECORD_SIZE = 16 + HEADERS_SIZE + packet_size;
+  static const size_t WRITE_SIZE = 4 << 20;         // bytes per write()
+  static const size_t WRITE_BATCH = 256;            // packets taken from the ring at once
+
+  static void put16be(uint8_t *p, uint16_t v)
+  {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+  }
+
+  PacketRecorder::PacketRecorder(const Options &options):
+    options_(options),
+    ring_(options.ring_size),
+    running_(true),
+    buffer_(WRITE_SIZE),
+    buffered_(0),
+    fd_(-1),
+    file_bytes_(0),
+    file_number_(0),
+    last_azimuth_(-1),
+    new_revolution_(false),
+    packets_written_(0),
+    bytes_written_(0),
+    files_written_(0),
+    failed_(false)
+  {
+    // The headers are the same for every packet: Velodyne's MAC prefix
+    // and default address, broadcasting to the data port.
+    headers_.assign(HEADERS_SIZE, 0);
+    uint8_t *ethernet = &headers_[0];
+    memset(ethernet, 0xff, 6);
+    const uint8_t source_mac[6] = {0x60, 0x76, 0x88, 0x00, 0x00, 0x00};
+    memcpy(ethernet + 6, source_mac, sizeof(source_mac));
+    put16be(ethernet + 12, 0x0800);
+
+    uint8_t *ip = ethernet + 14;
+    ip[0] = 0x45;
+    put16be(ip + 2, 20 + 8 + packet_size);
+    put16be(ip + 6, 0x4000);            // don't fragment
+    ip[8] = 255;                        // time to live
+    ip[9] = 17;                         // UDP
+    const uint8_t default_source[4] = {192, 168, 1, 201};
+    if (options_.src_addr != 0)
+      memcpy(ip + 12, &options_.src_addr, 4);
+    else
+      memcpy(ip + 12, default_source, 4);
+    memset(ip + 16, 0xff, 4);
+    uint32_t sum = 0;
+    for (int i = 0; i < 20; i += 2)
+      sum += (ip[i] << 8) | ip[i + 1];
+    while (sum >> 16)
+      sum = (sum & 0xffff) + (sum >> 16);
+    put16be(ip + 10, ~sum & 0xffff);
+
+    uint8_t *udp = ip + 20;
+    put16be(udp, 2368);
+    put16be(udp + 2, options_.port);
+    put16be(udp + 4, 8 + packet_size);
+
+    thread_ = boost::thread(boost::bind(&PacketRecorder::writeLoop, this));
+  }
+
+  PacketRecorder::~PacketRecorder()
+  {
+    running_ = false;
+    thread_.join();
+  }
+
+  void PacketRecorder::record(const velodyne_msgs::VelodynePacket *pkts, size_t count)
+  {
+    // the free slots may wrap around the end of the ring
+    for (int part = 0; part < 2 && count > 0; ++part)
+      {
+        size_t n = count;
+        velodyne_msgs::VelodynePacket *slots = ring_.acquire(n);
+        std::copy(pkts, pkts + n, slots);
+        ring_.publish(n);
+        pkts += n;
+        count -= n;
+      }
+    if (count > 0)
+      ring_.drop(count);
+  }
+
+  void PacketRecorder::writeLoop()
+  {
+    while (true)
+      {
+        // check before taking packets, so none recorded before
+        // stopping are left behind
+        bool running = running_;
+        size_t count = WRITE_BATCH;
+        velodyne_msgs::VelodynePacket *pkts = ring_.peek(count);
+        if (count == 0)
+          {
+            if (!running)
+              break;
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+            continue;
+          }
+
+        for (size_t i = 0; i < count && !failed_; ++i)
+          {
+            if (options_.raw)
+              writeRaw(pkts[i]);
+            else
+              write(pkts[i]);
+          }
+        ring_.release(count);
+      }
+
+    if (!failed_)
+      flush();
+    closeFile();
+  }
+
+  /** @brief Append one packet to the write buffer. */
+  void PacketRecorder::write(const velodyne_msgs::VelodynePacket &pkt)
+  {
+    if (fd_ < 0 || (new_revolution_ && file_bytes_ >= options_.file_size))
+      {
+        if (!openFile())
+          {
+            failed_ = true;
+            return;
+          }
+      }
+    if (buffered_ + RECORD_SIZE > buffer_.size() && !flush())
+      {
+        failed_ = true;
+        return;
+      }
+
+    uint8_t *record = &buffer_[buffered_];
+    const uint32_t header[4] = {pkt.stamp.sec, pkt.stamp.nsec,
+                                static_cast<uint32_t>(HEADERS_SIZE + packet_size),
+                                static_cast<uint32_t>(HEADERS_SIZE + packet_size)};
+    memcpy(record, header, sizeof(header));
+    memcpy(record + sizeof(header), &headers_[0], HEADERS_SIZE);
+    memcpy(record + sizeof(header) + HEADERS_SIZE, &pkt.data[0], packet_size);
+    buffered_ += RECORD_SIZE;
+    file_bytes_ += RECORD_SIZE;
+    ++packets_written_;
+
+    // Same as VelodyneDriver::poll(), the packet passing the cut angle
+    // still belongs to the revolution it ends.
+    int azimuth = pkt.data[2] | (pkt.data[3] << 8);
+    new_revolution_ = (last_azimuth_ != -1
+                       && passesCutAngle(last_azimuth_, azimuth, options_.cut_angle));
+    last_azimuth_ = azimuth;
+  }
+
+  /** @brief Append one packet to the raw packet log. */
+  void PacketRecorder::writeRaw(const velodyne_msgs::VelodynePacket &pkt)
+  {
+    if (!raw_log_.isOpen() || (new_revolution_ && file_bytes_ >= options_.file_size))
+      {
+        if (!openFile())
+          {
+            failed_ = true;
+            return;
+          }
+      }
+
+    // the writer buffers whole chunks itself
+    uint64_t stamp_ns = pkt.stamp.sec * 1000000000ull + pkt.stamp.nsec;
+    uint64_t before = raw_log_.bytesWritten();
+    if (!raw_log_.write(stamp_ns, &pkt.data[0], new_revolution_))
+      {
+        ROS_ERROR("recording packets failed, stopped: %s",
+                  raw_log_.error().c_str());
+        failed_ = true;
+        return;
+      }
+    bytes_written_ += raw_log_.bytesWritten() - before;
+    file_bytes_ = raw_log_.bytesWritten();
+    ++packets_written_;
+
+    int azimuth = pkt.data[2] | (pkt.data[3] << 8);
+    new_revolution_ = (last_azimuth_ != -1
+                       && passesCutAngle(last_azimuth_, azimuth, options_.cut_angle));
+    last_azimuth_ = azimuth;
+  }
+
+  /** @brief Start the next file, removing the oldest one beyond max_files. */
+  bool PacketRecorder::openFile()
+  {
+    if (fd_ >= 0 || raw_log_.isOpen())
+      {
+        if (!flush())
+          return false;
+        closeFile();
+      }
+
+    char number[16];
+    snprintf(number, sizeof(number), "%04d", file_number_++);
+    std::string name = options_.prefix + number
+      + (options_.raw ? ".vlog" : ".pcap");
+    if (options_.raw)
+      {
+        if (!raw_log_.open(name, options_.compression, options_.cut_angle))
+          {
+            ROS_ERROR("unable to record packets to \"%s\": %s",
+                      name.c_str(), raw_log_.error().c_str());
+            return false;
+          }
+      }
+    else
+      {
+        fd_ = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+          {
+            ROS_ERROR("unable to record packets to \"%s\": %s",
+                      name.c_str(), strerror(errno));
+            return false;
+          }
+      }
+    ROS_DEBUG("recording packets to \"%s\"", name.c_str());
+
+    files_.push_back(name);
+    if (options_.max_files > 0 && files_.size() > (size_t) options_.max_files)
+      {
+        unlink(files_.front().c_str());
+        files_.pop_front();
+      }
+    ++files_written_;
+    if (options_.raw)
+      {
+        file_bytes_ = raw_log_.bytesWritten();
+        return true;
+      }
+
+    // PCAP file header: nanosecond time stamps, Ethernet
+    const uint32_t header[6] = {0xa1b23c4d, 0x00040002, 0, 0, 65535, 1};
+    memcpy(&buffer_[buffered_], header, sizeof(header));
+    buffered_ += sizeof(header);
+    file_bytes_ = sizeof(header);
+    return true;
+  }
+
+  void PacketRecorder::closeFile()
+  {
+    if (fd_ >= 0)
+      ::close(fd_);
+    fd_ = -1;
+
+    // writes the last chunk and the revolution index
+    uint64_t before = raw_log_.bytesWritten();
+    if (raw_log_.isOpen() && !raw_log_.close())
+      {
+        ROS_ERROR("recording packets failed: %s", raw_log_.error().c_str());
+        failed_ = true;
+      }
+    bytes_written_ += raw_log_.bytesWritten() - before;
+  }
+
+  /** @brief Write the buffer to the current file. */
+  bool PacketRecorder::flush()
+  {
+    if (fd_ < 0)
+      return true;
+    size_t written = 0;
+    while (written < buffered_)
+      {
+        ssize_t rc = ::write(fd_, &buffer_[written], buffered_ - written);
+        if (rc < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            ROS_ERROR("recording packets failed, stopped: %s", strerror(errno));
+            buffered_ = 0;
+            return false;
+          }
+        written += rc;
+      }
+    bytes_written_ += buffered_;
+    buffered_ = 0;
+    return true;
+  }
+
+}  // namespace velodyne_driver
@@ -0,0 +1,219 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Revolution index of a PCAP dump file, and its sidecar file.
+ *
+ *  The sidecar file is in host byte order:
+ *
+ *    "VLPCAPIX"  8 byte magic, version in the last two characters
+ *    Key         file_size, mtime_ns, cut_angle, port, src_addr
+ *    uint64_t    number of revolutions
+ *    entries     offset, stamp_ns, azimuth
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <ros/ros.h>
+#include <velodyne_msgs/VelodynePacket.h>
+#include <velodyne_driver/pcap_index.h>
+
+namespace velodyne_driver
+{
+  static const char INDEX_MAGIC[8] = {'V', 'L', 'P', 'C', 'A', 'P', '0', '1'};
+
+  PcapIndex::PcapIndex()
+  {
+    memset(&key_, 0, sizeof(key_));
+  }
+
+  bool PcapIndex::open(const std::string &filename, PcapReader &reader,
+                       int cut_angle, uint16_t port, uint32_t src_addr)
+  {
+    struct stat st;
+    if (!reader.isOpen() || stat(filename.c_str(), &st) < 0)
+      return false;
+
+    Key key;
+    memset(&key, 0, sizeof(key));
+    key.file_size = st.st_size;
+    key.mtime_ns = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+    key.cut_angle = cut_angle;
+    key.port = port;
+    key.src_addr = src_addr;
+
+    std::string sidecar = sidecarName(filename);
+    if (load(sidecar, key))
+      {
+        ROS_INFO("loaded %zu revolutions from index \"%s\"",
+                 size(), sidecar.c_str());
+        return !revolutions_.empty();
+      }
+
+    ROS_INFO("indexing revolutions of \"%s\"", filename.c_str());
+    build(reader, key, sizeof(velodyne_msgs::VelodynePacket().data));
+    if (!save(sidecar))
+      ROS_WARN("unable to save index \"%s\"", sidecar.c_str());
+    ROS_INFO("indexed %zu revolutions", size());
+    return !revolutions_.empty();
+  }
+
+  void PcapIndex::build(PcapReader &reader, const Key &key, size_t min_length)
+  {
+    key_ = key;
+    revolutions_.clear();
+
+    reader.rewind();
+    PcapRecord record;
+    int last_azimuth = -1;
+    bool cut = true;                    // the first packet starts a revolution
+    while (reader.next(record))
+      {
+        if (record.length < min_length || record.length < 4)
+          continue;
+        int azimuth = record.payload[2] | (record.payload[3] << 8);
+        if (cut)
+          {
+            RevolutionEntry entry;
+            entry.offset = record.offset;
+            entry.stamp_ns = record.stamp_ns;
+            entry.azimuth = azimuth;
+            revolutions_.push_back(entry);
+          }
+
+        // Same as VelodyneDriver::poll(), the packet passing the cut
+        // angle still belongs to the revolution it ends.
+        cut = (last_azimuth != -1
+               && passesCutAngle(last_azimuth, azimuth, key.cut_angle));
+        last_azimuth = azimuth;
+      }
+    reader.rewind();
+  }
+
+  bool PcapIndex::load(const std::string &filename, const Key &key)
+  {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == NULL)
+      return false;
+
+    char magic[sizeof(INDEX_MAGIC)];
+    Key stored;
+    uint64_t count = 0;
+    bool ok = (fread(magic, sizeof(magic), 1, file) == 1
+               && memcmp(magic, INDEX_MAGIC, sizeof(magic)) == 0
+               && fread(&stored.file_size, sizeof(stored.file_size), 1, file) == 1
+               && fread(&stored.mtime_ns, sizeof(stored.mtime_ns), 1, file) == 1
+               && fread(&stored.cut_angle, sizeof(stored.cut_angle), 1, file) == 1
+               && fread(&stored.port, sizeof(stored.port), 1, file) == 1
+               && fread(&stored.src_addr, sizeof(stored.src_addr), 1, file) == 1
+               && fread(&count, sizeof(count), 1, file) == 1);
+    ok = ok
+      && stored.file_size == key.file_size
+      && stored.mtime_ns == key.mtime_ns
+      && stored.cut_angle == key.cut_angle
+      && stored.port == key.port
+      && stored.src_addr == key.src_addr
+      && count <= key.file_size;        // sanity check before allocating
+
+    std::vector<RevolutionEntry> revolutions;
+    if (ok)
+      {
+        revolutions.resize(count);
+        for (size_t i = 0; ok && i < count; ++i)
+          {
+            RevolutionEntry &entry = revolutions[i];
+            ok = (fread(&entry.offset, sizeof(entry.offset), 1, file) == 1
+                  && fread(&entry.stamp_ns, sizeof(entry.stamp_ns), 1, file) == 1
+                  && fread(&entry.azimuth, sizeof(entry.azimuth), 1, file) == 1
+                  && entry.offset < key.file_size);
+          }
+      }
+    fclose(file);
+
+    if (!ok)
+      return false;
+    key_ = key;
+    revolutions_.swap(revolutions);
+    return true;
+  }
+
+  bool PcapIndex::save(const std::string &filename) const
+  {
+    // write a temporary file first, so readers never see half an index
+    std::string temporary = filename + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == NULL)
+      return false;
+
+    uint64_t count = revolutions_.size();
+    bool ok = (fwrite(INDEX_MAGIC, sizeof(INDEX_MAGIC), 1, file) == 1
+               && fwrite(&key_.file_size, sizeof(key_.file_size), 1, file) == 1
+               && fwrite(&key_.mtime_ns, sizeof(key_.mtime_ns), 1, file) == 1
+               && fwrite(&key_.cut_angle, sizeof(key_.cut_angle), 1, file) == 1
+               && fwrite(&key_.port, sizeof(key_.port), 1, file) == 1
+               && fwrite(&key_.src_addr, sizeof(key_.src_addr), 1, file) == 1
+               && fwrite(&count, sizeof(count), 1, file) == 1);
+    for (size_t i = 0; ok && i < revolutions_.size(); ++i)
+      {
+        const RevolutionEntry &entry = revolutions_[i];
+        ok = (fwrite(&entry.offset, sizeof(entry.offset), 1, file) == 1
+              && fwrite(&entry.stamp_ns, sizeof(entry.stamp_ns), 1, file) == 1
+              && fwrite(&entry.azimuth, sizeof(entry.azimuth), 1, file) == 1);
+      }
+    ok = (fclose(file) == 0) && ok;
+
+    if (ok)
+      ok = (rename(temporary.c_str(), filename.c_str()) == 0);
+    if (!ok)
+      remove(temporary.c_str());
+    return ok;
+  }
+
+  static bool startsBefore(uint64_t stamp_ns, const RevolutionEntry &entry)
+  {
+    return stamp_ns < entry.stamp_ns;
+  }
+
+  size_t PcapIndex::find(uint64_t stamp_ns) const
+  {
+    std::vector<RevolutionEntry>::const_iterator it =
+      std::upper_bound(revolutions_.begin(), revolutions_.end(),
+                       stamp_ns, startsBefore);
+    if (it == revolutions_.begin())
+      return 0;
+    return (it - revolutions_.begin()) - 1;
+  }
+
+}  // namespace velodyne_driver
@@ -0,0 +1,522 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Memory mapped PCAP and PCAPNG reader.
+ *
+ *  File format references:
+ *    https://wiki.wireshark.org/Development/LibpcapFileFormat
+ *    https://www.ietf.org/archive/id/draft-tuexen-opsawg-pcapng-03.html
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <byteswap.h>
+#include <velodyne_driver/pcap_reader.h>
+
+namespace velodyne_driver
+{
+  // PCAP file header magic numbers, microsecond and nanosecond timestamps
+  static const uint32_t PCAP_MAGIC_US = 0xa1b2c3d4;
+  static const uint32_t PCAP_MAGIC_NS = 0xa1b23c4d;
+  static const size_t PCAP_FILE_HEADER_SIZE = 24;
+  static const size_t PCAP_RECORD_HEADER_SIZE = 16;
+
+  // PCAPNG block types
+  static const uint32_t PCAPNG_SECTION_HEADER = 0x0a0d0d0a;
+  static const uint32_t PCAPNG_INTERFACE_DESCRIPTION = 1;
+  static const uint32_t PCAPNG_SIMPLE_PACKET = 3;
+  static const uint32_t PCAPNG_ENHANCED_PACKET = 6;
+  static const uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+  static const uint16_t PCAPNG_OPTION_END = 0;
+  static const uint16_t PCAPNG_OPTION_TSRESOL = 9;
+
+  // link layer header types
+  static const uint16_t LINKTYPE_NULL = 0;
+  static const uint16_t LINKTYPE_ETHERNET = 1;
+  static const uint16_t LINKTYPE_RAW = 101;
+  static const uint16_t LINKTYPE_LINUX_SLL = 113;
+  static const uint16_t LINKTYPE_IPV4 = 228;
+  static const uint16_t LINKTYPE_LINUX_SLL2 = 276;
+
+  static const uint16_t ETHERTYPE_IPV4 = 0x0800;
+  static const uint16_t ETHERTYPE_VLAN = 0x8100;
+  static const uint16_t ETHERTYPE_QINQ = 0x88a8;
+  static const uint8_t IP_PROTOCOL_UDP = 17;
+  static const size_t UDP_HEADER_SIZE = 8;
+
+  // big endian fields of network headers
+  static inline uint16_t net16(const uint8_t *p)
+  {
+    return (p[0] << 8) | p[1];
+  }
+
+  PcapReader::PcapReader():
+    data_(NULL),
+    size_(0),
+    offset_(0),
+    first_record_(0),
+    format_(FORMAT_PCAP),
+    section_(0),
+    swapped_(false),
+    port_(0),
+    src_addr_(0)
+  {}
+
+  PcapReader::~PcapReader()
+  {
+    close();
+  }
+
+  bool PcapReader::open(const std::string &filename)
+  {
+    close();
+    error_.clear();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      {
+        error_ = filename + ": " + strerror(errno);
+        return false;
+      }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 4)
+      {
+        error_ = filename + ": not a capture file";
+        ::close(fd);
+        return false;
+      }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);                        // the mapping keeps the file open
+    if (data == MAP_FAILED)
+      {
+        error_ = filename + ": " + strerror(errno);
+        return false;
+      }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t *>(data);
+    size_ = st.st_size;
+
+    uint32_t magic;
+    memcpy(&magic, data_, sizeof(magic));
+    bool ok;
+    if (magic == PCAPNG_SECTION_HEADER)
+      ok = openPcapng();
+    else
+      ok = openPcap();
+    if (!ok)
+      {
+        error_ = filename + ": " + error_;
+        close();
+        return false;
+      }
+    rewind();
+    return true;
+  }
+
+  void PcapReader::close()
+  {
+    if (data_ != NULL)
+      munmap(const_cast<uint8_t *>(data_), size_);
+    data_ = NULL;
+    size_ = 0;
+    offset_ = 0;
+    sections_.clear();
+  }
+
+  void PcapReader::setFilter(uint16_t port, uint32_t src_addr)
+  {
+    port_ = port;
+    src_addr_ = src_addr;
+  }
+
+  void PcapReader::rewind()
+  {
+    offset_ = first_record_;
+    section_ = 0;
+    swapped_ = sections_.empty() ? false : sections_[0].swapped;
+  }
+
+  bool PcapReader::seek(size_t offset)
+  {
+    if (offset < first_record_ || offset >= size_)
+      return false;
+    section_ = 0;
+    while (section_ + 1 < sections_.size()
+           && sections_[section_ + 1].begin <= offset)
+      ++section_;
+    swapped_ = sections_[section_].swapped;
+    offset_ = offset;
+    return true;
+  }
+
+  bool PcapReader::next(PcapRecord &record)
+  {
+    if (data_ == NULL)
+      return false;
+    if (format_ == FORMAT_PCAPNG)
+      return nextPcapng(record);
+    return nextPcap(record);
+  }
+
+  uint16_t PcapReader::get16(const uint8_t *p) const
+  {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped_ ? bswap_16(v) : v;
+  }
+
+  uint32_t PcapReader::get32(const uint8_t *p) const
+  {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped_ ? bswap_32(v) : v;
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // PCAP
+  ////////////////////////////////////////////////////////////////////////
+
+  bool PcapReader::openPcap()
+  {
+    if (size_ < PCAP_FILE_HEADER_SIZE)
+      {
+        error_ = "truncated PCAP header";
+        return false;
+      }
+
+    uint32_t magic;
+    memcpy(&magic, data_, sizeof(magic));
+    Section section;
+    section.begin = 0;
+    section.swapped = (magic == bswap_32(PCAP_MAGIC_US)
+                       || magic == bswap_32(PCAP_MAGIC_NS));
+    swapped_ = section.swapped;
+    magic = get32(data_);
+    if (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS)
+      {
+        error_ = "not a PCAP or PCAPNG file";
+        return false;
+      }
+
+    Interface interface;
+    interface.link_type = get32(data_ + 20) & 0xffff;
+    interface.ts_units = (magic == PCAP_MAGIC_NS) ? 1000000000 : 1000000;
+    section.interfaces.push_back(interface);
+    sections_.push_back(section);
+
+    format_ = FORMAT_PCAP;
+    first_record_ = PCAP_FILE_HEADER_SIZE;
+    return true;
+  }
+
+  bool PcapReader::nextPcap(PcapRecord &record)
+  {
+    const Interface &interface = sections_[0].interfaces[0];
+    while (offset_ + PCAP_RECORD_HEADER_SIZE <= size_)
+      {
+        const uint8_t *header = data_ + offset_;
+        uint32_t captured = get32(header + 8);
+        if (captured > size_ - offset_ - PCAP_RECORD_HEADER_SIZE)
+          {
+            error_ = "truncated PCAP record";
+            offset_ = size_;
+            return false;
+          }
+
+        size_t record_offset = offset_;
+        offset_ += PCAP_RECORD_HEADER_SIZE + captured;
+        if (udpPayload(interface, header + PCAP_RECORD_HEADER_SIZE, captured, record))
+          {
+            uint64_t sec = get32(header);
+            uint64_t frac = get32(header + 4);
+            record.stamp_ns = sec * 1000000000ull
+              + frac * (1000000000ull / interface.ts_units);
+            record.offset = record_offset;
+            return true;
+          }
+      }
+    return false;
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // PCAPNG
+  ////////////////////////////////////////////////////////////////////////
+
+  /** @brief Check the block at offset.
+   *
+   *  @returns false if it does not fit in the file
+   */
+  bool PcapReader::blockHeader(size_t offset, uint32_t &type, uint32_t &length)
+  {
+    if (offset + 12 > size_)
+      return false;
+    type = get32(data_ + offset);
+    if (type == PCAPNG_SECTION_HEADER)
+      {
+        // a new section may switch the byte order
+        if (offset + 16 > size_)
+          return false;
+        uint32_t byte_order;
+        memcpy(&byte_order, data_ + offset + 8, sizeof(byte_order));
+        swapped_ = (byte_order != PCAPNG_BYTE_ORDER_MAGIC);
+      }
+    length = get32(data_ + offset + 4);
+    return length >= 12 && length % 4 == 0 && length <= size_ - offset;
+  }
+
+  bool PcapReader::openPcapng()
+  {
+    // Walk the block headers once to find all sections and their
+    // interfaces, so seek() works without reading the file again.
+    size_t offset = 0;
+    uint32_t type;
+    uint32_t length;
+    while (offset < size_)
+      {
+        if (!blockHeader(offset, type, length))
+          break;                        // truncated, stop reading there
+        if (type == PCAPNG_SECTION_HEADER)
+          {
+            Section section;
+            section.begin = offset;
+            section.swapped = swapped_;
+            sections_.push_back(section);
+          }
+        else if (type == PCAPNG_INTERFACE_DESCRIPTION && !sections_.empty())
+          {
+            readInterface(sections_.back(), data_ + offset + 8, length - 12);
+          }
+        offset += length;
+      }
+    if (sections_.empty())
+      {
+        error_ = "invalid PCAPNG section header";
+        return false;
+      }
+
+    format_ = FORMAT_PCAPNG;
+    first_record_ = 0;
+    return true;
+  }
+
+  void PcapReader::readInterface(Section &section, const uint8_t *body, size_t length)
+  {
+    if (length < 8)
+      return;
+    Interface interface;
+    interface.link_type = get16(body);
+    interface.ts_units = 1000000;       // default resolution is microseconds
+
+    // options: code, length, value padded to 32 bits
+    size_t offset = 8;
+    while (offset + 4 <= length)
+      {
+        uint16_t code = get16(body + offset);
+        uint16_t option_length = get16(body + offset + 2);
+        if (code == PCAPNG_OPTION_END || offset + 4 + option_length > length)
+          break;
+        if (code == PCAPNG_OPTION_TSRESOL && option_length >= 1)
+          {
+            uint8_t resolution = body[offset + 4];
+            uint8_t exponent = resolution & 0x7f;
+            if (resolution & 0x80)      // negative power of two
+              interface.ts_units = (exponent < 64) ? (1ull << exponent) : 0;
+            else                        // negative power of ten
+              {
+                interface.ts_units = 1;
+                for (int i = 0; i < exponent && i < 19; ++i)
+                  interface.ts_units *= 10;
+              }
+            if (interface.ts_units == 0)
+              interface.ts_units = 1000000;
+          }
+        offset += 4 + ((option_length + 3) & ~3);
+      }
+    section.interfaces.push_back(interface);
+  }
+
+  bool PcapReader::nextPcapng(PcapRecord &record)
+  {
+    uint32_t type;
+    uint32_t length;
+    while (offset_ < size_)
+      {
+        if (!blockHeader(offset_, type, length))
+          {
+            error_ = "truncated PCAPNG block";
+            offset_ = size_;
+            return false;
+          }
+
+        size_t block_offset = offset_;
+        offset_ += length;
+        const uint8_t *body = data_ + block_offset + 8;
+        size_t body_length = length - 12;
+
+        if (type == PCAPNG_SECTION_HEADER)
+          {
+            if (block_offset > sections_[section_].begin)
+              ++section_;
+            continue;
+          }
+
+        const std::vector<Interface> &interfaces = sections_[section_].interfaces;
+        if (type == PCAPNG_ENHANCED_PACKET && body_length >= 20)
+          {
+            uint32_t interface_id = get32(body);
+            uint32_t captured = get32(body + 12);
+            if (interface_id >= interfaces.size() || captured > body_length - 20)
+              continue;
+            const Interface &interface = interfaces[interface_id];
+            if (udpPayload(interface, body + 20, captured, record))
+              {
+                uint64_t ts = ((uint64_t) get32(body + 4) << 32) | get32(body + 8);
+                uint64_t sec = ts / interface.ts_units;
+                uint64_t frac = ts % interface.ts_units;
+                record.stamp_ns = sec * 1000000000ull
+                  + (uint64_t) ((double) frac * 1e9 / interface.ts_units);
+                record.offset = block_offset;
+                return true;
+              }
+          }
+        else if (type == PCAPNG_SIMPLE_PACKET && body_length >= 4)
+          {
+            // no timestamp, always from the first interface
+            uint32_t captured = get32(body);
+            if (captured > body_length - 4)
+              captured = body_length - 4;
+            if (!interfaces.empty()
+                && udpPayload(interfaces[0], body + 4, captured, record))
+              {
+                record.stamp_ns = 0;
+                record.offset = block_offset;
+                return true;
+              }
+          }
+      }
+    return false;
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Packet headers
+  ////////////////////////////////////////////////////////////////////////
+
+  /** @brief Find the UDP payload of a captured frame.
+   *
+   *  @returns true if it is an unfragmented IPv4 UDP datagram passing
+   *           the port and address filter
+   */
+  bool PcapReader::udpPayload(const Interface &interface, const uint8_t *frame,
+                              size_t length, PcapRecord &record) const
+  {
+    const uint8_t *end = frame + length;
+    const uint8_t *ip = NULL;
+    uint16_t ethertype = 0;
+    switch (interface.link_type)
+      {
+      case LINKTYPE_ETHERNET:
+        if (length < 14)
+          return false;
+        ethertype = net16(frame + 12);
+        ip = frame + 14;
+        while ((ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ)
+               && ip + 4 <= end)
+          {
+            ethertype = net16(ip + 2);
+            ip += 4;
+          }
+        break;
+      case LINKTYPE_LINUX_SLL:
+        if (length < 16)
+          return false;
+        ethertype = net16(frame + 14);
+        ip = frame + 16;
+        break;
+      case LINKTYPE_LINUX_SLL2:
+        if (length < 20)
+          return false;
+        ethertype = net16(frame);
+        ip = frame + 20;
+        break;
+      case LINKTYPE_NULL:
+        {
+          // address family in the byte order of the capturing host
+          if (length < 4)
+            return false;
+          uint32_t family;
+          memcpy(&family, frame, sizeof(family));
+          if (family != 2 && bswap_32(family) != 2)   // AF_INET
+            return false;
+          ethertype = ETHERTYPE_IPV4;
+          ip = frame + 4;
+          break;
+        }
+      case LINKTYPE_RAW:
+      case LINKTYPE_IPV4:
+        ethertype = ETHERTYPE_IPV4;
+        ip = frame;
+        break;
+      default:
+        return false;
+      }
+
+    if (ethertype != ETHERTYPE_IPV4 || ip + 20 > end)
+      return false;
+    if ((ip[0] >> 4) != 4 || ip[9] != IP_PROTOCOL_UDP)
+      return false;
+    if (net16(ip + 6) & 0x3fff)         // more fragments, or fragment offset
+      return false;
+    if (src_addr_ != 0 && memcmp(ip + 12, &src_addr_, 4) != 0)
+      return false;
+
+    const uint8_t *udp = ip + (ip[0] & 0x0f) * 4;
+    if (udp + UDP_HEADER_SIZE > end || net16(udp + 2) != port_)
+      return false;
+
+    size_t udp_length = net16(udp + 4);
+    if (udp_length < UDP_HEADER_SIZE)
+      return false;
+    record.payload = udp + UDP_HEADER_SIZE;
+    record.length = udp_length - UDP_HEADER_SIZE;
+    if (record.payload + record.length > end)
+      record.length = end - record.payload;   // snapped capture
+    return true;
+  }
+
+}  // namespace velodyne_driver
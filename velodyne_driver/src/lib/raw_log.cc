@@ -0,0 +1,504 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+/** \file
+ *
+ *  Compact log of raw Velodyne packets.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#ifdef VELODYNE_DRIVER_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef VELODYNE_DRIVER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include <velodyne_driver/raw_log.h>
+
+namespace velodyne_driver
+{
+  static const char HEADER_MAGIC[8] = {'V', 'L', 'R', 'A', 'W', 'L', 'O', 'G'};
+  static const char TRAILER_MAGIC[8] = {'V', 'L', 'R', 'A', 'W', 'I', 'D', 'X'};
+  static const uint32_t RAW_LOG_VERSION = 1;
+  static const size_t RECORD_SIZE = sizeof(uint64_t) + RAW_LOG_PACKET_SIZE;
+  static const int ZSTD_LEVEL = 3;      // fast enough to keep up with a 64 beam device
+
+  bool rawLogCompressionSupported(RawLogCompression compression)
+  {
+    switch (compression)
+      {
+      case RAW_LOG_UNCOMPRESSED:
+        return true;
+#ifdef VELODYNE_DRIVER_HAVE_LZ4
+      case RAW_LOG_LZ4:
+        return true;
+#endif
+#ifdef VELODYNE_DRIVER_HAVE_ZSTD
+      case RAW_LOG_ZSTD:
+        return true;
+#endif
+      default:
+        return false;
+      }
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // RawLogWriter
+  ////////////////////////////////////////////////////////////////////////
+
+  RawLogWriter::RawLogWriter():
+    fd_(-1),
+    compression_(RAW_LOG_UNCOMPRESSED),
+    chunk_packets_(0),
+    offset_(0),
+    packets_(0),
+    count_(0)
+  {}
+
+  RawLogWriter::~RawLogWriter()
+  {
+    close();
+  }
+
+  bool RawLogWriter::open(const std::string &filename, RawLogCompression compression,
+                          int cut_angle, size_t chunk_packets)
+  {
+    close();
+    error_.clear();
+    if (!rawLogCompressionSupported(compression))
+      {
+        error_ = "compression not supported by this build";
+        return false;
+      }
+
+    fd_ = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+      {
+        error_ = filename + ": " + strerror(errno);
+        return false;
+      }
+
+    compression_ = compression;
+    chunk_packets_ = std::max<size_t>(chunk_packets, 1);
+    chunk_.resize(chunk_packets_ * RECORD_SIZE);
+    count_ = 0;
+    packets_ = 0;
+    offset_ = 0;
+    revolutions_.clear();
+
+    RawLogHeader header;
+    memcpy(header.magic, HEADER_MAGIC, sizeof(header.magic));
+    header.version = RAW_LOG_VERSION;
+    header.packet_size = RAW_LOG_PACKET_SIZE;
+    header.compression = compression;
+    header.cut_angle = cut_angle;
+    return writeAll(&header, sizeof(header));
+  }
+
+  bool RawLogWriter::write(uint64_t stamp_ns, const uint8_t *data, bool starts_revolution)
+  {
+    if (fd_ < 0)
+      return false;
+
+    if (starts_revolution || packets_ == 0)
+      {
+        RawLogRevolution revolution;
+        revolution.chunk_offset = offset_;
+        revolution.packet_number = packets_;
+        revolution.stamp_ns = stamp_ns;
+        revolution.chunk_packet = count_;
+        revolution.azimuth = data[2] | (data[3] << 8);
+        revolution.reserved = 0;
+        revolutions_.push_back(revolution);
+      }
+
+    // time stamps first, then the payloads
+    memcpy(&chunk_[count_ * sizeof(stamp_ns)], &stamp_ns, sizeof(stamp_ns));
+    memcpy(&chunk_[chunk_packets_ * sizeof(stamp_ns) + count_ * RAW_LOG_PACKET_SIZE],
+           data, RAW_LOG_PACKET_SIZE);
+    ++count_;
+    ++packets_;
+
+    if (count_ == chunk_packets_)
+      return writeChunk();
+    return true;
+  }
+
+  bool RawLogWriter::writeChunk()
+  {
+    if (count_ == 0)
+      return true;
+
+    // a short last chunk: move its payloads right after its time stamps
+    size_t stamps_size = count_ * sizeof(uint64_t);
+    if (count_ < chunk_packets_)
+      memmove(&chunk_[stamps_size], &chunk_[chunk_packets_ * sizeof(uint64_t)],
+              count_ * RAW_LOG_PACKET_SIZE);
+    size_t raw_size = count_ * RECORD_SIZE;
+
+    const uint8_t *stored = &chunk_[0];
+    size_t stored_size = raw_size;
+    switch (compression_)
+      {
+#ifdef VELODYNE_DRIVER_HAVE_LZ4
+      case RAW_LOG_LZ4:
+        {
+          compressed_.resize(LZ4_compressBound(raw_size));
+          int rc = LZ4_compress_default(reinterpret_cast<const char *>(&chunk_[0]),
+                                        reinterpret_cast<char *>(&compressed_[0]),
+                                        raw_size, compressed_.size());
+          if (rc <= 0)
+            {
+              error_ = "LZ4 compression failed";
+              return false;
+            }
+          stored = &compressed_[0];
+          stored_size = rc;
+          break;
+        }
+#endif
+#ifdef VELODYNE_DRIVER_HAVE_ZSTD
+      case RAW_LOG_ZSTD:
+        {
+          compressed_.resize(ZSTD_compressBound(raw_size));
+          size_t rc = ZSTD_compress(&compressed_[0], compressed_.size(),
+                                    &chunk_[0], raw_size, ZSTD_LEVEL);
+          if (ZSTD_isError(rc))
+            {
+              error_ = std::string("zstd compression failed: ") + ZSTD_getErrorName(rc);
+              return false;
+            }
+          stored = &compressed_[0];
+          stored_size = rc;
+          break;
+        }
+#endif
+      default:
+        break;
+      }
+
+    RawLogChunk chunk;
+    chunk.packets = count_;
+    chunk.stored_size = stored_size;
+    memcpy(&chunk.first_stamp_ns, &chunk_[0], sizeof(chunk.first_stamp_ns));
+    count_ = 0;
+    return writeAll(&chunk, sizeof(chunk)) && writeAll(stored, stored_size);
+  }
+
+  bool RawLogWriter::close()
+  {
+    if (fd_ < 0)
+      return true;
+
+    bool ok = writeChunk();
+    RawLogTrailer trailer;
+    trailer.index_offset = offset_;
+    trailer.revolutions = revolutions_.size();
+    memcpy(trailer.magic, TRAILER_MAGIC, sizeof(trailer.magic));
+    ok = ok
+      && (revolutions_.empty()
+          || writeAll(&revolutions_[0], revolutions_.size() * sizeof(RawLogRevolution)))
+      && writeAll(&trailer, sizeof(trailer));
+
+    if (::close(fd_) < 0 && ok)
+      {
+        error_ = strerror(errno);
+        ok = false;
+      }
+    fd_ = -1;
+    return ok;
+  }
+
+  bool RawLogWriter::writeAll(const void *data, size_t size)
+  {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    size_t written = 0;
+    while (written < size)
+      {
+        ssize_t rc = ::write(fd_, p + written, size - written);
+        if (rc < 0)
+          {
+            if (errno == EINTR)
+              continue;
+            error_ = strerror(errno);
+            return false;
+          }
+        written += rc;
+      }
+    offset_ += size;
+    return true;
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // RawLogReader
+  ////////////////////////////////////////////////////////////////////////
+
+  RawLogReader::RawLogReader():
+    data_(NULL),
+    size_(0),
+    chunks_end_(0),
+    chunk_offset_(0),
+    next_chunk_(0),
+    chunk_packets_(0),
+    chunk_next_(0),
+    chunk_data_(NULL),
+    chunk_buffer_(0),
+    packet_number_(0)
+  {
+    memset(&header_, 0, sizeof(header_));
+  }
+
+  RawLogReader::~RawLogReader()
+  {
+    close();
+  }
+
+  bool RawLogReader::isRawLog(const std::string &filename)
+  {
+    char magic[sizeof(HEADER_MAGIC)];
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    bool is_log = (read(fd, magic, sizeof(magic)) == sizeof(magic)
+                   && memcmp(magic, HEADER_MAGIC, sizeof(magic)) == 0);
+    ::close(fd);
+    return is_log;
+  }
+
+  bool RawLogReader::open(const std::string &filename)
+  {
+    close();
+    error_.clear();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      {
+        error_ = filename + ": " + strerror(errno);
+        return false;
+      }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(RawLogHeader))
+      {
+        error_ = filename + ": not a raw packet log";
+        ::close(fd);
+        return false;
+      }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);                        // the mapping keeps the file open
+    if (data == MAP_FAILED)
+      {
+        error_ = filename + ": " + strerror(errno);
+        return false;
+      }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t *>(data);
+    size_ = st.st_size;
+
+    memcpy(&header_, data_, sizeof(header_));
+    if (memcmp(header_.magic, HEADER_MAGIC, sizeof(HEADER_MAGIC)) != 0
+        || header_.version != RAW_LOG_VERSION
+        || header_.packet_size != RAW_LOG_PACKET_SIZE)
+      {
+        error_ = filename + ": not a raw packet log of this version";
+        close();
+        return false;
+      }
+    if (!rawLogCompressionSupported(static_cast<RawLogCompression>(header_.compression)))
+      {
+        error_ = filename + ": compression not supported by this build";
+        close();
+        return false;
+      }
+
+    // The index is only there if the log was closed properly.
+    chunks_end_ = size_;
+    RawLogTrailer trailer;
+    if (size_ >= sizeof(RawLogHeader) + sizeof(trailer))
+      {
+        memcpy(&trailer, data_ + size_ - sizeof(trailer), sizeof(trailer));
+        uint64_t index_size = trailer.revolutions * sizeof(RawLogRevolution);
+        if (memcmp(trailer.magic, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) == 0
+            && trailer.index_offset >= sizeof(RawLogHeader)
+            && trailer.revolutions <= size_ / sizeof(RawLogRevolution)
+            && trailer.index_offset + index_size + sizeof(trailer) == size_)
+          {
+            chunks_end_ = trailer.index_offset;
+            revolutions_.resize(trailer.revolutions);
+            if (!revolutions_.empty())
+              memcpy(&revolutions_[0], data_ + trailer.index_offset, index_size);
+          }
+      }
+
+    rewind();
+    return true;
+  }
+
+  void RawLogReader::close()
+  {
+    if (data_ != NULL)
+      munmap(const_cast<uint8_t *>(data_), size_);
+    data_ = NULL;
+    size_ = 0;
+    revolutions_.clear();
+  }
+
+  void RawLogReader::rewind()
+  {
+    next_chunk_ = sizeof(RawLogHeader);
+    chunk_packets_ = 0;
+    chunk_next_ = 0;
+    packet_number_ = 0;
+  }
+
+  bool RawLogReader::seek(size_t revolution)
+  {
+    if (revolution >= revolutions_.size())
+      return false;
+    const RawLogRevolution &entry = revolutions_[revolution];
+    if (!loadChunk(entry.chunk_offset) || entry.chunk_packet >= chunk_packets_)
+      {
+        rewind();
+        return false;
+      }
+    chunk_next_ = entry.chunk_packet;
+    packet_number_ = entry.packet_number;
+    return true;
+  }
+
+  bool RawLogReader::next(const uint8_t *&payload, uint64_t &stamp_ns)
+  {
+    if (data_ == NULL)
+      return false;
+    while (chunk_next_ == chunk_packets_)
+      {
+        if (next_chunk_ >= chunks_end_ || !loadChunk(next_chunk_))
+          return false;
+      }
+
+    memcpy(&stamp_ns, chunk_data_ + chunk_next_ * sizeof(uint64_t), sizeof(stamp_ns));
+    payload = chunk_data_ + chunk_packets_ * sizeof(uint64_t)
+      + chunk_next_ * RAW_LOG_PACKET_SIZE;
+    ++chunk_next_;
+    ++packet_number_;
+    return true;
+  }
+
+  /** @brief Make the chunk at offset current, decompressing it if needed. */
+  bool RawLogReader::loadChunk(uint64_t offset)
+  {
+    RawLogChunk chunk;
+    if (offset + sizeof(chunk) > chunks_end_)
+      {
+        error_ = "truncated chunk header";
+        return false;
+      }
+    memcpy(&chunk, data_ + offset, sizeof(chunk));
+    const uint8_t *stored = data_ + offset + sizeof(chunk);
+    size_t raw_size = (size_t) chunk.packets * RECORD_SIZE;
+    if (chunk.stored_size > chunks_end_ - offset - sizeof(chunk))
+      {
+        // an unfinished recording ends with a partially written chunk
+        error_ = "truncated chunk";
+        return false;
+      }
+
+    if (header_.compression == RAW_LOG_UNCOMPRESSED)
+      {
+        if (chunk.stored_size != raw_size)
+          {
+            error_ = "bad chunk size";
+            return false;
+          }
+        chunk_data_ = stored;
+      }
+    else
+      {
+        // alternate buffers, so the previous chunk's payloads stay valid
+        chunk_buffer_ = 1 - chunk_buffer_;
+        std::vector<uint8_t> &buffer = chunk_buffers_[chunk_buffer_];
+        buffer.resize(raw_size);
+        bool ok = false;
+        switch (header_.compression)
+          {
+#ifdef VELODYNE_DRIVER_HAVE_LZ4
+          case RAW_LOG_LZ4:
+            ok = (LZ4_decompress_safe(reinterpret_cast<const char *>(stored),
+                                      reinterpret_cast<char *>(&buffer[0]),
+                                      chunk.stored_size, raw_size) == (int) raw_size);
+            break;
+#endif
+#ifdef VELODYNE_DRIVER_HAVE_ZSTD
+          case RAW_LOG_ZSTD:
+            ok = (ZSTD_decompress(&buffer[0], raw_size, stored, chunk.stored_size)
+                  == raw_size);
+            break;
+#endif
+          default:
+            break;
+          }
+        if (!ok || raw_size == 0)
+          {
+            error_ = "chunk decompression failed";
+            return false;
+          }
+        chunk_data_ = &buffer[0];
+      }
+
+    chunk_offset_ = offset;
+    next_chunk_ = offset + sizeof(chunk) + chunk.stored_size;
+    chunk_packets_ = chunk.packets;
+    chunk_next_ = 0;
+    return true;
+  }
+
+  static bool startsBefore(uint64_t stamp_ns, const RawLogRevolution &revolution)
+  {
+    return stamp_ns < revolution.stamp_ns;
+  }
+
+  size_t RawLogReader::findRevolution(uint64_t stamp_ns) const
+  {
+    std::vector<RawLogRevolution>::const_iterator it =
+      std::upper_bound(revolutions_.begin(), revolutions_.end(),
+                       stamp_ns, startsBefore);
+    if (it == revolutions_.begin())
+      return 0;
+    return (it - revolutions_.begin()) - 1;
+  }
+
+}  // namespace velodyne_driver
@@ -0,0 +1,237 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "velodyne_driver/packet_recorder.h"
+#include "velodyne_driver/pcap_reader.h"
+#include "velodyne_driver/raw_log.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using velodyne_driver::PacketRecorder;
+using velodyne_driver::PcapReader;
+using velodyne_driver::PcapRecord;
+using velodyne_driver::RawLogReader;
+
+namespace
+{
+
+/** packets of three revolutions, 12 each, starting at 90 degrees */
+std::vector<velodyne_msgs::VelodynePacket> revolutions()
+{
+  std::vector<velodyne_msgs::VelodynePacket> pkts(36);
+  for (size_t i = 0; i < pkts.size(); ++i)
+    {
+      int azimuth = (9000 + i * 3000) % 36000;
+      pkts[i].data.fill(i);
+      pkts[i].data[2] = azimuth & 0xff;
+      pkts[i].data[3] = azimuth >> 8;
+      pkts[i].stamp.sec = 1000 + i;
+      pkts[i].stamp.nsec = 500;
+    }
+  return pkts;
+}
+
+class PacketRecorderTest: public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char dir[] = "/tmp/packet_recorder_test_XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != NULL);
+    dir_ = dir;
+    options_.prefix = dir_ + "/rec-";
+  }
+
+  virtual void TearDown()
+  {
+    for (int i = 0; i < 10; ++i)
+      {
+        unlink(name(i).c_str());
+        unlink(name(i, ".vlog").c_str());
+      }
+    rmdir(dir_.c_str());
+  }
+
+  std::string name(int i, const char *extension = ".pcap") const
+  {
+    char number[16];
+    snprintf(number, sizeof(number), "%04d", i);
+    return options_.prefix + number + extension;
+  }
+
+  /** @returns first payload byte of every packet in a file */
+  std::vector<int> readFile(int i)
+  {
+    std::vector<int> ids;
+    PcapReader reader;
+    if (!reader.open(name(i)))
+      return ids;
+    reader.setFilter(options_.port);
+    PcapRecord record;
+    while (reader.next(record))
+      {
+        EXPECT_EQ(1206u, record.length);
+        EXPECT_EQ((1000 + record.payload[0]) * 1000000000ull + 500, record.stamp_ns);
+        ids.push_back(record.payload[0]);
+      }
+    EXPECT_TRUE(reader.error().empty());
+    return ids;
+  }
+
+  std::string dir_;
+  PacketRecorder::Options options_;
+};
+
+}  // namespace
+
+TEST_F(PacketRecorderTest, WritesReadablePcap)
+{
+  std::vector<velodyne_msgs::VelodynePacket> pkts = revolutions();
+  {
+    PacketRecorder recorder(options_);
+    recorder.record(&pkts[0], 10);
+    recorder.record(&pkts[10], pkts.size() - 10);
+  }
+  std::vector<int> ids = readFile(0);
+  ASSERT_EQ(pkts.size(), ids.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+    EXPECT_EQ(static_cast<int>(i), ids[i]);
+  EXPECT_NE(0, access(name(1).c_str(), F_OK));
+}
+
+TEST_F(PacketRecorderTest, SplitsOnRevolutions)
+{
+  // every file is full after one packet, so files split at every revolution
+  options_.file_size = 1;
+  std::vector<velodyne_msgs::VelodynePacket> pkts = revolutions();
+  uint64_t written;
+  {
+    PacketRecorder recorder(options_);
+    recorder.record(&pkts[0], pkts.size());
+    while (recorder.packetsWritten() < pkts.size())
+      usleep(1000);
+    written = recorder.filesWritten();
+  }
+  EXPECT_EQ(4u, written);
+
+  // the packet passing 0 degrees ends a revolution
+  std::vector<int> first = readFile(0);
+  ASSERT_EQ(10u, first.size());
+  EXPECT_EQ(9, first.back());
+  for (int i = 1; i < 3; ++i)
+    {
+      std::vector<int> ids = readFile(i);
+      ASSERT_EQ(12u, ids.size());
+      EXPECT_EQ(10 + 12 * (i - 1), ids.front());
+    }
+  EXPECT_EQ(2u, readFile(3).size());
+}
+
+TEST_F(PacketRecorderTest, SplitsRawLogsOnRevolutions)
+{
+  options_.file_size = 1;
+  options_.raw = true;
+  std::vector<velodyne_msgs::VelodynePacket> pkts = revolutions();
+  {
+    PacketRecorder recorder(options_);
+    recorder.record(&pkts[0], pkts.size());
+  }
+
+  size_t sizes[4] = {10, 12, 12, 2};
+  int id = 0;
+  for (int i = 0; i < 4; ++i)
+    {
+      RawLogReader reader;
+      ASSERT_TRUE(reader.open(name(i, ".vlog"))) << reader.error();
+      ASSERT_EQ(1u, reader.revolutions().size());
+      const uint8_t *payload;
+      uint64_t stamp_ns;
+      size_t count = 0;
+      while (reader.next(payload, stamp_ns))
+        {
+          EXPECT_EQ(id, payload[0]);
+          EXPECT_EQ((1000 + id) * 1000000000ull + 500, stamp_ns);
+          ++id;
+          ++count;
+        }
+      EXPECT_EQ(sizes[i], count);
+    }
+}
+
+TEST_F(PacketRecorderTest, RemovesOldestFiles)
+{
+  options_.file_size = 1;
+  options_.max_files = 2;
+  std::vector<velodyne_msgs::VelodynePacket> pkts = revolutions();
+  {
+    PacketRecorder recorder(options_);
+    recorder.record(&pkts[0], pkts.size());
+  }
+  EXPECT_NE(0, access(name(0).c_str(), F_OK));
+  EXPECT_NE(0, access(name(1).c_str(), F_OK));
+  EXPECT_EQ(12u, readFile(2).size());
+  EXPECT_EQ(2u, readFile(3).size());
+}
+
+TEST_F(PacketRecorderTest, DropsWhenFull)
+{
+  options_.ring_size = 16;
+  std::vector<velodyne_msgs::VelodynePacket> pkts = revolutions();
+  PacketRecorder recorder(options_);
+  // the writer thread may take some of them in the meantime
+  recorder.record(&pkts[0], pkts.size());
+  EXPECT_GE(recorder.drops(), pkts.size() - 32);
+  EXPECT_LE(recorder.drops(), pkts.size() - 16);
+}
+
+TEST_F(PacketRecorderTest, StopsOnWriteErrors)
+{
+  options_.prefix = dir_ + "/missing/rec-";
+  std::vector<velodyne_msgs::VelodynePacket> pkts = revolutions();
+  PacketRecorder recorder(options_);
+  recorder.record(&pkts[0], pkts.size());
+  for (int i = 0; i < 1000 && !recorder.failed(); ++i)
+    usleep(1000);
+  EXPECT_TRUE(recorder.failed());
+  EXPECT_EQ(0u, recorder.packetsWritten());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  int ret = RUN_ALL_TESTS();
+  return ret;
+}
@@ -0,0 +1,143 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "velodyne_driver/packet_ring.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+using velodyne_driver::PacketRing;
+
+TEST(PacketRing, CapacityRoundsUpToPowerOfTwo)
+{
+  PacketRing<int> ring(100);
+  ASSERT_EQ(ring.capacity(), 128u);
+  ASSERT_EQ(ring.occupancy(), 0u);
+}
+
+TEST(PacketRing, ContiguousSpansWrapAround)
+{
+  PacketRing<int> ring(8);
+
+  size_t count = 6;
+  int *slots = ring.acquire(count);
+  ASSERT_EQ(count, 6u);
+  for (int i = 0; i < 6; ++i)
+    slots[i] = i;
+  ring.publish(6);
+
+  count = 4;
+  const int *ready = ring.peek(count);
+  ASSERT_EQ(count, 4u);
+  ASSERT_EQ(ready[0], 0);
+  ring.release(4);
+
+  // only the two slots up to the end of the storage are contiguous
+  count = 6;
+  slots = ring.acquire(count);
+  ASSERT_EQ(count, 2u);
+  slots[0] = 6;
+  slots[1] = 7;
+  ring.publish(2);
+
+  count = 8;
+  slots = ring.acquire(count);
+  ASSERT_EQ(count, 4u);
+  ring.publish(0);
+
+  count = 8;
+  ready = ring.peek(count);
+  ASSERT_EQ(count, 4u);
+  ASSERT_EQ(ready[0], 4);
+  ASSERT_EQ(ready[3], 7);
+  ASSERT_EQ(ring.occupancy(), 4u);
+  ASSERT_EQ(ring.takeMaxOccupancy(), 6u);
+}
+
+TEST(PacketRing, FullRingCountsDrops)
+{
+  PacketRing<int> ring(4);
+  size_t count = 4;
+  ring.acquire(count);
+  ring.publish(count);
+
+  count = 1;
+  ring.acquire(count);
+  ASSERT_EQ(count, 0u);
+  ring.drop(3);
+  ASSERT_EQ(ring.drops(), 3u);
+}
+
+TEST(PacketRing, ConcurrentProducerConsumerKeepsOrder)
+{
+  PacketRing<int> ring(64);
+  const int total = 100000;
+
+  std::thread producer([&ring, total]()
+    {
+      int next = 0;
+      while (next < total)
+        {
+          size_t count = 7;
+          int *slots = ring.acquire(count);
+          size_t i = 0;
+          for (; i < count && next < total; ++i)
+            slots[i] = next++;
+          ring.publish(i);
+          if (count == 0)
+            std::this_thread::yield();
+        }
+    });
+
+  int expected = 0;
+  bool in_order = true;
+  while (expected < total)
+    {
+      size_t count = 5;
+      const int *ready = ring.peek(count);
+      for (size_t i = 0; i < count; ++i)
+        in_order = in_order && (ready[i] == expected++);
+      ring.release(count);
+      if (count == 0)
+        std::this_thread::yield();
+    }
+  producer.join();
+
+  ASSERT_TRUE(in_order);
+  ASSERT_EQ(ring.drops(), 0u);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  int ret = RUN_ALL_TESTS();
+  return ret;
+}
@@ -0,0 +1,247 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "velodyne_driver/pcap_index.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using velodyne_driver::PcapIndex;
+using velodyne_driver::PcapReader;
+using velodyne_driver::passesCutAngle;
+
+namespace
+{
+
+/** writes a raw IPv4 PCAP file of data packets with the given first block azimuths */
+std::string writeCapture(const std::vector<int> &azimuths)
+{
+  char name[] = "/tmp/pcap_index_test_XXXXXX";
+  int fd = mkstemp(name);
+  EXPECT_GE(fd, 0);
+  FILE *file = fdopen(fd, "wb");
+
+  const uint32_t header[6] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 101};
+  fwrite(header, sizeof(header), 1, file);
+
+  std::vector<uint8_t> frame(20 + 8 + 1206, 0);
+  frame[0] = 0x45;
+  frame[9] = 17;                        // UDP
+  frame[22] = 2368 >> 8;
+  frame[23] = 2368 & 0xff;
+  frame[24] = (8 + 1206) >> 8;
+  frame[25] = (8 + 1206) & 0xff;
+  for (size_t i = 0; i < azimuths.size(); ++i)
+    {
+      const uint32_t record[4] = {static_cast<uint32_t>(100 + i / 10),
+                                  static_cast<uint32_t>((i % 10) * 100000),
+                                  static_cast<uint32_t>(frame.size()),
+                                  static_cast<uint32_t>(frame.size())};
+      frame[28 + 2] = azimuths[i] & 0xff;
+      frame[28 + 3] = azimuths[i] >> 8;
+      fwrite(record, sizeof(record), 1, file);
+      fwrite(&frame[0], frame.size(), 1, file);
+    }
+  fclose(file);
+  return name;
+}
+
+/** three revolutions of 12 packets, starting at 90 degrees */
+std::vector<int> rotation()
+{
+  std::vector<int> azimuths;
+  for (int i = 0; i < 36; ++i)
+    azimuths.push_back((9000 + i * 3000) % 36000);
+  return azimuths;
+}
+
+PcapIndex::Key key(int cut_angle)
+{
+  PcapIndex::Key key = {1 << 20, 42, cut_angle, 2368, 0};
+  return key;
+}
+
+}  // namespace
+
+TEST(PcapIndex, PassesCutAngle)
+{
+  EXPECT_TRUE(passesCutAngle(35000, 1000, 0));
+  EXPECT_FALSE(passesCutAngle(1000, 2000, 0));
+  EXPECT_TRUE(passesCutAngle(8000, 9000, 9000));
+  EXPECT_FALSE(passesCutAngle(9000, 10000, 9000));
+  EXPECT_TRUE(passesCutAngle(35000, 1000, 500));
+  EXPECT_TRUE(passesCutAngle(35000, 1000, 35500));
+  EXPECT_FALSE(passesCutAngle(35000, 1000, 2000));
+}
+
+TEST(PcapIndex, RevolutionBoundaries)
+{
+  std::string name = writeCapture(rotation());
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(name));
+  reader.setFilter(2368);
+
+  PcapIndex index;
+  index.build(reader, key(0), 1206);
+  // a partial first revolution from 90 degrees, then full ones
+  ASSERT_EQ(4u, index.size());
+  EXPECT_EQ(9000, index[0].azimuth);
+  EXPECT_EQ(24u, index[0].offset);
+  for (size_t i = 1; i < index.size(); ++i)
+    {
+      // the packet after the one passing 0 degrees
+      EXPECT_EQ(3000, index[i].azimuth);
+      EXPECT_GT(index[i].offset, index[i - 1].offset);
+    }
+
+  // seeking to an entry reads its first packet
+  velodyne_driver::PcapRecord record;
+  ASSERT_TRUE(reader.seek(index[2].offset));
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(index[2].stamp_ns, record.stamp_ns);
+  EXPECT_EQ(3000, record.payload[2] | (record.payload[3] << 8));
+
+  index.build(reader, key(18000), 1206);
+  ASSERT_EQ(4u, index.size());
+  EXPECT_EQ(21000, index[1].azimuth);
+
+  // packets shorter than min_length are not indexed
+  index.build(reader, key(0), 1207);
+  EXPECT_EQ(0u, index.size());
+  unlink(name.c_str());
+}
+
+TEST(PcapIndex, FindByTime)
+{
+  std::string name = writeCapture(rotation());
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(name));
+  reader.setFilter(2368);
+  PcapIndex index;
+  index.build(reader, key(0), 1206);
+  unlink(name.c_str());
+
+  EXPECT_EQ(0u, index.find(0));
+  EXPECT_EQ(0u, index.find(index[0].stamp_ns));
+  EXPECT_EQ(0u, index.find(index[1].stamp_ns - 1));
+  EXPECT_EQ(1u, index.find(index[1].stamp_ns));
+  EXPECT_EQ(3u, index.find(index[3].stamp_ns + 1000000000ull));
+}
+
+TEST(PcapIndex, SidecarRoundTrip)
+{
+  std::string name = writeCapture(rotation());
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(name));
+  reader.setFilter(2368);
+  PcapIndex index;
+  index.build(reader, key(0), 1206);
+
+  std::string sidecar = PcapIndex::sidecarName(name);
+  ASSERT_TRUE(index.save(sidecar));
+
+  PcapIndex loaded;
+  ASSERT_TRUE(loaded.load(sidecar, key(0)));
+  ASSERT_EQ(index.size(), loaded.size());
+  for (size_t i = 0; i < index.size(); ++i)
+    {
+      EXPECT_EQ(index[i].offset, loaded[i].offset);
+      EXPECT_EQ(index[i].stamp_ns, loaded[i].stamp_ns);
+      EXPECT_EQ(index[i].azimuth, loaded[i].azimuth);
+    }
+
+  // stale or foreign indexes are rejected
+  PcapIndex::Key changed = key(0);
+  changed.mtime_ns += 1;
+  EXPECT_FALSE(loaded.load(sidecar, changed));
+  EXPECT_FALSE(loaded.load(sidecar, key(100)));
+  EXPECT_FALSE(loaded.load(name, key(0)));
+  EXPECT_EQ(index.size(), loaded.size());   // unchanged by failed loads
+
+  unlink(sidecar.c_str());
+  unlink(name.c_str());
+}
+
+TEST(PcapIndex, OpenBuildsOnceThenLoads)
+{
+  std::string name = writeCapture(rotation());
+  std::string sidecar = PcapIndex::sidecarName(name);
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(name));
+  reader.setFilter(2368);
+
+  PcapIndex built;
+  ASSERT_TRUE(built.open(name, reader, 0, 2368, 0));
+  EXPECT_EQ(0, access(sidecar.c_str(), R_OK));
+
+  PcapIndex loaded;
+  EXPECT_FALSE(loaded.load(sidecar, key(0)));   // built for the real file
+  ASSERT_TRUE(loaded.open(name, reader, 0, 2368, 0));
+  EXPECT_EQ(built.size(), loaded.size());
+
+  unlink(sidecar.c_str());
+  unlink(name.c_str());
+}
+
+TEST(PcapIndex, EmptyCapture)
+{
+  // only the file header, no packets at all
+  std::string name = writeCapture(std::vector<int>());
+  std::string sidecar = PcapIndex::sidecarName(name);
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(name));
+  reader.setFilter(2368);
+
+  PcapIndex built;
+  EXPECT_FALSE(built.open(name, reader, 0, 2368, 0));
+  EXPECT_EQ(0u, built.size());
+  EXPECT_EQ(0u, built.find(0));
+
+  // the saved empty index is no usable index either
+  ASSERT_EQ(0, access(sidecar.c_str(), R_OK));
+  PcapIndex loaded;
+  EXPECT_FALSE(loaded.open(name, reader, 0, 2368, 0));
+  EXPECT_EQ(0u, loaded.size());
+
+  unlink(sidecar.c_str());
+  unlink(name.c_str());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  int ret = RUN_ALL_TESTS();
+  return ret;
+}
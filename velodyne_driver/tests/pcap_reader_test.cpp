@@ -0,0 +1,400 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "velodyne_driver/pcap_reader.h"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <byteswap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using velodyne_driver::PcapReader;
+using velodyne_driver::PcapRecord;
+
+namespace
+{
+
+typedef std::vector<uint8_t> Bytes;
+
+void put8(Bytes &b, uint8_t v) { b.push_back(v); }
+void put16be(Bytes &b, uint16_t v) { b.push_back(v >> 8); b.push_back(v & 0xff); }
+void put16(Bytes &b, uint16_t v, bool swap)
+{
+  if (swap) v = bswap_16(v);
+  b.insert(b.end(), reinterpret_cast<uint8_t *>(&v), reinterpret_cast<uint8_t *>(&v) + 2);
+}
+void put32(Bytes &b, uint32_t v, bool swap)
+{
+  if (swap) v = bswap_32(v);
+  b.insert(b.end(), reinterpret_cast<uint8_t *>(&v), reinterpret_cast<uint8_t *>(&v) + 4);
+}
+
+/** IPv4 UDP datagram with a payload of `length` bytes of value `fill` */
+Bytes udpDatagram(uint16_t port, uint8_t source_host, size_t length, uint8_t fill,
+                  uint16_t flags_frag = 0)
+{
+  Bytes b;
+  put8(b, 0x45); put8(b, 0);
+  put16be(b, 20 + 8 + length);
+  put16be(b, 0); put16be(b, flags_frag);
+  put8(b, 64); put8(b, 17); put16be(b, 0);
+  put8(b, 192); put8(b, 168); put8(b, 1); put8(b, source_host);
+  put8(b, 192); put8(b, 168); put8(b, 1); put8(b, 100);
+  put16be(b, 2368); put16be(b, port);
+  put16be(b, 8 + length); put16be(b, 0);
+  b.insert(b.end(), length, fill);
+  return b;
+}
+
+Bytes ethernet(const Bytes &ip, bool vlan = false)
+{
+  Bytes b(12, 0xff);
+  if (vlan)
+    {
+      put16be(b, 0x8100);
+      put16be(b, 42);
+    }
+  put16be(b, 0x0800);
+  b.insert(b.end(), ip.begin(), ip.end());
+  return b;
+}
+
+Bytes linuxCooked(const Bytes &ip)
+{
+  Bytes b(14, 0);
+  put16be(b, 0x0800);
+  b.insert(b.end(), ip.begin(), ip.end());
+  return b;
+}
+
+/** classic PCAP file */
+struct PcapFile
+{
+  PcapFile(uint16_t link_type, bool nanoseconds = false, bool swap = false):
+    swap_(swap)
+  {
+    put32(data, nanoseconds ? 0xa1b23c4d : 0xa1b2c3d4, swap_);
+    put16(data, 2, swap_);
+    put16(data, 4, swap_);
+    put32(data, 0, swap_);
+    put32(data, 0, swap_);
+    put32(data, 65535, swap_);
+    put32(data, link_type, swap_);
+  }
+
+  void add(uint32_t sec, uint32_t frac, const Bytes &frame, size_t snap = 0)
+  {
+    size_t captured = snap ? snap : frame.size();
+    put32(data, sec, swap_);
+    put32(data, frac, swap_);
+    put32(data, captured, swap_);
+    put32(data, frame.size(), swap_);
+    data.insert(data.end(), frame.begin(), frame.begin() + captured);
+  }
+
+  bool swap_;
+  Bytes data;
+};
+
+/** PCAPNG file with one section */
+struct PcapngFile
+{
+  explicit PcapngFile(bool swap = false):
+    swap_(swap)
+  {
+    Bytes body;
+    put32(body, 0x1a2b3c4d, swap_);
+    put16(body, 1, swap_);
+    put16(body, 0, swap_);
+    put32(body, 0xffffffff, swap_);
+    put32(body, 0xffffffff, swap_);
+    block(0x0a0d0d0a, body);
+  }
+
+  /** @param tsresol if_tsresol option, 0 for none */
+  void addInterface(uint16_t link_type, uint8_t tsresol = 0)
+  {
+    Bytes body;
+    put16(body, link_type, swap_);
+    put16(body, 0, swap_);
+    put32(body, 0, swap_);
+    if (tsresol)
+      {
+        put16(body, 9, swap_);
+        put16(body, 1, swap_);
+        put8(body, tsresol);
+        body.insert(body.end(), 3, 0);
+        put32(body, 0, swap_);
+      }
+    block(1, body);
+  }
+
+  void addPacket(uint32_t interface, uint64_t ts, const Bytes &frame)
+  {
+    Bytes body;
+    put32(body, interface, swap_);
+    put32(body, ts >> 32, swap_);
+    put32(body, ts & 0xffffffff, swap_);
+    put32(body, frame.size(), swap_);
+    put32(body, frame.size(), swap_);
+    body.insert(body.end(), frame.begin(), frame.end());
+    body.resize((body.size() + 3) & ~3, 0);
+    block(6, body);
+  }
+
+  void block(uint32_t type, const Bytes &body)
+  {
+    put32(data, type, swap_);
+    put32(data, body.size() + 12, swap_);
+    data.insert(data.end(), body.begin(), body.end());
+    put32(data, body.size() + 12, swap_);
+  }
+
+  bool swap_;
+  Bytes data;
+};
+
+/** writes data into a temporary file, removed again on destruction */
+class TempFile
+{
+public:
+  explicit TempFile(const Bytes &data)
+  {
+    char name[] = "/tmp/pcap_reader_test_XXXXXX";
+    int fd = mkstemp(name);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(static_cast<ssize_t>(data.size()), write(fd, data.data(), data.size()));
+    ::close(fd);
+    name_ = name;
+  }
+  ~TempFile() { unlink(name_.c_str()); }
+  const std::string &name() const { return name_; }
+
+private:
+  std::string name_;
+};
+
+}  // namespace
+
+TEST(PcapReader, MissingFile)
+{
+  PcapReader reader;
+  EXPECT_FALSE(reader.open("/nonexistent/file.pcap"));
+  EXPECT_FALSE(reader.isOpen());
+  EXPECT_FALSE(reader.error().empty());
+}
+
+TEST(PcapReader, NotACaptureFile)
+{
+  TempFile file(Bytes(64, 'x'));
+  PcapReader reader;
+  EXPECT_FALSE(reader.open(file.name()));
+  EXPECT_FALSE(reader.error().empty());
+}
+
+TEST(PcapReader, FiltersPortAndSource)
+{
+  PcapFile pcap(1);
+  pcap.add(1, 10, ethernet(udpDatagram(2368, 201, 1206, 1)));
+  pcap.add(1, 20, ethernet(udpDatagram(8308, 201, 512, 2)));   // position port
+  pcap.add(1, 30, ethernet(udpDatagram(2368, 202, 1206, 3)));  // other device
+  pcap.add(1, 40, ethernet(udpDatagram(2368, 201, 1206, 4)));
+  TempFile file(pcap.data);
+
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(file.name()));
+  reader.setFilter(2368);
+  PcapRecord record;
+  int count = 0;
+  while (reader.next(record))
+    {
+      EXPECT_EQ(1206u, record.length);
+      ++count;
+    }
+  EXPECT_EQ(3, count);
+
+  reader.rewind();
+  reader.setFilter(2368, htonl(0xc0a801c9));   // 192.168.1.201
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(1, record.payload[0]);
+  EXPECT_EQ(1000010000ull, record.stamp_ns);
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(4, record.payload[1205]);
+  EXPECT_EQ(1000040000ull, record.stamp_ns);
+  EXPECT_FALSE(reader.next(record));
+  EXPECT_TRUE(reader.error().empty());
+}
+
+TEST(PcapReader, NanosecondsSwapped)
+{
+  PcapFile pcap(1, true, true);
+  pcap.add(3, 123456789, ethernet(udpDatagram(2368, 201, 100, 7)));
+  TempFile file(pcap.data);
+
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(file.name()));
+  reader.setFilter(2368);
+  PcapRecord record;
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(3123456789ull, record.stamp_ns);
+  EXPECT_EQ(100u, record.length);
+}
+
+TEST(PcapReader, LinkTypes)
+{
+  PcapFile vlan(1);
+  vlan.add(0, 0, ethernet(udpDatagram(2368, 201, 1206, 1), true));
+  PcapFile sll(113);
+  sll.add(0, 0, linuxCooked(udpDatagram(2368, 201, 1206, 1)));
+  PcapFile raw(101);
+  raw.add(0, 0, udpDatagram(2368, 201, 1206, 1));
+
+  const Bytes *files[] = {&vlan.data, &sll.data, &raw.data};
+  for (size_t i = 0; i < 3; ++i)
+    {
+      TempFile file(*files[i]);
+      PcapReader reader;
+      ASSERT_TRUE(reader.open(file.name()));
+      reader.setFilter(2368);
+      PcapRecord record;
+      ASSERT_TRUE(reader.next(record)) << "file " << i;
+      EXPECT_EQ(1206u, record.length);
+      EXPECT_EQ(1, record.payload[0]);
+    }
+}
+
+TEST(PcapReader, SkipsFragmentsAndShortCaptures)
+{
+  PcapFile pcap(1);
+  pcap.add(0, 0, ethernet(udpDatagram(2368, 201, 1206, 1, 0x2000)));  // more fragments
+  pcap.add(0, 0, ethernet(udpDatagram(2368, 201, 1206, 2)), 20);      // snapped in the MAC header
+  pcap.add(0, 0, ethernet(udpDatagram(2368, 201, 1206, 3)), 1000);    // snapped payload
+  TempFile file(pcap.data);
+
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(file.name()));
+  reader.setFilter(2368);
+  PcapRecord record;
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(3, record.payload[0]);
+  EXPECT_EQ(1000u - 14 - 20 - 8, record.length);
+  EXPECT_FALSE(reader.next(record));
+}
+
+TEST(PcapReader, TruncatedRecord)
+{
+  PcapFile pcap(1);
+  pcap.add(0, 0, ethernet(udpDatagram(2368, 201, 1206, 1)));
+  pcap.add(0, 0, ethernet(udpDatagram(2368, 201, 1206, 2)));
+  pcap.data.resize(pcap.data.size() - 100);
+  TempFile file(pcap.data);
+
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(file.name()));
+  reader.setFilter(2368);
+  PcapRecord record;
+  EXPECT_TRUE(reader.next(record));
+  EXPECT_FALSE(reader.next(record));
+  EXPECT_FALSE(reader.error().empty());
+}
+
+TEST(PcapReader, SeekToRecord)
+{
+  PcapFile pcap(1);
+  for (int i = 0; i < 10; ++i)
+    pcap.add(i, 0, ethernet(udpDatagram(2368, 201, 1206, i)));
+  TempFile file(pcap.data);
+
+  PcapReader reader;
+  ASSERT_TRUE(reader.open(file.name()));
+  reader.setFilter(2368);
+  std::vector<size_t> offsets;
+  PcapRecord record;
+  while (reader.next(record))
+    offsets.push_back(record.offset);
+  ASSERT_EQ(10u, offsets.size());
+
+  ASSERT_TRUE(reader.seek(offsets[6]));
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(6, record.payload[0]);
+  EXPECT_EQ(offsets[6], record.offset);
+  EXPECT_FALSE(reader.seek(reader.size()));
+
+  reader.rewind();
+  ASSERT_TRUE(reader.next(record));
+  EXPECT_EQ(0, record.payload[0]);
+}
+
+TEST(PcapReader, Pcapng)
+{
+  const bool swaps[] = {false, true};
+  for (size_t i = 0; i < 2; ++i)
+    {
+      PcapngFile pcapng(swaps[i]);
+      pcapng.addInterface(1);                  // microseconds
+      pcapng.addInterface(113, 9);             // nanoseconds
+      pcapng.addPacket(0, 1500000, ethernet(udpDatagram(2368, 201, 1206, 1)));
+      pcapng.addPacket(1, 2000000123ull, linuxCooked(udpDatagram(2368, 201, 1206, 2)));
+      pcapng.addPacket(5, 0, ethernet(udpDatagram(2368, 201, 1206, 3)));  // unknown interface
+      TempFile file(pcapng.data);
+
+      PcapReader reader;
+      ASSERT_TRUE(reader.open(file.name()));
+      reader.setFilter(2368);
+      PcapRecord record;
+      ASSERT_TRUE(reader.next(record));
+      EXPECT_EQ(1, record.payload[0]);
+      EXPECT_EQ(1500000000ull, record.stamp_ns);
+      size_t second = reader.offset();
+      ASSERT_TRUE(reader.next(record));
+      EXPECT_EQ(2, record.payload[0]);
+      EXPECT_EQ(2000000123ull, record.stamp_ns);
+      EXPECT_EQ(second, record.offset);
+      EXPECT_FALSE(reader.next(record));
+      EXPECT_TRUE(reader.error().empty());
+
+      ASSERT_TRUE(reader.seek(second));
+      ASSERT_TRUE(reader.next(record));
+      EXPECT_EQ(2, record.payload[0]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  int ret = RUN_ALL_TESTS();
+  return ret;
+}
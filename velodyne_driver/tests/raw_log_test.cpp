@@ -0,0 +1,245 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "velodyne_driver/raw_log.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using namespace velodyne_driver;
+
+namespace
+{
+
+class RawLogTest: public ::testing::TestWithParam<RawLogCompression>
+{
+protected:
+  virtual void SetUp()
+  {
+    char name[] = "/tmp/raw_log_test_XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    ::close(fd);
+    name_ = name;
+  }
+
+  virtual void TearDown()
+  {
+    unlink(name_.c_str());
+  }
+
+  /** packet i has payload bytes derived from i, and starts a
+   *  revolution every 25 packets
+   */
+  void writeLog(RawLogCompression compression, size_t packets)
+  {
+    RawLogWriter writer;
+    ASSERT_TRUE(writer.open(name_, compression, 0, 16)) << writer.error();
+    std::vector<uint8_t> data(RAW_LOG_PACKET_SIZE);
+    for (size_t i = 0; i < packets; ++i)
+      {
+        for (size_t j = 0; j < data.size(); ++j)
+          data[j] = (i + j / 100) & 0xff;
+        data[2] = i & 0xff;
+        data[3] = 0;
+        ASSERT_TRUE(writer.write(stamp(i), &data[0], i > 0 && i % 25 == 0));
+      }
+    ASSERT_TRUE(writer.close()) << writer.error();
+  }
+
+  static uint64_t stamp(size_t i)
+  {
+    return 1500000000000000000ull + i * 1000000ull;
+  }
+
+  static void expectPacket(size_t i, const uint8_t *payload, uint64_t stamp_ns)
+  {
+    EXPECT_EQ(stamp(i), stamp_ns);
+    EXPECT_EQ(i & 0xff, payload[2]);
+    EXPECT_EQ((i + 12) & 0xff, payload[1205]);
+  }
+
+  std::string name_;
+};
+
+}  // namespace
+
+TEST_P(RawLogTest, RoundTrip)
+{
+  if (!rawLogCompressionSupported(GetParam()))
+    return;
+  writeLog(GetParam(), 100);
+  EXPECT_TRUE(RawLogReader::isRawLog(name_));
+
+  RawLogReader reader;
+  ASSERT_TRUE(reader.open(name_)) << reader.error();
+  const uint8_t *payload;
+  uint64_t stamp_ns;
+  for (size_t i = 0; i < 100; ++i)
+    {
+      ASSERT_TRUE(reader.next(payload, stamp_ns)) << i;
+      expectPacket(i, payload, stamp_ns);
+    }
+  EXPECT_FALSE(reader.next(payload, stamp_ns));
+  EXPECT_TRUE(reader.error().empty());
+  EXPECT_EQ(100u, reader.packetNumber());
+
+  reader.rewind();
+  ASSERT_TRUE(reader.next(payload, stamp_ns));
+  expectPacket(0, payload, stamp_ns);
+}
+
+TEST_P(RawLogTest, SeekRevolutions)
+{
+  if (!rawLogCompressionSupported(GetParam()))
+    return;
+  writeLog(GetParam(), 100);
+
+  RawLogReader reader;
+  ASSERT_TRUE(reader.open(name_));
+  ASSERT_EQ(4u, reader.revolutions().size());
+  for (size_t r = 0; r < 4; ++r)
+    {
+      EXPECT_EQ(r * 25, reader.revolutions()[r].packet_number);
+      EXPECT_EQ(stamp(r * 25), reader.revolutions()[r].stamp_ns);
+      EXPECT_EQ(r * 25, reader.revolutions()[r].azimuth);
+    }
+
+  const uint8_t *payload;
+  uint64_t stamp_ns;
+  ASSERT_TRUE(reader.seek(2));
+  EXPECT_EQ(50u, reader.packetNumber());
+  ASSERT_TRUE(reader.next(payload, stamp_ns));
+  expectPacket(50, payload, stamp_ns);
+  EXPECT_FALSE(reader.seek(4));
+
+  EXPECT_EQ(0u, reader.findRevolution(0));
+  EXPECT_EQ(1u, reader.findRevolution(stamp(49)));
+  EXPECT_EQ(3u, reader.findRevolution(stamp(1000)));
+}
+
+TEST_P(RawLogTest, PayloadsStayValidForOneChunk)
+{
+  if (!rawLogCompressionSupported(GetParam()))
+    return;
+  writeLog(GetParam(), 40);
+
+  RawLogReader reader;
+  ASSERT_TRUE(reader.open(name_));
+  const uint8_t *payload;
+  const uint8_t *previous = NULL;
+  uint64_t stamp_ns;
+  for (size_t i = 0; i < 40; ++i)
+    {
+      ASSERT_TRUE(reader.next(payload, stamp_ns));
+      if (previous != NULL)
+        {
+          EXPECT_EQ((i - 1) & 0xff, previous[2]);
+        }
+      previous = payload;
+    }
+}
+
+TEST_P(RawLogTest, UnclosedLog)
+{
+  if (!rawLogCompressionSupported(GetParam()))
+    return;
+  // cut off the index, as if recording stopped without closing the log
+  writeLog(GetParam(), 100);
+  FILE *file = fopen(name_.c_str(), "rb");
+  ASSERT_TRUE(file != NULL);
+  RawLogTrailer trailer;
+  fseek(file, -static_cast<long>(sizeof(trailer)), SEEK_END);
+  ASSERT_EQ(1u, fread(&trailer, sizeof(trailer), 1, file));
+  fclose(file);
+  ASSERT_EQ(0, truncate(name_.c_str(), trailer.index_offset));
+
+  RawLogReader reader;
+  ASSERT_TRUE(reader.open(name_)) << reader.error();
+  EXPECT_TRUE(reader.revolutions().empty());
+  const uint8_t *payload;
+  uint64_t stamp_ns;
+  size_t count = 0;
+  while (reader.next(payload, stamp_ns))
+    expectPacket(count++, payload, stamp_ns);
+  EXPECT_EQ(100u, count);
+}
+
+INSTANTIATE_TEST_CASE_P(Compression, RawLogTest,
+                        ::testing::Values(RAW_LOG_UNCOMPRESSED, RAW_LOG_LZ4, RAW_LOG_ZSTD));
+
+TEST(RawLog, TruncatedChunk)
+{
+  char name[] = "/tmp/raw_log_test_XXXXXX";
+  int fd = mkstemp(name);
+  ASSERT_GE(fd, 0);
+  ::close(fd);
+  {
+    RawLogWriter writer;
+    ASSERT_TRUE(writer.open(name, RAW_LOG_UNCOMPRESSED, 0, 8));
+    std::vector<uint8_t> data(RAW_LOG_PACKET_SIZE, 7);
+    for (int i = 0; i < 16; ++i)
+      ASSERT_TRUE(writer.write(i + 1, &data[0], false));
+    ASSERT_TRUE(writer.close());
+  }
+  // cut off the index and the end of the second chunk
+  size_t chunk_size = sizeof(RawLogChunk) + 8 * (8 + RAW_LOG_PACKET_SIZE);
+  ASSERT_EQ(0, truncate(name, sizeof(RawLogHeader) + 2 * chunk_size - 100));
+
+  RawLogReader reader;
+  ASSERT_TRUE(reader.open(name));
+  const uint8_t *payload;
+  uint64_t stamp_ns;
+  size_t count = 0;
+  while (reader.next(payload, stamp_ns))
+    ++count;
+  EXPECT_EQ(8u, count);
+  EXPECT_FALSE(reader.error().empty());
+  unlink(name);
+}
+
+TEST(RawLog, NotARawLog)
+{
+  RawLogReader reader;
+  EXPECT_FALSE(reader.open("/nonexistent/file.vlog"));
+  EXPECT_FALSE(RawLogReader::isRawLog("/nonexistent/file.vlog"));
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  int ret = RUN_ALL_TESTS();
+  return ret;
+}
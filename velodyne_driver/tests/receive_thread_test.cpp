@@ -0,0 +1,92 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include <ros/ros.h>
+#include <velodyne_driver/driver.h>
+
+namespace
+{
+
+const int TEST_PORT = 2399;
+
+/** sends one data packet to the driver over the loopback interface */
+void sendPacket()
+{
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(TEST_PORT);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  std::vector<uint8_t> packet(1206, 0);
+  EXPECT_EQ(1206, sendto(fd, &packet[0], packet.size(), 0,
+                         reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+  close(fd);
+}
+
+}  // namespace
+
+TEST(ReceiveThread, SurvivesSilentSocket)
+{
+  ros::NodeHandle node;
+  ros::NodeHandle private_nh("~");
+  private_nh.setParam("port", TEST_PORT);
+  private_nh.setParam("npackets", 1);
+  private_nh.setParam("receive_thread", true);
+  velodyne_driver::VelodyneDriver driver(node, private_nh);
+
+  // nothing arrives for longer than a socket read waits
+  EXPECT_FALSE(driver.poll());
+  ros::Duration(1.5).sleep();
+
+  // the receive thread still passes on what arrives then
+  sendPacket();
+  bool published = false;
+  for (int i = 0; i < 3 && !published; ++i)
+    published = driver.poll();
+  EXPECT_TRUE(published);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "receive_thread_test");
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,120 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "velodyne_driver/replay_scheduler.h"
+#include <gtest/gtest.h>
+
+using velodyne_driver::ReplayScheduler;
+
+static const int64_t MS = 1000000;
+
+TEST(ReplayScheduler, FollowsCaptureTime)
+{
+  ReplayScheduler scheduler;
+  const uint64_t start = 1500000000ull * 1000000000ull;
+  EXPECT_EQ(10 * MS, scheduler.schedule(start, 10 * MS));
+  EXPECT_EQ(11 * MS, scheduler.schedule(start + MS, 10 * MS));
+  // deadlines do not depend on when packets are scheduled
+  EXPECT_EQ(110 * MS, scheduler.schedule(start + 100 * MS, 50 * MS));
+  EXPECT_EQ(3u, scheduler.packets());
+}
+
+TEST(ReplayScheduler, Speed)
+{
+  ReplayScheduler fast(4.0);
+  EXPECT_EQ(0, fast.schedule(4 * MS, 0));
+  EXPECT_EQ(1 * MS, fast.schedule(8 * MS, 0));
+
+  ReplayScheduler slow(0.5);
+  EXPECT_EQ(0, slow.schedule(4 * MS, 0));
+  EXPECT_EQ(8 * MS, slow.schedule(8 * MS, 0));
+
+  EXPECT_EQ(0.5, ReplayScheduler(0.1).speed());
+  EXPECT_EQ(20.0, ReplayScheduler(100.0).speed());
+}
+
+TEST(ReplayScheduler, StartsOverAtJumps)
+{
+  ReplayScheduler scheduler(1.0, 0.0, 1.0);
+  scheduler.schedule(100 * MS, 0);
+  EXPECT_EQ(50 * MS, scheduler.schedule(150 * MS, 0));
+
+  // backwards, e.g. a replayed file: right after the previous packet
+  EXPECT_EQ(50 * MS, scheduler.schedule(10 * MS, 0));
+  EXPECT_EQ(60 * MS, scheduler.schedule(20 * MS, 0));
+
+  // a long pause is skipped, and a late schedule starts at now
+  EXPECT_EQ(500 * MS, scheduler.schedule(5000 * MS, 500 * MS));
+  EXPECT_EQ(501 * MS, scheduler.schedule(5001 * MS, 500 * MS));
+
+  scheduler.reset();
+  EXPECT_EQ(900 * MS, scheduler.schedule(0 + MS, 900 * MS));
+}
+
+TEST(ReplayScheduler, MissingTimeStamps)
+{
+  ReplayScheduler scheduler(1.0, 0.002);
+  EXPECT_EQ(0, scheduler.schedule(0, 0));
+  EXPECT_EQ(2 * MS, scheduler.schedule(0, 0));
+  EXPECT_EQ(4 * MS, scheduler.schedule(0, 0));
+}
+
+TEST(ReplayScheduler, Statistics)
+{
+  ReplayScheduler scheduler(2.0);
+  for (int i = 0; i <= 100; ++i)
+    scheduler.schedule(i * MS, 0);
+  EXPECT_DOUBLE_EQ(2000.0, scheduler.targetRate());
+
+  scheduler.released(25 * MS, 28 * MS);
+  scheduler.released(48 * MS, 50 * MS);
+  EXPECT_DOUBLE_EQ(0.003, scheduler.maxLateness());
+  EXPECT_DOUBLE_EQ(2000.0, scheduler.achievedRate());
+
+  scheduler.resetStatistics();
+  EXPECT_EQ(0u, scheduler.packets());
+  EXPECT_EQ(0.0, scheduler.targetRate());
+}
+
+TEST(ReplayScheduler, SleepUntil)
+{
+  int64_t deadline = ReplayScheduler::now() + 2 * MS;
+  ReplayScheduler::sleepUntil(deadline);
+  EXPECT_GE(ReplayScheduler::now(), deadline);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  int ret = RUN_ALL_TESTS();
+  return ret;
+}
@@ -0,0 +1,123 @@
+// Copyright (C) 2020 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "velodyne_driver/scan_pool.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <new>
+
+// count every heap allocation of this process
+static size_t g_allocations = 0;
+
+void *operator new(size_t size)
+{
+  ++g_allocations;
+  void *p = std::malloc(size ? size : 1);
+  if (p == NULL)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+static const size_t PACKETS_PER_SCAN = 76;
+
+// what the driver does with every scan it gets
+static void assembleScan(const velodyne_msgs::VelodyneScanPtr &scan, bool cut_angle)
+{
+  if (cut_angle)
+    {
+      velodyne_msgs::VelodynePacket packet;
+      for (size_t i = 0; i < PACKETS_PER_SCAN; ++i)
+        scan->packets.push_back(packet);
+    }
+  else
+    {
+      scan->packets.resize(PACKETS_PER_SCAN);
+    }
+  scan->header.stamp = scan->packets.back().stamp;
+}
+
+TEST(ScanPool, ScansInUseAreNotRecycled)
+{
+  velodyne_driver::ScanPool pool(4, PACKETS_PER_SCAN);
+  velodyne_msgs::VelodyneScanPtr first = pool.get();
+  velodyne_msgs::VelodyneScanPtr second = pool.get();
+  ASSERT_NE(first, second);
+
+  velodyne_msgs::VelodyneScan *released = second.get();
+  second.reset();
+  ASSERT_EQ(pool.get().get(), released);
+  ASSERT_EQ(pool.allocations(), 2u);
+}
+
+TEST(ScanPool, SteadyStateDoesNotAllocate)
+{
+  for (int cut_angle = 0; cut_angle < 2; ++cut_angle)
+    {
+      velodyne_driver::ScanPool pool(8, PACKETS_PER_SCAN);
+
+      // a subscriber keeping the last few scans, like a message queue
+      const size_t QUEUE = 3;
+      velodyne_msgs::VelodyneScanConstPtr queue[QUEUE];
+
+      // warm up: fill the subscriber queue and the pool
+      size_t n = 0;
+      for (; n < 2 * QUEUE; ++n)
+        {
+          velodyne_msgs::VelodyneScanPtr scan = pool.get();
+          assembleScan(scan, cut_angle);
+          queue[n % QUEUE] = scan;
+        }
+
+      size_t allocations_before = g_allocations;
+      for (; n < 1000; ++n)
+        {
+          velodyne_msgs::VelodyneScanPtr scan = pool.get();
+          assembleScan(scan, cut_angle);
+          ASSERT_EQ(scan->packets.size(), PACKETS_PER_SCAN);
+          queue[n % QUEUE] = scan;
+        }
+      EXPECT_EQ(g_allocations, allocations_before);
+      EXPECT_LE(pool.allocations(), QUEUE + 1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  int ret = RUN_ALL_TESTS();
+  return ret;
+}
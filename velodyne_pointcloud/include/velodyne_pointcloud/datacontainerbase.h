@@ -37,10 +37,16 @@
 #include <velodyne_msgs/VelodyneScan.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
 #include <eigen3/Eigen/Dense>
+#include <velodyne_pointcloud/point_batch.h>
+#include <velodyne_pointcloud/point_transform.h>
+#include <velodyne_pointcloud/pose_interpolator.h>
+#include <velodyne_pointcloud/transform_cache.h>
+#include <cmath>
 #include <memory>
 #include <string>
+#include <vector>
 #include <algorithm>
-#include <cstdarg>
+#include <cstring>
 
 namespace velodyne_rawdata
 {
@@ -49,27 +55,24 @@ class DataContainerBase
 public:
   DataContainerBase(const double max_range, const double min_range, const std::string& target_frame,
                     const std::string& fixed_frame, const unsigned int init_width, const unsigned int init_height,
-                    const bool is_dense, const unsigned int scans_per_packet, int fields, ...)
+                    const bool is_dense, const unsigned int scans_per_packet,
+                    const std::vector<sensor_msgs::PointField>& fields, const uint32_t point_step)
     : config_(max_range, min_range, target_frame, fixed_frame, init_width, init_height, is_dense, scans_per_packet)
+    , lines_per_packet_(0)
+    , points_(NULL)
+    , motion_samples_(DEFAULT_MOTION_SAMPLES)
+    , packet_time_(nanf(""))
+    , output_time_(nanf(""))
   {
-    va_list vl;
-    cloud.fields.clear();
-    cloud.fields.reserve(fields);
-    va_start(vl, fields);
-    int offset = 0;
-    for (int i = 0; i < fields; ++i)
-    {
-      // Create the corresponding PointField
-      std::string name(va_arg(vl, char*));
-      int count(va_arg(vl, int));
-      int datatype(va_arg(vl, int));
-      offset = addPointField(cloud, name, count, datatype, offset);
-    }
-    va_end(vl);
-    cloud.point_step = offset;
+    tf_matrix_to_target.setIdentity();
+    cloud.fields = fields;
+    cloud.point_step = point_step;
     cloud.row_step = init_width * cloud.point_step;
   }
 
+  /** transform lookups per scan for ego motion compensation */
+  static const int DEFAULT_MOTION_SAMPLES = 4;
+
   struct Config
   {
     double max_range;          ///< maximum range to publish
@@ -106,7 +109,8 @@ public:
     manage_tf_buffer();
 
     cloud.header.stamp = scan_msg->header.stamp;
-    cloud.data.resize(scan_msg->packets.size() * config_.scans_per_packet * cloud.point_step);
+    cloud.data.resize(scan_msg->packets.size() * packetStride());
+    points_ = cloud.data.data();
     cloud.width = config_.init_width;
     cloud.height = config_.init_height;
     cloud.is_dense = static_cast<uint8_t>(config_.is_dense);
@@ -114,8 +118,87 @@ public:
 
   virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth, const float distance,
                         const float intensity, const float time) = 0;
+
+  /** \brief Add all points of a batch.
+   *
+   *  The decoders gate batches to the configured range already, returns
+   *  out of it or without a distance have a NaN distance.  Containers
+   *  should override this with a loop over the batch arrays, the
+   *  default forwards every point to addPoint().
+   */
+  virtual void addPoints(const PointBatch& batch)
+  {
+    for (int i = 0; i < batch.size; ++i)
+    {
+      addPoint(batch.x[i], batch.y[i], batch.z[i], batch.ring[i], batch.azimuth[i], batch.distance[i],
+               batch.intensity[i], batch.time[i]);
+    }
+  }
+
   virtual void newLine() = 0;
 
+  /** \brief End a line of which nothing was decoded.
+   *
+   *  Keeps the rows of organized clouds independent of which blocks
+   *  are skipped, the default just ends the line.
+   */
+  virtual void skipLine()
+  {
+    newLine();
+  }
+
+  /** @param lines newLine() calls per packet at most, organized clouds reserve a row for each */
+  void setLinesPerPacket(unsigned int lines)
+  {
+    lines_per_packet_ = lines;
+  }
+
+  /** @returns bytes of cloud.data reserved for the points of one packet */
+  size_t packetStride() const
+  {
+    return std::max<size_t>(config_.scans_per_packet, static_cast<size_t>(lines_per_packet_) * config_.init_width)
+           * cloud.point_step;
+  }
+
+  /** \brief Decode a part of another container's scan, in parallel to it.
+   *
+   *  From now on this container writes into the cloud of parent, from
+   *  where parent's setup() reserved room for first_packet on, with the
+   *  transforms parent computed for the scan.  Containers of the same
+   *  type only.  Call after parent is set up, before any of them decodes.
+   *  Once all are done, parent.appendRegion() moves the points together.
+   */
+  void beginRegion(const DataContainerBase& parent, size_t first_packet)
+  {
+    config_ = parent.config_;
+    sensor_frame = parent.sensor_frame;
+    tf_matrix_to_target = parent.tf_matrix_to_target;
+    motion_ = parent.motion_;
+    packet_time_ = nanf("");
+    output_time_ = nanf("");
+    cloud.width = config_.init_width;
+    cloud.height = config_.init_height;
+    points_ = parent.points_ + first_packet * parent.packetStride();
+  }
+
+  /** \brief Move the points of a region decoded after this one's behind them.
+   *
+   *  Dense clouds grow in width, organized ones by rows.
+   */
+  void appendRegion(const DataContainerBase& region)
+  {
+    const size_t size = region.cloud.width * region.cloud.height * cloud.point_step;
+    std::memmove(points_ + cloud.width * cloud.height * cloud.point_step, region.points_, size);
+    if (config_.init_width == 0)
+    {
+      cloud.width += region.cloud.width;
+    }
+    else
+    {
+      cloud.height += region.cloud.height;
+    }
+  }
+
   const sensor_msgs::PointCloud2& finishCloud()
   {
     cloud.data.resize(cloud.point_step * cloud.width * cloud.height);
@@ -178,6 +261,7 @@ public:
     config_.fixed_frame = fixed_frame;
     config_.target_frame = target_frame;
 
+    tf_cache_.clear();
     manage_tf_buffer();
   }
 
@@ -186,6 +270,10 @@ public:
   inline bool calculateTransformMatrix(Eigen::Affine3f& matrix, const std::string& target_frame,
                                        const std::string& source_frame, const ros::Time& time)
   {
+    if (tf_cache_.find(target_frame, source_frame, time, matrix))
+    {
+      return true;
+    }
     if (!tf_buffer)
     {
       ROS_ERROR("tf buffer was not initialized yet");
@@ -193,67 +281,195 @@ public:
     }
 
     geometry_msgs::TransformStamped msg;
-    try
-    {
-      msg = tf_buffer->lookupTransform(target_frame, source_frame, time, ros::Duration(0.2));
-    }
-    catch (tf2::LookupException& e)
+    if (tf_cache_.staticCheckDue(target_frame, source_frame, time))
     {
-      ROS_ERROR("%s", e.what());
-      return false;
+      // the latest transform through static frames only has no time stamp
+      if (!lookupTransform(msg, target_frame, source_frame, ros::Time(0)))
+      {
+        return false;
+      }
+      const bool is_static = msg.header.stamp.isZero();
+      matrix = toMatrix(msg);
+      tf_cache_.setStatic(target_frame, source_frame, time, is_static, matrix);
+      if (is_static)
+      {
+        return true;
+      }
     }
-    catch (tf2::ExtrapolationException& e)
+
+    if (!lookupTransform(msg, target_frame, source_frame, time))
     {
-      ROS_ERROR("%s", e.what());
       return false;
     }
-
-    const geometry_msgs::Quaternion& quaternion = msg.transform.rotation;
-    Eigen::Quaternionf rotation(quaternion.w, quaternion.x, quaternion.y, quaternion.z);
-
-    const geometry_msgs::Vector3& origin = msg.transform.translation;
-    Eigen::Translation3f translation(origin.x, origin.y, origin.z);
-
-    matrix = translation * rotation;
+    matrix = toMatrix(msg);
+    tf_cache_.insert(target_frame, source_frame, time, matrix);
     return true;
   }
 
   inline bool computeTransformToTarget(const ros::Time &scan_time)
   {
+    output_time_ = nanf("");
     if (config_.target_frame.empty())
     {
       // no need to calculate transform -> success
+      tf_matrix_to_target.setIdentity();
       return true;
     }
     std::string& source_frame = config_.fixed_frame.empty() ? sensor_frame : config_.fixed_frame;
     return calculateTransformMatrix(tf_matrix_to_target, config_.target_frame, source_frame, scan_time);
   }
 
-  inline bool computeTransformToFixed(const ros::Time &packet_time)
+  /** \brief Sample the transform to the fixed frame during a scan.
+   *
+   *  Looks up the transform at motion_samples times spread evenly
+   *  from the first to the last packet of the scan.  The pose of every
+   *  firing is interpolated between them.
+   */
+  inline bool computeMotionToFixed(const velodyne_msgs::VelodyneScan& scan)
   {
-    if (config_.fixed_frame.empty())
+    motion_.clear();
+    packet_time_ = nanf("");
+    output_time_ = nanf("");
+    if (config_.fixed_frame.empty() || scan.packets.empty())
     {
       // no need to calculate transform -> success
       return true;
     }
-    std::string &source_frame = sensor_frame;
-    return calculateTransformMatrix(tf_matrix_to_fixed, config_.fixed_frame, source_frame, packet_time);
+
+    const ros::Time& first = scan.packets.front().stamp;
+    const ros::Time& last = scan.packets.back().stamp;
+    const int samples = last > first ? motion_samples_ : 1;
+    for (int i = 0; i < samples; ++i)
+    {
+      ros::Time time = first;
+      if (samples > 1)
+      {
+        time = first + (last - first) * (static_cast<double>(i) / (samples - 1));
+      }
+      Eigen::Affine3f pose;
+      if (!calculateTransformMatrix(pose, config_.fixed_frame, sensor_frame, time))
+      {
+        return false;
+      }
+      motion_.addSample((time - scan.header.stamp).toSec(), Eigen::Quaternionf(pose.linear()), pose.translation());
+    }
+    return true;
+  }
+
+  /** \brief Use the time of the packet for all its firings.
+   *
+   *  For sensors without per firing timing, whose points have no time.
+   *
+   *  @param time relative to the scan time stamp [s]
+   */
+  void setPacketTime(float time)
+  {
+    packet_time_ = time;
   }
 
-  inline void transformPoint(float& x, float& y, float& z)
+  /** @param samples transform lookups per scan for ego motion compensation, at least 2 */
+  void setMotionSamples(int samples)
   {
-    Eigen::Vector3f p = Eigen::Vector3f(x, y, z);
-    if (!config_.fixed_frame.empty())
+    motion_samples_ = std::max(samples, 2);
+  }
+
+  /** @param resolution time buckets of cached dynamic transforms [s], 0 for exact times */
+  void setTransformCacheResolution(double resolution)
+  {
+    tf_cache_.setResolution(resolution);
+  }
+
+  const TransformCache& transformCache() const
+  {
+    return tf_cache_;
+  }
+
+  /** @returns true unless points stay in the sensor frame */
+  inline bool transformNeeded() const
+  {
+    return !config_.fixed_frame.empty() || !config_.target_frame.empty();
+  }
+
+  /** \brief Transform from the sensor to the output frame.
+   *
+   *  The pose in the fixed frame and the transform to the target frame
+   *  composed into one matrix.
+   *
+   *  @param time firing time, relative to the scan time stamp [s]
+   */
+  inline const PointTransform& sensorToOutput(float time)
+  {
+    if (config_.fixed_frame.empty())
     {
-      p = tf_matrix_to_fixed * p;
+      time = 0.0f;
     }
-    if (!config_.target_frame.empty())
+    else if (!std::isnan(packet_time_))
+    {
+      time = packet_time_;
+    }
+    if (time != output_time_)
+    {
+      if (config_.fixed_frame.empty())
+      {
+        output_transform_ = tf_matrix_to_target.matrix().topRows<3>();
+      }
+      else
+      {
+        output_transform_ = (tf_matrix_to_target * motion_.poseAt(time)).matrix().topRows<3>();
+      }
+      output_time_ = time;
+    }
+    return output_transform_;
+  }
+
+  /** @param time firing time of the point, relative to the scan time stamp [s] */
+  inline void transformPoint(float& x, float& y, float& z, const float time)
+  {
+    velodyne_rawdata::transformPoints(sensorToOutput(time), &x, &y, &z, 1, &x, &y, &z);
+  }
+
+  /** \brief Transform the coordinates of a whole batch.
+   *
+   *  Points of a batch are fired within a few hundred microseconds.
+   *  Only the transforms at the first and the last firing are computed,
+   *  the ones in between are blended linearly.
+   *
+   *  @param x, y, z output coordinates, batch.size of each
+   */
+  inline void transformBatch(const PointBatch& batch, float* x, float* y, float* z)
+  {
+    const int n = batch.size;
+    if (n == 0)
+    {
+      return;
+    }
+    if (!transformNeeded())
+    {
+      std::copy(batch.x, batch.x + n, x);
+      std::copy(batch.y, batch.y + n, y);
+      std::copy(batch.z, batch.z + n, z);
+      return;
+    }
+
+    float first = batch.time[0];
+    float last = batch.time[0];
+    if (!config_.fixed_frame.empty() && std::isnan(packet_time_))
     {
-      p = tf_matrix_to_target * p;
+      const Eigen::Map<const Eigen::ArrayXf> time(batch.time, n);
+      first = time.minCoeff();
+      last = time.maxCoeff();
+    }
+    if (first == last)
+    {
+      velodyne_rawdata::transformPoints(sensorToOutput(first), batch.x, batch.y, batch.z, n, x, y, z);
+      return;
     }
-    x = p.x();
-    y = p.y();
-    z = p.z();
+
+    const PointTransform m0 = sensorToOutput(first);
+    const PointTransform& m1 = sensorToOutput(last);
+    alignas(32) float s[PointBatch::CAPACITY];
+    Eigen::Map<Eigen::ArrayXf>(s, n) = (Eigen::Map<const Eigen::ArrayXf>(batch.time, n) - first) / (last - first);
+    transformPointsBlended(m0, m1, s, batch.x, batch.y, batch.z, n, x, y, z);
   }
 
   inline bool pointInRange(float range)
@@ -262,11 +478,49 @@ public:
   }
 
 protected:
+  bool lookupTransform(geometry_msgs::TransformStamped& msg, const std::string& target_frame,
+                       const std::string& source_frame, const ros::Time& time)
+  {
+    try
+    {
+      msg = tf_buffer->lookupTransform(target_frame, source_frame, time, ros::Duration(0.2));
+    }
+    catch (tf2::LookupException& e)
+    {
+      ROS_ERROR("%s", e.what());
+      return false;
+    }
+    catch (tf2::ExtrapolationException& e)
+    {
+      ROS_ERROR("%s", e.what());
+      return false;
+    }
+    return true;
+  }
+
+  static Eigen::Affine3f toMatrix(const geometry_msgs::TransformStamped& msg)
+  {
+    const geometry_msgs::Quaternion& quaternion = msg.transform.rotation;
+    Eigen::Quaternionf rotation(quaternion.w, quaternion.x, quaternion.y, quaternion.z);
+
+    const geometry_msgs::Vector3& origin = msg.transform.translation;
+    Eigen::Translation3f translation(origin.x, origin.y, origin.z);
+
+    return Eigen::Affine3f(translation * rotation);
+  }
+
   Config config_;
+  unsigned int lines_per_packet_;
+  uint8_t* points_;  ///< where the points of this container go, inside some cloud.data
   std::shared_ptr<tf2_ros::TransformListener> tf_listener;
   std::shared_ptr<tf2_ros::Buffer> tf_buffer;
-  Eigen::Affine3f tf_matrix_to_fixed;
+  TransformCache tf_cache_;
+  PoseInterpolator motion_;  ///< sensor poses in the fixed frame during the scan
+  int motion_samples_;
+  float packet_time_;        ///< firing time of all points of the packet, NaN if they have their own
   Eigen::Affine3f tf_matrix_to_target;
+  PointTransform output_transform_;  ///< sensorToOutput(output_time_)
+  float output_time_;
   std::string sensor_frame;
 };
 } /* namespace velodyne_rawdata */
@@ -0,0 +1,148 @@
+/** @file
+
+    Vectorized decode kernels for the 32 returns of one raw data block.
+
+    All lasers of a block share the block rotation, and their
+    calibration is fixed, so the position and intensity math of
+    RawData::unpack() can be computed for several lasers at once.  The
+    SIMD variants are selected at run time, depending on the
+    instruction sets the CPU supports.  The scalar kernel is the
+    reference, and the vector kernels produce bit-identical results.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_DECODE_KERNELS_H
+#define VELODYNE_POINTCLOUD_DECODE_KERNELS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <velodyne_pointcloud/decode_plan.h>
+#include <velodyne_pointcloud/point_batch.h>
+
+namespace velodyne_rawdata
+{
+/** number of returns in one raw data block */
+static const int KERNEL_BLOCK_SIZE = 32;
+
+/** \brief Decode a single return.
+ *
+ *  The reference for all kernels, also used directly by decoders
+ *  which correct the rotation of every return, like the VLP-16 one.
+ *  Writes x, y, z, distance and intensity of entry i of the batch,
+ *  NaN if the return has no valid distance.
+ */
+inline void decodeReturn(const DecodePlan& plan, int laser, uint16_t raw_distance, uint8_t raw_intensity,
+                         float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch, int i)
+{
+  if (raw_distance == 0)  // no valid laser beam return
+  {
+    batch.x[i] = nanf("");
+    batch.y[i] = nanf("");
+    batch.z[i] = nanf("");
+    batch.distance[i] = nanf("");
+    batch.intensity[i] = nanf("");
+    return;
+  }
+
+  float distance = raw_distance * distance_resolution;
+  distance += plan.dist_correction[laser];
+
+  float cos_vert_angle = plan.cos_vert[laser];
+  float sin_vert_angle = plan.sin_vert[laser];
+
+  // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
+  // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
+  float cos_rot_angle = cos_rot * plan.cos_rot[laser] + sin_rot * plan.sin_rot[laser];
+  float sin_rot_angle = sin_rot * plan.cos_rot[laser] - cos_rot * plan.sin_rot[laser];
+
+  float horiz_offset = plan.horiz_offset[laser];
+  float vert_offset_term = plan.vert_offset_sin_vert[laser];
+
+  // Get 2points calibration values,Linear interpolation to get distance
+  // correction for X and Y, that means distance correction use
+  // different value at different distance
+  float distance_corr_x = 0;
+  float distance_corr_y = 0;
+  if (plan.two_pt_mask[laser])
+  {
+    // Compute the distance in the xy plane (w/o accounting for rotation)
+    float xy_distance = distance * cos_vert_angle - vert_offset_term;
+    float xx = fabsf(xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle);
+    float yy = fabsf(xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle);
+    distance_corr_x = plan.two_pt_slope_x[laser] * (xx - DecodePlan::TWO_PT_NEAR_X) + plan.two_pt_offset_x[laser];
+    distance_corr_y = plan.two_pt_slope_y[laser] * (yy - DecodePlan::TWO_PT_NEAR_Y) + plan.two_pt_offset_y[laser];
+  }
+
+  float distance_x = distance + distance_corr_x;
+  float xy_distance = distance_x * cos_vert_angle - vert_offset_term;
+  float x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
+
+  float distance_y = distance + distance_corr_y;
+  xy_distance = distance_y * cos_vert_angle - vert_offset_term;
+  float y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
+
+  // Using distance_y is not symmetric, but the velodyne manual
+  // does this.
+  float z = distance_y * sin_vert_angle + plan.vert_offset_cos_vert[laser];
+
+  /** Use standard ROS coordinate system (right-hand rule) */
+  batch.x[i] = y;
+  batch.y[i] = -x;
+  batch.z[i] = z;
+  batch.distance[i] = distance;
+
+  /** Intensity Calculation */
+  float scaled = 1 - static_cast<float>(raw_distance) / 65535;
+  float intensity = raw_intensity;
+  intensity += plan.focal_slope[laser] * fabsf(plan.focal_offset[laser] - 256 * (scaled * scaled));
+  intensity = (intensity < plan.min_intensity[laser]) ? plan.min_intensity[laser] : intensity;
+  intensity = (intensity > plan.max_intensity[laser]) ? plan.max_intensity[laser] : intensity;
+  batch.intensity[i] = intensity;
+}
+
+/** \brief Decode the returns of one block.
+ *
+ *  Fills x, y, z, distance and intensity of the first
+ *  KERNEL_BLOCK_SIZE entries of the batch.  Returns without a valid
+ *  distance, or out of range, are set to NaN.  Ring, azimuth, time and
+ *  size are left to the caller.
+ *
+ *  @param plan per-laser decode constants
+ *  @param gate raw distances in range
+ *  @param bank_origin number of the first laser of this block (0, 32, 64 or 96)
+ *  @param data raw block data, three bytes per return
+ *  @param distance_resolution raw distance unit [m]
+ *  @param cos_rot cosine of the block rotation
+ *  @param sin_rot sine of the block rotation
+ *  @param batch output
+ */
+typedef void (*DecodeBlockFn)(const DecodePlan& plan, const RangeGate& gate, int bank_origin,
+                              const uint8_t* data, float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch);
+
+enum DecodeKernel
+{
+  DECODE_KERNEL_SCALAR,
+  DECODE_KERNEL_SSE41,
+  DECODE_KERNEL_AVX2
+};
+
+/** @returns true if the kernel was built and the CPU can run it */
+bool decodeKernelSupported(DecodeKernel kernel);
+
+/** @returns the widest kernel supported by this CPU */
+DecodeKernel bestDecodeKernel();
+
+/** @returns the block decode function of a kernel, or the scalar one if it is not supported */
+DecodeBlockFn decodeBlockKernel(DecodeKernel kernel);
+
+const char* decodeKernelName(DecodeKernel kernel);
+
+void decodeBlockScalar(const DecodePlan& plan, const RangeGate& gate, int bank_origin, const uint8_t* data,
+                       float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch);
+void decodeBlockSse41(const DecodePlan& plan, const RangeGate& gate, int bank_origin, const uint8_t* data,
+                      float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch);
+void decodeBlockAvx2(const DecodePlan& plan, const RangeGate& gate, int bank_origin, const uint8_t* data,
+                     float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch);
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_DECODE_KERNELS_H
@@ -0,0 +1,101 @@
+/** @file
+
+    Per-laser decode constants, precomputed from the calibration.
+
+    Calibration::laser_corrections holds one LaserCorrection struct per
+    laser.  The decoders only need a few of its fields, and several
+    values derived from them, for every return.  The decode plan keeps
+    those values in cache line aligned arrays indexed by laser number,
+    so the vector kernels can load them directly and nothing which only
+    depends on the calibration is computed per point.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_DECODE_PLAN_H
+#define VELODYNE_POINTCLOUD_DECODE_PLAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <velodyne_pointcloud/calibration.h>
+
+namespace velodyne_rawdata
+{
+/** \brief Struct-of-arrays decode constants of up to 128 lasers.
+ *
+ *  Built once by RawData::setup() or RawData::setupOffline() and
+ *  never modified afterwards, so copies of a RawData share it.
+ */
+struct DecodePlan
+{
+  static const int MAX_LASERS = 128;
+
+  // where the two point distance corrections are specified [m]
+  static constexpr float TWO_PT_NEAR_X = 2.4f;
+  static constexpr float TWO_PT_NEAR_Y = 1.93f;
+  static constexpr float TWO_PT_FAR = 25.04f;
+
+  alignas(64) float cos_vert[MAX_LASERS];
+  alignas(64) float sin_vert[MAX_LASERS];
+  alignas(64) float cos_rot[MAX_LASERS];
+  alignas(64) float sin_rot[MAX_LASERS];
+  alignas(64) float horiz_offset[MAX_LASERS];
+  alignas(64) float vert_offset_sin_vert[MAX_LASERS];  ///< vert_offset * sin_vert, subtracted from xy distance
+  alignas(64) float vert_offset_cos_vert[MAX_LASERS];  ///< vert_offset * cos_vert, added to z
+  alignas(64) float dist_correction[MAX_LASERS];
+
+  /** two point correction, slope * (|x| - TWO_PT_NEAR_X) + offset */
+  alignas(64) uint32_t two_pt_mask[MAX_LASERS];  ///< all bits set if two point correction is available
+  alignas(64) float two_pt_slope_x[MAX_LASERS];
+  alignas(64) float two_pt_slope_y[MAX_LASERS];
+  alignas(64) float two_pt_offset_x[MAX_LASERS];
+  alignas(64) float two_pt_offset_y[MAX_LASERS];
+
+  /** intensity correction, focal_slope * |focal_offset - 256 * (1 - raw / 65535)^2| */
+  alignas(64) float focal_offset[MAX_LASERS];
+  alignas(64) float focal_slope[MAX_LASERS];
+  alignas(64) float min_intensity[MAX_LASERS];
+  alignas(64) float max_intensity[MAX_LASERS];
+
+  alignas(64) uint16_t ring[MAX_LASERS];
+
+  /** fill all arrays from a calibration, lasers past MAX_LASERS are ignored */
+  void build(const velodyne_pointcloud::Calibration& calibration);
+
+  /** allocate a plan for a calibration */
+  static boost::shared_ptr<DecodePlan> create(const velodyne_pointcloud::Calibration& calibration);
+
+  // plain new only guarantees 16 byte alignment before C++17
+  static void* operator new(size_t size);
+  static void operator delete(void* p);
+};
+
+/** \brief Raw distances in the configured range, per laser.
+ *
+ *  The range limits [m] are converted to raw distance units once, with
+ *  the distance correction of each laser, so returns out of range are
+ *  rejected right after reading their two distance bytes.  The bounds
+ *  are exact: a raw distance passes if and only if the distance the
+ *  decoders compute from it is in range.  That includes raw distance
+ *  0, decoders which know it as no return drop it themselves.
+ */
+struct RangeGate
+{
+  uint16_t min_raw[DecodePlan::MAX_LASERS];
+  uint16_t max_raw[DecodePlan::MAX_LASERS];
+
+  /** passes every return */
+  RangeGate();
+
+  /** @param dist_correction per laser [m], NULL for none
+   *  @param distance_resolution raw distance unit [m] */
+  void build(const float* dist_correction, float distance_resolution, double min_range, double max_range);
+
+  bool pass(int laser, uint16_t raw_distance) const
+  {
+    return raw_distance >= min_raw[laser] && raw_distance <= max_raw[laser];
+  }
+};
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_DECODE_PLAN_H
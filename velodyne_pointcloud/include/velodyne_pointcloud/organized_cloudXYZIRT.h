@@ -34,28 +34,107 @@
 #define VELODYNE_POINTCLOUD_ORGANIZED_CLOUDXYZIRT_H
 
 #include <velodyne_pointcloud/datacontainerbase.h>
-#include <sensor_msgs/point_cloud2_iterator.h>
+#include <velodyne_pointcloud/point_types.h>
+#include <cmath>
+#include <cstring>
 #include <string>
+#include <vector>
 
 namespace velodyne_pointcloud
 {
-class OrganizedCloudXYZIRT : public velodyne_rawdata::DataContainerBase
+/** \brief Organized cloud, a row per block and a column per laser ring.
+ *
+ *  @param Point layout of the points, see point_types.h
+ */
+template <typename Point>
+class OrganizedPointcloud : public velodyne_rawdata::DataContainerBase
 {
 public:
-  OrganizedCloudXYZIRT(const double max_range, const double min_range, const std::string& target_frame,
-                       const std::string& fixed_frame, const unsigned int num_lasers,
-                       const unsigned int scans_per_block);
+  OrganizedPointcloud(const double max_range, const double min_range, const std::string& target_frame,
+                      const std::string& fixed_frame, const unsigned int num_lasers,
+                      const unsigned int scans_per_block)
+    : DataContainerBase(max_range, min_range, target_frame, fixed_frame, num_lasers, 0, false, scans_per_block,
+                        fields(), sizeof(Point))
+  {
+  }
 
-  virtual void newLine();
+  virtual void newLine()
+  {
+    ++cloud.height;
+  }
 
-  virtual void setup(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg);
+  /** fills the row with invalid points, like returns without a distance */
+  virtual void skipLine()
+  {
+    for (unsigned int ring = 0; ring < config_.init_width; ++ring)
+    {
+      writePoint(false, nanf(""), nanf(""), nanf(""), ring, 0, nanf(""), 0);
+    }
+    ++cloud.height;
+  }
 
-  virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth, const float distance,
-                        const float intensity, const float time);
+  virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
+                        const float distance, const float intensity, const float time)
+  {
+    const bool valid = pointInRange(distance);
+    if (valid)
+    {
+      transformPoint(x, y, z, time);
+    }
+    writePoint(valid, x, y, z, ring, azimuth, intensity, time);
+  }
+
+  virtual void addPoints(const velodyne_rawdata::PointBatch& batch)
+  {
+    alignas(32) float x[velodyne_rawdata::PointBatch::CAPACITY];
+    alignas(32) float y[velodyne_rawdata::PointBatch::CAPACITY];
+    alignas(32) float z[velodyne_rawdata::PointBatch::CAPACITY];
+    transformBatch(batch, x, y, z);
+
+    for (int i = 0; i < batch.size; ++i)
+    {
+      writePoint(!std::isnan(batch.distance[i]), x[i], y[i], z[i], batch.ring[i], batch.azimuth[i],
+                 batch.intensity[i], batch.time[i]);
+    }
+  }
 
 private:
-  sensor_msgs::PointCloud2Iterator<float> iter_x, iter_y, iter_z, iter_intensity, iter_time;
-  sensor_msgs::PointCloud2Iterator<uint16_t> iter_ring;
+  static std::vector<sensor_msgs::PointField> fields()
+  {
+    std::vector<sensor_msgs::PointField> fields;
+    Point::describe(fields);
+    return fields;
+  }
+
+  inline void writePoint(bool valid, float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
+                         const float intensity, const float time)
+  {
+    /** The laser values are not ordered, the organized structure
+     * needs ordered neighbour points. The right order is defined
+     * by the laser_ring value.
+     * To keep the right ordering, the filtered values are set to
+     * NaN.
+     */
+    Point point;
+    if (valid)
+    {
+      point.assign(x, y, z, intensity, ring, azimuth, time);
+    }
+    else
+    {
+      point.assign(nanf(""), nanf(""), nanf(""), nanf(""), ring, azimuth, time);
+    }
+    std::memcpy(points_ + (cloud.height * config_.init_width + ring) * sizeof(Point), &point, sizeof(Point));
+  }
 };
-} /* namespace velodyne_pointcloud */
+
+typedef OrganizedPointcloud<layout::PointXYZIRT> OrganizedCloudXYZIRT;
+
+// the layouts shipped are compiled into the data_containers library
+extern template class OrganizedPointcloud<layout::PointXYZ>;
+extern template class OrganizedPointcloud<layout::PointXYZI>;
+extern template class OrganizedPointcloud<layout::PointXYZIRT>;
+extern template class OrganizedPointcloud<layout::PointXYZIRTA>;
+}  // namespace velodyne_pointcloud
+
 #endif  // VELODYNE_POINTCLOUD_ORGANIZED_CLOUDXYZIRT_H
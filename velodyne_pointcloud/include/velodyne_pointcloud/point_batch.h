@@ -0,0 +1,59 @@
+/** @file
+
+    Struct-of-arrays batch of decoded Velodyne returns, the unit in
+    which RawData hands points to a DataContainerBase.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_POINT_BATCH_H
+#define VELODYNE_POINTCLOUD_POINT_BATCH_H
+
+#include <stdint.h>
+
+namespace velodyne_rawdata
+{
+/** \brief Struct-of-arrays batch of decoded returns.
+ *
+ *  The decoders fill one batch per line (one block, or one firing for
+ *  the VLP-16) and hand it to the container with a single call.
+ */
+struct PointBatch
+{
+  static const int CAPACITY = 32;
+
+  alignas(32) float x[CAPACITY];
+  alignas(32) float y[CAPACITY];
+  alignas(32) float z[CAPACITY];
+  alignas(32) float distance[CAPACITY];
+  alignas(32) float intensity[CAPACITY];
+  alignas(32) float time[CAPACITY];
+  alignas(32) uint16_t ring[CAPACITY];
+  alignas(32) uint16_t azimuth[CAPACITY];
+  int size;
+
+  PointBatch() : size(0)
+  {
+  }
+
+  inline void clear()
+  {
+    size = 0;
+  }
+
+  inline void add(const float x_, const float y_, const float z_, const uint16_t ring_, const uint16_t azimuth_,
+                  const float distance_, const float intensity_, const float time_)
+  {
+    x[size] = x_;
+    y[size] = y_;
+    z[size] = z_;
+    ring[size] = ring_;
+    azimuth[size] = azimuth_;
+    distance[size] = distance_;
+    intensity[size] = intensity_;
+    time[size] = time_;
+    ++size;
+  }
+};
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_POINT_BATCH_H
@@ -0,0 +1,85 @@
+/** @file
+
+    Rigid transform of struct-of-arrays point coordinates.
+
+    The coordinates are mapped as Eigen arrays, so every row of the
+    transform is applied to all points at once with the widest vector
+    instructions the compiler was allowed to use.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_POINT_TRANSFORM_H
+#define VELODYNE_POINTCLOUD_POINT_TRANSFORM_H
+
+#include <algorithm>
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Geometry>
+
+namespace velodyne_rawdata
+{
+typedef Eigen::Matrix<float, 3, 4> PointTransform;  ///< rotation, then translation column
+
+/** \brief out = m * in for n points.
+ *
+ *  The output may be the input.
+ */
+inline void transformPoints(const PointTransform& m, const float* in_x, const float* in_y, const float* in_z, int n,
+                            float* out_x, float* out_y, float* out_z)
+{
+  typedef Eigen::Map<const Eigen::ArrayXf> In;
+  typedef Eigen::Map<Eigen::ArrayXf> Out;
+
+  // x and y go through temporaries, so the output can alias the input
+  Eigen::Array<float, 32, 1> tx, ty;
+  for (int i = 0; i < n; i += 32)
+  {
+    const int count = std::min(32, n - i);
+    const In x(in_x + i, count);
+    const In y(in_y + i, count);
+    const In z(in_z + i, count);
+    tx.head(count) = m(0, 0) * x + m(0, 1) * y + m(0, 2) * z + m(0, 3);
+    ty.head(count) = m(1, 0) * x + m(1, 1) * y + m(1, 2) * z + m(1, 3);
+    Out(out_z + i, count) = m(2, 0) * x + m(2, 1) * y + m(2, 2) * z + m(2, 3);
+    Out(out_x + i, count) = tx.head(count);
+    Out(out_y + i, count) = ty.head(count);
+  }
+}
+
+/** \brief out = (m0 + s * (m1 - m0)) * in for n points.
+ *
+ *  For points fired at different times while the sensor moves: m0 and
+ *  m1 are the transforms at the first and last firing, s the fraction
+ *  of that interval at which each point was fired.  Blending the
+ *  matrices linearly is exact for the translation.  Over the few
+ *  hundred microseconds of a block the error of the rotation is orders
+ *  of magnitude below the range resolution.
+ */
+inline void transformPointsBlended(const PointTransform& m0, const PointTransform& m1, const float* s,
+                                   const float* in_x, const float* in_y, const float* in_z, int n,
+                                   float* out_x, float* out_y, float* out_z)
+{
+  typedef Eigen::Map<const Eigen::ArrayXf> In;
+  typedef Eigen::Map<Eigen::ArrayXf> Out;
+  const PointTransform d = m1 - m0;
+
+  Eigen::Array<float, 32, 1> tx, ty;
+  for (int i = 0; i < n; i += 32)
+  {
+    const int count = std::min(32, n - i);
+    const In x(in_x + i, count);
+    const In y(in_y + i, count);
+    const In z(in_z + i, count);
+    const In t(s + i, count);
+    tx.head(count) = (m0(0, 0) + t * d(0, 0)) * x + (m0(0, 1) + t * d(0, 1)) * y + (m0(0, 2) + t * d(0, 2)) * z
+                     + (m0(0, 3) + t * d(0, 3));
+    ty.head(count) = (m0(1, 0) + t * d(1, 0)) * x + (m0(1, 1) + t * d(1, 1)) * y + (m0(1, 2) + t * d(1, 2)) * z
+                     + (m0(1, 3) + t * d(1, 3));
+    Out(out_z + i, count) = (m0(2, 0) + t * d(2, 0)) * x + (m0(2, 1) + t * d(2, 1)) * y
+                            + (m0(2, 2) + t * d(2, 2)) * z + (m0(2, 3) + t * d(2, 3));
+    Out(out_x + i, count) = tx.head(count);
+    Out(out_y + i, count) = ty.head(count);
+  }
+}
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_POINT_TRANSFORM_H
@@ -0,0 +1,181 @@
+/** @file
+
+    Layouts of the points in published clouds.
+
+    Each layout is a packed struct, laid out in the cloud data exactly
+    as in memory, with
+
+    - assign(), storing the values of one return in the fields the
+      layout has, ignoring the others, and
+    - describe(), listing those fields as sensor_msgs::PointField.
+
+    Containers are templates on the layout, so other layouts only need
+    a struct of their own with these two functions.
+
+    The layouts live in their own namespace: velodyne_pcl already names
+    the PCL point types, which are aligned differently.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_POINT_TYPES_H
+#define VELODYNE_POINTCLOUD_POINT_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sensor_msgs/PointField.h>
+
+namespace velodyne_pointcloud
+{
+namespace layout
+{
+/** sensor_msgs::PointField datatype of a field type */
+template <typename T>
+struct PointFieldType;
+
+template <>
+struct PointFieldType<float>
+{
+  static const uint8_t value = sensor_msgs::PointField::FLOAT32;
+};
+
+template <>
+struct PointFieldType<uint16_t>
+{
+  static const uint8_t value = sensor_msgs::PointField::UINT16;
+};
+
+/** append a field of type T at offset to a point layout */
+template <typename T>
+inline void addField(std::vector<sensor_msgs::PointField>& fields, const std::string& name, size_t offset)
+{
+  sensor_msgs::PointField field;
+  field.name = name;
+  field.offset = offset;
+  field.datatype = PointFieldType<T>::value;
+  field.count = 1;
+  fields.push_back(field);
+}
+
+#pragma pack(push, 1)
+
+/** Euclidean coordinates only */
+struct PointXYZ
+{
+  float x;
+  float y;
+  float z;
+
+  inline void assign(float x, float y, float z, float /*intensity*/, uint16_t /*ring*/, uint16_t /*azimuth*/,
+                     float /*time*/)
+  {
+    this->x = x;
+    this->y = y;
+    this->z = z;
+  }
+
+  static void describe(std::vector<sensor_msgs::PointField>& fields)
+  {
+    addField<float>(fields, "x", offsetof(PointXYZ, x));
+    addField<float>(fields, "y", offsetof(PointXYZ, y));
+    addField<float>(fields, "z", offsetof(PointXYZ, z));
+  }
+};
+
+/** coordinates and intensity */
+struct PointXYZI
+{
+  float x;
+  float y;
+  float z;
+  float intensity;
+
+  inline void assign(float x, float y, float z, float intensity, uint16_t /*ring*/, uint16_t /*azimuth*/,
+                     float /*time*/)
+  {
+    this->x = x;
+    this->y = y;
+    this->z = z;
+    this->intensity = intensity;
+  }
+
+  static void describe(std::vector<sensor_msgs::PointField>& fields)
+  {
+    addField<float>(fields, "x", offsetof(PointXYZI, x));
+    addField<float>(fields, "y", offsetof(PointXYZI, y));
+    addField<float>(fields, "z", offsetof(PointXYZI, z));
+    addField<float>(fields, "intensity", offsetof(PointXYZI, intensity));
+  }
+};
+
+/** coordinates, intensity, laser ring and firing time, the default */
+struct PointXYZIRT
+{
+  float x;
+  float y;
+  float z;
+  float intensity;
+  uint16_t ring;
+  float time;
+
+  inline void assign(float x, float y, float z, float intensity, uint16_t ring, uint16_t /*azimuth*/, float time)
+  {
+    this->x = x;
+    this->y = y;
+    this->z = z;
+    this->intensity = intensity;
+    this->ring = ring;
+    this->time = time;
+  }
+
+  static void describe(std::vector<sensor_msgs::PointField>& fields)
+  {
+    addField<float>(fields, "x", offsetof(PointXYZIRT, x));
+    addField<float>(fields, "y", offsetof(PointXYZIRT, y));
+    addField<float>(fields, "z", offsetof(PointXYZIRT, z));
+    addField<float>(fields, "intensity", offsetof(PointXYZIRT, intensity));
+    addField<uint16_t>(fields, "ring", offsetof(PointXYZIRT, ring));
+    addField<float>(fields, "time", offsetof(PointXYZIRT, time));
+  }
+};
+
+/** PointXYZIRT with the rotation of the firing, in hundredths of degrees */
+struct PointXYZIRTA
+{
+  float x;
+  float y;
+  float z;
+  float intensity;
+  uint16_t ring;
+  float time;
+  uint16_t azimuth;
+
+  inline void assign(float x, float y, float z, float intensity, uint16_t ring, uint16_t azimuth, float time)
+  {
+    this->x = x;
+    this->y = y;
+    this->z = z;
+    this->intensity = intensity;
+    this->ring = ring;
+    this->time = time;
+    this->azimuth = azimuth;
+  }
+
+  static void describe(std::vector<sensor_msgs::PointField>& fields)
+  {
+    addField<float>(fields, "x", offsetof(PointXYZIRTA, x));
+    addField<float>(fields, "y", offsetof(PointXYZIRTA, y));
+    addField<float>(fields, "z", offsetof(PointXYZIRTA, z));
+    addField<float>(fields, "intensity", offsetof(PointXYZIRTA, intensity));
+    addField<uint16_t>(fields, "ring", offsetof(PointXYZIRTA, ring));
+    addField<float>(fields, "time", offsetof(PointXYZIRTA, time));
+    addField<uint16_t>(fields, "azimuth", offsetof(PointXYZIRTA, azimuth));
+  }
+};
+
+#pragma pack(pop)
+}  // namespace layout
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_POINT_TYPES_H
@@ -34,26 +34,86 @@
 #define VELODYNE_POINTCLOUD_POINTCLOUDXYZIRT_H
 
 #include <velodyne_pointcloud/datacontainerbase.h>
+#include <velodyne_pointcloud/point_types.h>
+#include <cmath>
+#include <cstring>
 #include <string>
+#include <vector>
 
 namespace velodyne_pointcloud
 {
-class PointcloudXYZIRT : public velodyne_rawdata::DataContainerBase
+/** \brief Dense cloud of the returns in range, one row.
+ *
+ *  @param Point layout of the points, see point_types.h
+ */
+template <typename Point>
+class DensePointcloud : public velodyne_rawdata::DataContainerBase
 {
 public:
-  PointcloudXYZIRT(const double max_range, const double min_range, const std::string& target_frame,
-                   const std::string& fixed_frame, const unsigned int scans_per_block);
+  DensePointcloud(const double max_range, const double min_range, const std::string& target_frame,
+                  const std::string& fixed_frame, const unsigned int scans_per_block)
+    : DataContainerBase(max_range, min_range, target_frame, fixed_frame, 0, 1, true, scans_per_block, fields(),
+                        sizeof(Point))
+  {
+  }
 
-  virtual void newLine();
-
-  virtual void setup(const velodyne_msgs::VelodyneScan::ConstPtr& scan_msg);
+  virtual void newLine()
+  {
+  }
 
   virtual void addPoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
-                        const float distance, const float intensity, const float time);
+                        const float distance, const float intensity, const float time)
+  {
+    if (!pointInRange(distance))
+    {
+      return;
+    }
+    transformPoint(x, y, z, time);
+    writePoint(x, y, z, ring, azimuth, intensity, time);
+  }
+
+  virtual void addPoints(const velodyne_rawdata::PointBatch& batch)
+  {
+    alignas(32) float x[velodyne_rawdata::PointBatch::CAPACITY];
+    alignas(32) float y[velodyne_rawdata::PointBatch::CAPACITY];
+    alignas(32) float z[velodyne_rawdata::PointBatch::CAPACITY];
+    transformBatch(batch, x, y, z);
+
+    for (int i = 0; i < batch.size; ++i)
+    {
+      if (std::isnan(batch.distance[i]))
+      {
+        continue;
+      }
+      writePoint(x[i], y[i], z[i], batch.ring[i], batch.azimuth[i], batch.intensity[i], batch.time[i]);
+    }
+  }
 
-  sensor_msgs::PointCloud2Iterator<float> iter_x, iter_y, iter_z, iter_intensity, iter_time;
-  sensor_msgs::PointCloud2Iterator<uint16_t> iter_ring;
+private:
+  static std::vector<sensor_msgs::PointField> fields()
+  {
+    std::vector<sensor_msgs::PointField> fields;
+    Point::describe(fields);
+    return fields;
+  }
+
+  inline void writePoint(float x, float y, float z, const uint16_t ring, const uint16_t azimuth,
+                         const float intensity, const float time)
+  {
+    Point point;
+    point.assign(x, y, z, intensity, ring, azimuth, time);
+    std::memcpy(points_ + cloud.width * sizeof(Point), &point, sizeof(Point));
+    ++cloud.width;
+  }
 };
+
+typedef DensePointcloud<layout::PointXYZIRT> PointcloudXYZIRT;
+
+// the layouts shipped are compiled into the data_containers library
+extern template class DensePointcloud<layout::PointXYZ>;
+extern template class DensePointcloud<layout::PointXYZI>;
+extern template class DensePointcloud<layout::PointXYZIRT>;
+extern template class DensePointcloud<layout::PointXYZIRTA>;
 }  // namespace velodyne_pointcloud
 
 #endif  // VELODYNE_POINTCLOUD_POINTCLOUDXYZIRT_H
@@ -0,0 +1,137 @@
+/** @file
+
+    Sensor pose during a revolution, interpolated between a few
+    transform lookups, for ego motion compensation.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_POSE_INTERPOLATOR_H
+#define VELODYNE_POINTCLOUD_POSE_INTERPOLATOR_H
+
+#include <math.h>
+#include <stddef.h>
+#include <vector>
+#include <eigen3/Eigen/Geometry>
+#include <eigen3/Eigen/StdVector>
+
+namespace velodyne_rawdata
+{
+/** \brief Sensor poses sampled during a revolution.
+ *
+ *  The transform to the fixed frame is only looked up a few times per
+ *  revolution.  The pose of every firing in between is interpolated:
+ *  spherical linear interpolation of the rotation, linear interpolation
+ *  of the translation.  Firings before the first or after the last
+ *  sample get the pose of the nearest sample.
+ *
+ *  Consecutive returns mostly share their firing time, so the pose of
+ *  the last time asked for is kept.
+ */
+class PoseInterpolator
+{
+public:
+  PoseInterpolator() : segment_(0), cached_time_(nanf(""))
+  {
+    cached_pose_.setIdentity();
+  }
+
+  void clear()
+  {
+    samples_.clear();
+    segment_ = 0;
+    cached_time_ = nanf("");
+  }
+
+  /** \brief Add a sample.
+   *
+   *  @param time relative to the scan time stamp [s], samples not
+   *         later than the previous one are ignored
+   */
+  void addSample(float time, const Eigen::Quaternionf& rotation, const Eigen::Vector3f& translation)
+  {
+    if (!samples_.empty() && time <= samples_.back().time)
+    {
+      return;
+    }
+    Sample sample;
+    sample.time = time;
+    sample.rotation = rotation.normalized();
+    sample.translation = translation;
+    samples_.push_back(sample);
+    cached_time_ = nanf("");
+  }
+
+  bool empty() const
+  {
+    return samples_.empty();
+  }
+
+  size_t size() const
+  {
+    return samples_.size();
+  }
+
+  /** \brief Pose at a time relative to the scan time stamp [s].
+   *
+   *  @returns identity if there are no samples
+   */
+  const Eigen::Affine3f& poseAt(float time)
+  {
+    if (time == cached_time_)
+    {
+      return cached_pose_;
+    }
+    cached_time_ = time;
+
+    if (samples_.empty())
+    {
+      cached_pose_.setIdentity();
+    }
+    else if (time <= samples_.front().time)
+    {
+      cached_pose_ = Eigen::Translation3f(samples_.front().translation) * samples_.front().rotation;
+    }
+    else if (time >= samples_.back().time)
+    {
+      cached_pose_ = Eigen::Translation3f(samples_.back().translation) * samples_.back().rotation;
+    }
+    else
+    {
+      // times mostly increase, so start at the segment used last
+      while (segment_ > 0 && time < samples_[segment_].time)
+      {
+        --segment_;
+      }
+      while (segment_ + 2 < samples_.size() && time >= samples_[segment_ + 1].time)
+      {
+        ++segment_;
+      }
+      const Sample& a = samples_[segment_];
+      const Sample& b = samples_[segment_ + 1];
+      const float s = (time - a.time) / (b.time - a.time);
+      cached_pose_ = Eigen::Translation3f(a.translation + s * (b.translation - a.translation))
+                     * a.rotation.slerp(s, b.rotation);
+    }
+    return cached_pose_;
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+  struct Sample
+  {
+    float time;
+    Eigen::Quaternionf rotation;
+    Eigen::Vector3f translation;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  std::vector<Sample, Eigen::aligned_allocator<Sample> > samples_;
+  size_t segment_;  ///< samples_[segment_] is the last sample before cached_time_
+  float cached_time_;
+  Eigen::Affine3f cached_pose_;
+};
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_POSE_INTERPOLATOR_H
@@ -0,0 +1,149 @@
+/** @file
+
+    Point clouds waiting to be published by a thread of their own, so
+    decoding the next scan does not wait for serialization.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_PUBLISH_QUEUE_H
+#define VELODYNE_POINTCLOUD_PUBLISH_QUEUE_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <boost/make_shared.hpp>
+#include <sensor_msgs/PointCloud2.h>
+
+namespace velodyne_pointcloud
+{
+/** \brief Publishes finished clouds in order, from a thread of its own.
+ *
+ *  push() moves the points of a cloud into a shared message, which is
+ *  published as is: subscribers in the same process, like nodelets in
+ *  the same manager, get that message without a copy.  The cloud gets
+ *  the data buffer of a message published earlier instead, to decode
+ *  the next scan into.
+ *
+ *  Published messages are kept for recycling.  A message is only
+ *  changed again once no subscriber holds it anymore.  Buffers keep
+ *  their capacity, so the clouds of later scans need no allocation.
+ */
+class PublishQueue
+{
+public:
+  typedef std::function<void(const sensor_msgs::PointCloud2ConstPtr&)> Publish;
+
+  /**
+   *  @param queued clouds waiting or being published at most, push() waits
+   *         while there are more, at least 1
+   *  @param pooled published messages kept for recycling
+   */
+  PublishQueue(const Publish& publish, size_t queued, size_t pooled)
+    : publish_(publish)
+    , max_queued_(queued > 0 ? queued : 1)
+    , max_pooled_(pooled)
+    , done_(false)
+    , thread_(&PublishQueue::work, this)
+  {
+  }
+
+  /** Clouds not published yet are dropped. */
+  ~PublishQueue()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    queued_.notify_one();
+    thread_.join();
+  }
+
+  /** \brief Queue a finished cloud for publishing.
+   *
+   *  @param cloud its data is replaced by a recycled buffer, of
+   *         unspecified size, or by an empty one
+   */
+  void push(sensor_msgs::PointCloud2& cloud)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    published_.wait(lock, [this] { return queue_.size() < max_queued_; });
+
+    sensor_msgs::PointCloud2Ptr message = recycle();
+    message->header = cloud.header;
+    message->height = cloud.height;
+    message->width = cloud.width;
+    message->fields = cloud.fields;
+    message->is_bigendian = cloud.is_bigendian;
+    message->point_step = cloud.point_step;
+    message->row_step = cloud.row_step;
+    message->is_dense = cloud.is_dense;
+    message->data.swap(cloud.data);
+    queue_.push_back(message);
+
+    lock.unlock();
+    queued_.notify_one();
+  }
+
+private:
+  /** @returns a message no one else holds, called holding mutex_ */
+  sensor_msgs::PointCloud2Ptr recycle()
+  {
+    for (std::deque<sensor_msgs::PointCloud2Ptr>::iterator it = pool_.begin(); it != pool_.end(); ++it)
+    {
+      // nobody can get hold of a message again once it is unique
+      if (it->unique())
+      {
+        sensor_msgs::PointCloud2Ptr message = *it;
+        pool_.erase(it);
+        return message;
+      }
+    }
+    return boost::make_shared<sensor_msgs::PointCloud2>();
+  }
+
+  void work()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+      queued_.wait(lock, [this] { return done_ || !queue_.empty(); });
+      if (done_)
+      {
+        return;
+      }
+
+      const sensor_msgs::PointCloud2Ptr message = queue_.front();
+      lock.unlock();
+      publish_(message);
+      lock.lock();
+
+      queue_.pop_front();
+      if (max_pooled_ > 0)
+      {
+        if (pool_.size() >= max_pooled_)
+        {
+          pool_.pop_front();
+        }
+        pool_.push_back(message);
+      }
+      published_.notify_one();
+    }
+  }
+
+  Publish publish_;
+  const size_t max_queued_;
+  const size_t max_pooled_;
+  std::mutex mutex_;
+  std::condition_variable queued_;     ///< a cloud was queued, or done_ set
+  std::condition_variable published_;  ///< a cloud left the queue
+  std::deque<sensor_msgs::PointCloud2Ptr> queue_;
+  std::deque<sensor_msgs::PointCloud2Ptr> pool_;  ///< published, oldest first
+  bool done_;
+  std::thread thread_;  ///< last, started once everything else is
+};
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_PUBLISH_QUEUE_H
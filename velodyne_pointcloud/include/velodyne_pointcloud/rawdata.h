@@ -53,6 +53,8 @@
 #include <velodyne_msgs/VelodyneScan.h>
 #include <velodyne_pointcloud/calibration.h>
 #include <velodyne_pointcloud/datacontainerbase.h>
+#include <velodyne_pointcloud/decode_kernels.h>
+#include <velodyne_pointcloud/timing_tables.h>
 
 namespace velodyne_rawdata {
 /**
@@ -119,6 +121,24 @@ namespace velodyne_rawdata {
     static const float VLS128_DISTANCE_RESOLUTION = 0.004f;  // [m]
     static const float VLS128_MODEL_ID = 161;
 
+/** Return mode, in the factory byte of every packet */
+    static const int RETURN_MODE_OFFSET = 1204;
+    static const uint8_t RETURN_MODE_STRONGEST = 0x37;
+    static const uint8_t RETURN_MODE_LAST = 0x38;
+    static const uint8_t RETURN_MODE_DUAL = 0x39;
+
+/** \brief Returns decoded from dual return packets.
+ *
+ *  HDL-32E, VLP-32C and VLP-16 send dual return packets as pairs of
+ *  blocks of the same firings, the last returns first, then the
+ *  strongest ones.
+ */
+    enum DualReturns {
+        DUAL_RETURNS_BOTH,       ///< both blocks, without returns repeated in the strongest one
+        DUAL_RETURNS_LAST,       ///< last returns only
+        DUAL_RETURNS_STRONGEST   ///< strongest returns only
+    };
+
 
 /** \brief Raw Velodyne packet.
  *
@@ -164,6 +184,12 @@ namespace velodyne_rawdata {
 
         void setupAzimuthCache();
 
+        /** build the decode plan and select the fastest block decode kernel for this CPU */
+        void setupDecodePlan();
+
+        /** select the packet decoder for the sensor family of the calibration */
+        void setupDecoder();
+
         bool loadCalibration();
 
         /** \brief Set up for data processing offline.
@@ -172,12 +198,13 @@ namespace velodyne_rawdata {
          * through a communication overhead.
          *
          * @param calibration_file path to the calibration file
+         * @param model sensor model name, used to select the timing tables
          * @param max_range_ cutoff for maximum range
          * @param min_range_ cutoff for minimum range
          * @returns 0 if successful;
          *           errno value for failure
          */
-        int setupOffline(std::string calibration_file, double max_range_, double min_range_);
+        int setupOffline(std::string calibration_file, std::string model, double max_range_, double min_range_);
 
         void unpack(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase &data,
                     const ros::Time &scan_start_time);
@@ -187,8 +214,27 @@ namespace velodyne_rawdata {
 
         void setParameters(double min_range, double max_range, double view_direction, double view_width);
 
+        /** @param returns returns to decode from dual return packets */
+        void setDualReturns(DualReturns returns) {
+            config_.dual_returns = returns;
+        }
+
+        /** \brief Parse a DualReturns name: both, last or strongest.
+         *
+         *  @returns false if the name is unknown
+         */
+        static bool parseDualReturns(const std::string &name, DualReturns &returns);
+
         int scansPerPacket() const;
 
+        /** @returns lines, i.e. DataContainerBase::newLine() calls, per packet at most */
+        int linesPerPacket() const;
+
+        /** @returns true if decoded points carry their firing time */
+        bool hasTimings() const {
+            return timing_offsets != NULL;
+        }
+
     private:
         /** configuration parameters */
         typedef struct {
@@ -198,6 +244,8 @@ namespace velodyne_rawdata {
             double min_range;             ///< minimum range to publish
             int min_angle;                ///< minimum angle to publish
             int max_angle;                ///< maximum angle to publish
+            int view_width;               ///< from min_angle to max_angle [deg/100]
+            DualReturns dual_returns;     ///< returns to decode from dual return packets
 
             double tmp_min_angle;
             double tmp_max_angle;
@@ -212,32 +260,94 @@ namespace velodyne_rawdata {
         float sin_rot_table_[ROTATION_MAX_UNITS];
         float cos_rot_table_[ROTATION_MAX_UNITS];
 
+        // per-laser decode constants, shared by copies, and the block decoder using them
+        boost::shared_ptr<const DecodePlan> plan_;
+        DecodeBlockFn decode_block_;
+
+        // raw distances in the configured range, from the plan and min/max range
+        RangeGate range_gate_;
+
+        /** convert min/max range to raw distances, once the plan is built */
+        void setupRangeGate();
+
         // Caches the azimuth percent offset for the VLS-128 laser firings
         float vls_128_laser_azimuth_cache[16];
 
-        // timing offset lookup table
-        std::vector <std::vector<float>> timing_offsets;
+        // timing offset lookup table, a BlockTimings or, for the VLS-128, a
+        // SequenceTimings row after row; NULL without timings for the model
+        const float *timing_offsets;
+
+        // timing offsets of dual return packets, block pairs fire at once
+        const float *dual_timing_offsets;
 
         /** \brief setup per-point timing offsets
          *
-         *  Runs during initialization and determines the firing time for each point in the scan
+         *  Runs during initialization and selects the firing time table of the model
          *
-         *  NOTE: Does not support all sensors yet (vlp16, vlp32, and hdl32 are currently supported)
+         *  NOTE: Does not support all sensors yet (vlp16, vlp32, hdl32 and vls128 are currently supported)
          */
         bool buildTimings();
 
+        /** \brief Select the returns of block i of a dual return packet.
+         *
+         *  Works on the raw bytes, before anything is decoded.
+         *
+         *  @param merged storage for a block merged from both returns
+         *  @returns the block to decode, NULL to skip it
+         */
+        const raw_block_t *selectReturns(const raw_packet_t *raw, int i, raw_block_t &merged) const;
+
+        /** @returns rotation [deg/100] counted from min_angle on */
+        int viewOffset(int rotation) const {
+            return (rotation - config_.min_angle + ROTATION_MAX_UNITS) % ROTATION_MAX_UNITS;
+        }
+
+        /** @returns true if rotation [deg/100] is in the view window */
+        bool inView(int rotation) const {
+            return viewOffset(rotation) <= config_.view_width;
+        }
+
+        /** @returns true if some of the span [deg/100] from rotation on is in the view window */
+        bool arcInView(int rotation, int span) const {
+            return inView(rotation) || ROTATION_MAX_UNITS - viewOffset(rotation) <= span;
+        }
+
+        /** @returns true if all of the span [deg/100] from rotation on is in the view window */
+        bool arcWithinView(int rotation, int span) const {
+            return config_.view_width >= ROTATION_MAX_UNITS || viewOffset(rotation) + span <= config_.view_width;
+        }
+
+        /** @returns false if all firings of the packet are outside the view window */
+        bool packetInView(const raw_packet_t *raw) const;
+
+        /** decodes a packet, selected by setupDecoder() */
+        typedef void (RawData::*UnpackFn)(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase &data,
+                                          const ros::Time &scan_start_time);
+        UnpackFn unpack_;
+
+        /** \brief Decode a packet of blocks of 32 lasers with the rotation of the block.
+         *
+         *  @param LASERS 64 for the HDL-64E, whose blocks alternate between
+         *         the upper and lower bank, 32 for the HDL-32E and VLP-32C,
+         *         which pair up the blocks of dual return packets
+         *
+         *  The VLP-16 and VLS-128 decoders are not instances of it.  They
+         *  correct the rotation return by return, and the VLS-128 finds
+         *  the bank in the block header, so they share no loop with it.
+         *  Their timing and block layout are compile time constants
+         *  already, and setupDecoder() removes the model checks from the
+         *  packet loop for them too.
+         */
+        template <int LASERS>
+        void unpackBlocks(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase &data,
+                          const ros::Time &scan_start_time);
+
         /** add private function to handle the VLP16 **/
         void unpack_vlp16(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase &data,
                           const ros::Time &scan_start_time);
 
         void unpack_vls128(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase &data,
                            const ros::Time &scan_start_time);
-
-        /** in-line test whether a point is in range */
-        inline bool pointInRange(float range) {
-            return (range >= config_.min_range
-                    && range <= config_.max_range);
-        }
     };
 
 }  // namespace velodyne_rawdata
@@ -0,0 +1,247 @@
+/** @file
+
+    Offline conversion of recorded scans into point clouds on several
+    threads, written back in input order.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_SCAN_CONVERTER_H
+#define VELODYNE_POINTCLOUD_SCAN_CONVERTER_H
+
+#include <stddef.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <sensor_msgs/PointCloud2.h>
+#include <velodyne_msgs/VelodyneScan.h>
+#include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/pointcloudXYZIRT.h>
+
+namespace velodyne_pointcloud
+{
+/** \brief Pool of decoder threads converting whole scans.
+ *
+ *  Each worker owns a private copy of the RawData decoder and its own
+ *  point cloud container, so no state is shared while decoding.
+ *  Scans still queued on destruction are converted first.
+ */
+class ScanConverterPool
+{
+public:
+  ScanConverterPool(const velodyne_rawdata::RawData& prototype, double max_range, double min_range,
+                    unsigned int threads)
+    : prototype_(prototype), max_range_(max_range), min_range_(min_range), done_(false)
+  {
+    for (unsigned int i = 0; i < threads; ++i)
+    {
+      workers_.push_back(std::thread(&ScanConverterPool::run, this));
+    }
+  }
+
+  ~ScanConverterPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    ready_.notify_all();
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+      workers_[i].join();
+    }
+  }
+
+  /** queue a scan for conversion, the future yields the finished cloud */
+  std::future<sensor_msgs::PointCloud2Ptr> submit(const velodyne_msgs::VelodyneScan::ConstPtr& scan)
+  {
+    Job job;
+    job.scan = scan;
+    std::future<sensor_msgs::PointCloud2Ptr> result = job.cloud.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(std::move(job));
+    }
+    ready_.notify_one();
+    return result;
+  }
+
+private:
+  struct Job
+  {
+    velodyne_msgs::VelodyneScan::ConstPtr scan;
+    std::promise<sensor_msgs::PointCloud2Ptr> cloud;
+  };
+
+  void run()
+  {
+    velodyne_rawdata::RawData data(prototype_);
+    PointcloudXYZIRT container(max_range_, min_range_, "", "", data.scansPerPacket());
+    while (true)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return done_ || !jobs_.empty(); });
+        if (jobs_.empty())
+        {
+          return;
+        }
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+
+      try
+      {
+        container.setup(job.scan);
+        for (size_t i = 0; i < job.scan->packets.size(); ++i)
+        {
+          data.unpack(job.scan->packets[i], container, job.scan->header.stamp);
+        }
+        job.cloud.set_value(boost::make_shared<sensor_msgs::PointCloud2>(container.finishCloud()));
+      }
+      catch (...)
+      {
+        job.cloud.set_exception(std::current_exception());
+      }
+    }
+  }
+
+  const velodyne_rawdata::RawData& prototype_;
+  double max_range_;
+  double min_range_;
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<Job> jobs_;
+  bool done_;
+  std::vector<std::thread> workers_;
+};
+
+/** \brief Writes converted scans and copied messages in input order.
+ *
+ *  Only scans count against the bound on outstanding conversions.
+ *  Other messages queue behind the scans before them, so a busy topic
+ *  recorded between two scans, like an IMU, does not keep the pool
+ *  from converting several scans at once.
+ *
+ *  @param Message copied messages, written unchanged
+ */
+template <typename Message>
+class OrderedConversion
+{
+public:
+  typedef std::function<void(const ros::Time&, const sensor_msgs::PointCloud2Ptr&)> WriteCloud;
+  typedef std::function<void(const Message&)> WriteMessage;
+
+  /** @param max_scans scans being converted at most, at least 1 */
+  OrderedConversion(ScanConverterPool& pool, size_t max_scans, const WriteCloud& write_cloud,
+                    const WriteMessage& write_message)
+    : pool_(pool)
+    , max_scans_(max_scans > 0 ? max_scans : 1)
+    , write_cloud_(write_cloud)
+    , write_message_(write_message)
+    , scans_(0)
+    , written_(0)
+  {
+  }
+
+  /** \brief Convert the next input, a scan.
+   *
+   *  Waits for earlier scans while max_scans are outstanding.
+   *
+   *  @throws whatever converting or writing earlier input threw
+   */
+  void addScan(const velodyne_msgs::VelodyneScan::ConstPtr& scan)
+  {
+    while (scans_ >= max_scans_)
+    {
+      writeFront();
+    }
+    Pending pending;
+    pending.stamp = scan->header.stamp;
+    pending.cloud = pool_.submit(scan);
+    queue_.push_back(std::move(pending));
+    ++scans_;
+    writeReady();
+  }
+
+  /** \brief Copy the next input, anything but a scan.
+   *
+   *  @throws whatever converting or writing earlier input threw
+   */
+  void addMessage(const Message& message)
+  {
+    Pending pending;
+    pending.message = boost::make_shared<Message>(message);
+    queue_.push_back(std::move(pending));
+    writeReady();
+  }
+
+  /** write all remaining input, waiting for its conversion */
+  void flush()
+  {
+    while (!queue_.empty())
+    {
+      writeFront();
+    }
+  }
+
+  /** @returns input written so far, the index of a failed input */
+  size_t written() const
+  {
+    return written_;
+  }
+
+private:
+  struct Pending
+  {
+    ros::Time stamp;
+    std::future<sensor_msgs::PointCloud2Ptr> cloud;  ///< valid for scans
+    boost::shared_ptr<Message> message;              ///< set for copied messages
+  };
+
+  /** write the first input, waiting for its conversion */
+  void writeFront()
+  {
+    Pending& front = queue_.front();
+    if (front.message)
+    {
+      write_message_(*front.message);
+    }
+    else
+    {
+      write_cloud_(front.stamp, front.cloud.get());
+      --scans_;
+    }
+    queue_.pop_front();
+    ++written_;
+  }
+
+  /** write input from the front on, as long as it needs no waiting */
+  void writeReady()
+  {
+    while (!queue_.empty() &&
+           (queue_.front().message ||
+            queue_.front().cloud.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+    {
+      writeFront();
+    }
+  }
+
+  ScanConverterPool& pool_;
+  const size_t max_scans_;
+  WriteCloud write_cloud_;
+  WriteMessage write_message_;
+  std::deque<Pending> queue_;
+  size_t scans_;  ///< scans in queue_
+  size_t written_;
+};
+}  // namespace velodyne_pointcloud
+
+#endif  // VELODYNE_POINTCLOUD_SCAN_CONVERTER_H
@@ -0,0 +1,107 @@
+/** @file
+
+    Firing times of the returns of a packet, relative to the packet
+    time, as tables generated at compile time.
+
+    The formulas are those of the Velodyne user manuals.  Each table is
+    a contiguous, aligned array with a row per block of the packet, or
+    per firing sequence for the VLS-128, so a decoder adds the packet
+    time to a whole row at once.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_TIMING_TABLES_H
+#define VELODYNE_POINTCLOUD_TIMING_TABLES_H
+
+#include <stddef.h>
+
+namespace velodyne_rawdata
+{
+/** \brief Firing times of ROWS x COLS returns [s], row major. */
+template <int ROWS, int COLS>
+struct alignas(64) TimingTable
+{
+  static const int rows = ROWS;
+  static const int cols = COLS;
+
+  float offset[ROWS * COLS];
+
+  const float* row(int r) const
+  {
+    return offset + r * COLS;
+  }
+};
+
+namespace timing
+{
+/** dataBlockIndex of the VLP-16, which fires twice per block */
+constexpr int vlp16Firing(bool dual, int block, int point)
+{
+  return (dual ? block - block % 2 : block * 2) + point / 16;
+}
+
+/** VLP-16, two firings of 16 lasers per block */
+constexpr float vlp16(bool dual, int block, int point)
+{
+  return 55.296e-6 * vlp16Firing(dual, block, point) + 2.304e-6 * (point % 16);
+}
+
+/** VLP-32C, lasers fire in pairs, blocks of dual returns in pairs too */
+constexpr float vlp32c(bool dual, int block, int point)
+{
+  return 55.296e-6 * (dual ? block / 2 : block) + 2.304e-6 * (point / 2);
+}
+
+/** HDL-32E, like the VLP-32C with a faster firing cycle */
+constexpr float hdl32e(bool dual, int block, int point)
+{
+  return 46.080e-6 * (dual ? block / 2 : block) + 1.152e-6 * (point / 2);
+}
+
+/** VLS-128, by firing sequence and group, +1 for the maintenance time
+ *  after group 8; aligned with the fourth group of a sequence */
+constexpr float vls128(bool /*dual*/, int sequence, int group)
+{
+  return 53.3e-6 * sequence + 2.665e-6 * group - 8.7e-6;
+}
+
+template <size_t... I>
+struct Indices
+{
+};
+
+template <size_t N, size_t... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...>
+{
+};
+
+template <size_t... I>
+struct MakeIndices<0, I...>
+{
+  typedef Indices<I...> type;
+};
+
+typedef float (*Formula)(bool dual, int row, int col);
+
+template <int ROWS, int COLS, size_t... I>
+constexpr TimingTable<ROWS, COLS> generate(Formula formula, bool dual, Indices<I...>)
+{
+  return TimingTable<ROWS, COLS>{ { formula(dual, I / COLS, I % COLS)... } };
+}
+}  // namespace timing
+
+/** @returns the table of formula, evaluated by the compiler */
+template <int ROWS, int COLS>
+constexpr TimingTable<ROWS, COLS> makeTimingTable(timing::Formula formula, bool dual)
+{
+  return timing::generate<ROWS, COLS>(formula, dual, typename timing::MakeIndices<ROWS * COLS>::type());
+}
+
+/** a row per block of 32 returns */
+typedef TimingTable<12, 32> BlockTimings;
+
+/** a row per VLS-128 firing sequence of 16 groups, +1 */
+typedef TimingTable<3, 17> SequenceTimings;
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_TIMING_TABLES_H
@@ -40,7 +40,9 @@
 #ifndef VELODYNE_POINTCLOUD_TRANSFORM_H
 #define VELODYNE_POINTCLOUD_TRANSFORM_H
 
+#include <memory>
 #include <string>
+#include <vector>
 #include <ros/ros.h>
 #include "tf/message_filter.h"
 #include "message_filters/subscriber.h"
@@ -50,6 +52,8 @@
 
 #include <velodyne_pointcloud/rawdata.h>
 #include <velodyne_pointcloud/pointcloudXYZIRT.h>
+#include <velodyne_pointcloud/publish_queue.h>
+#include <velodyne_pointcloud/worker_pool.h>
 
 #include <dynamic_reconfigure/server.h>
 #include <velodyne_pointcloud/TransformNodeConfig.h>
@@ -71,10 +75,15 @@ public:
 
 private:
   void processScan(const velodyne_msgs::VelodyneScan::ConstPtr& scanMsg);
+  void decodePackets(const velodyne_msgs::VelodyneScan& scan, size_t part, size_t parts);
+  boost::shared_ptr<velodyne_rawdata::DataContainerBase> createContainer();
 
   // Pointer to dynamic reconfigure service srv_
   boost::shared_ptr<dynamic_reconfigure::Server<velodyne_pointcloud::TransformNodeConfig>> srv_;
   void reconfigure_callback(velodyne_pointcloud::TransformNodeConfig& config, uint32_t level);
+  void applyConfig(const velodyne_pointcloud::TransformNodeConfig& config);
+  std::shared_ptr<const TransformNodeCfg> pending_config_;  ///< set by reconfigure_callback(), if not applied yet
+  void cacheDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
 
   boost::shared_ptr<velodyne_rawdata::RawData> data_;
   ros::Subscriber velodyne_scan_;
@@ -89,6 +98,9 @@ private:
     double max_range;          ///< maximum range to publish
     double min_range;          ///< minimum range to publish
     uint16_t num_lasers;       ///< number of lasers
+    int motion_samples;        ///< transform lookups per scan for ego motion compensation
+    double tf_cache_resolution;  ///< time buckets of cached dynamic transforms [s]
+    int decode_threads;        ///< threads decoding the packets of a scan
   }
   Config;
   Config config_;
@@ -97,12 +109,18 @@ private:
 
   boost::shared_ptr<velodyne_rawdata::DataContainerBase> container_ptr;
 
+  /// containers decoding the later parts of a scan into the cloud of container_ptr
+  std::vector<boost::shared_ptr<velodyne_rawdata::DataContainerBase>> region_containers_;
+  boost::shared_ptr<velodyne_rawdata::WorkerPool> decode_pool_;
+
   // diagnostics updater
   diagnostic_updater::Updater diagnostics_;
   double diag_min_freq_;
   double diag_max_freq_;
   boost::shared_ptr<diagnostic_updater::TopicDiagnostic> diag_topic_;
-  boost::mutex reconfigure_mtx_;
+
+  // last, so it stops publishing before anything else goes
+  boost::shared_ptr<PublishQueue> publish_queue_;
 };
 }  // namespace velodyne_pointcloud
 
@@ -0,0 +1,232 @@
+/** @file
+
+    Cache of transforms looked up from tf, keyed on the frame pair and
+    the time.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_TRANSFORM_CACHE_H
+#define VELODYNE_POINTCLOUD_TRANSFORM_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <ros/time.h>
+#include <eigen3/Eigen/Geometry>
+#include <eigen3/Eigen/StdVector>
+
+namespace velodyne_rawdata
+{
+/** \brief Transforms between pairs of frames, static or per time bucket.
+ *
+ *  Static transforms, published once on /tf_static, are the same at
+ *  any time.  They are kept for STATIC_CHECK_PERIOD seconds of
+ *  requested time, then checked again, in case they were republished.
+ *
+ *  Other transforms are kept for the few most recent time buckets of
+ *  each frame pair.  With a resolution of 0, only lookups at exactly
+ *  the same time hit.
+ *
+ *  The cache does not look anything up itself.  Callers try find()
+ *  first, and report what they looked up on a miss.
+ */
+class TransformCache
+{
+public:
+  static constexpr double STATIC_CHECK_PERIOD = 1.0;  ///< [s]
+  static const size_t BUCKETS = 8;                    ///< per frame pair
+
+  /** @param resolution duration of the time buckets of dynamic transforms [s] */
+  explicit TransformCache(double resolution = 0.0) : hits_(0), misses_(0)
+  {
+    setResolution(resolution);
+  }
+
+  void setResolution(double resolution)
+  {
+    resolution_ns_ = resolution > 0.0 ? static_cast<int64_t>(llround(resolution * 1e9)) : 0;
+    clear();
+  }
+
+  void clear()
+  {
+    pairs_.clear();
+  }
+
+  /** \brief Cached transform from source to target frame.
+   *
+   *  @returns true on a hit, counted in hits() or misses()
+   */
+  bool find(const std::string& target, const std::string& source, const ros::Time& time, Eigen::Affine3f& matrix)
+  {
+    const Pair* pair = findPair(target, source);
+    if (pair != NULL)
+    {
+      if (pair->is_static && !staticCheckDue(*pair, time))
+      {
+        matrix = pair->static_matrix;
+        ++hits_;
+        return true;
+      }
+      const int64_t key = bucket(time);
+      for (size_t i = 0; i < pair->buckets.size(); ++i)
+      {
+        if (pair->buckets[i].key == key)
+        {
+          matrix = pair->buckets[i].matrix;
+          ++hits_;
+          return true;
+        }
+      }
+    }
+    ++misses_;
+    return false;
+  }
+
+  /** @returns true if the caller should look up whether the pair is static */
+  bool staticCheckDue(const std::string& target, const std::string& source, const ros::Time& time) const
+  {
+    const Pair* pair = findPair(target, source);
+    return pair == NULL || staticCheckDue(*pair, time);
+  }
+
+  /** \brief Record whether the pair is static, checked at a time.
+   *
+   *  @param matrix the transform, if static
+   */
+  void setStatic(const std::string& target, const std::string& source, const ros::Time& time, bool is_static,
+                 const Eigen::Affine3f& matrix)
+  {
+    Pair& pair = findOrAddPair(target, source);
+    pair.is_static = is_static;
+    pair.checked = time;
+    pair.static_matrix = matrix;
+    if (is_static)
+    {
+      pair.buckets.clear();
+    }
+  }
+
+  /** \brief Store a dynamic transform, replacing the oldest bucket of its pair. */
+  void insert(const std::string& target, const std::string& source, const ros::Time& time,
+              const Eigen::Affine3f& matrix)
+  {
+    Pair& pair = findOrAddPair(target, source);
+    Bucket entry;
+    entry.key = bucket(time);
+    entry.matrix = matrix;
+    if (pair.buckets.size() < BUCKETS)
+    {
+      pair.buckets.push_back(entry);
+    }
+    else
+    {
+      pair.buckets[pair.next] = entry;
+      pair.next = (pair.next + 1) % BUCKETS;
+    }
+  }
+
+  /** @returns true if the transform from source to target frame is known to be static */
+  bool isStatic(const std::string& target, const std::string& source) const
+  {
+    const Pair* pair = findPair(target, source);
+    return pair != NULL && pair->is_static;
+  }
+
+  /** @returns number of frame pairs known to be static */
+  size_t staticPairs() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < pairs_.size(); ++i)
+    {
+      if (pairs_[i].is_static)
+      {
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  uint64_t hits() const
+  {
+    return hits_;
+  }
+
+  uint64_t misses() const
+  {
+    return misses_;
+  }
+
+private:
+  struct Bucket
+  {
+    int64_t key;
+    Eigen::Affine3f matrix;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  struct Pair
+  {
+    Pair() : is_static(false), next(0)
+    {
+    }
+
+    std::string target;
+    std::string source;
+    bool is_static;
+    ros::Time checked;  ///< when is_static was last looked up
+    Eigen::Affine3f static_matrix;
+    std::vector<Bucket, Eigen::aligned_allocator<Bucket> > buckets;
+    size_t next;  ///< bucket replaced next
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  int64_t bucket(const ros::Time& time) const
+  {
+    const int64_t ns = static_cast<int64_t>(time.toNSec());
+    return resolution_ns_ > 0 ? ns / resolution_ns_ : ns;
+  }
+
+  bool staticCheckDue(const Pair& pair, const ros::Time& time) const
+  {
+    // time may also run backwards, when a bag file is replayed in a loop
+    return pair.checked.isZero() || fabs((time - pair.checked).toSec()) > STATIC_CHECK_PERIOD;
+  }
+
+  const Pair* findPair(const std::string& target, const std::string& source) const
+  {
+    for (size_t i = 0; i < pairs_.size(); ++i)
+    {
+      if (pairs_[i].target == target && pairs_[i].source == source)
+      {
+        return &pairs_[i];
+      }
+    }
+    return NULL;
+  }
+
+  Pair& findOrAddPair(const std::string& target, const std::string& source)
+  {
+    const Pair* pair = findPair(target, source);
+    if (pair != NULL)
+    {
+      return const_cast<Pair&>(*pair);
+    }
+    pairs_.push_back(Pair());
+    pairs_.back().target = target;
+    pairs_.back().source = source;
+    return pairs_.back();
+  }
+
+  int64_t resolution_ns_;  ///< 0 for exact times
+  std::vector<Pair, Eigen::aligned_allocator<Pair> > pairs_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_TRANSFORM_CACHE_H
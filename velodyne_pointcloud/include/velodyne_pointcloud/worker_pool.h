@@ -0,0 +1,131 @@
+/** @file
+
+    Fork-join pool of threads, running the parts of one job at a time.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_WORKER_POOL_H
+#define VELODYNE_POINTCLOUD_WORKER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace velodyne_rawdata
+{
+/** \brief Threads running the parts of a job, together with the caller.
+ *
+ *  run() hands part i of a job to thread i % size(), the calling
+ *  thread being thread 0, and returns once all parts are done.  The
+ *  threads wait for the next job in between, so a job costs two
+ *  condition variable round trips, not thread creation.
+ */
+class WorkerPool
+{
+public:
+  /** @param threads total number of threads, including the caller of run() */
+  explicit WorkerPool(unsigned int threads) : size_(threads > 0 ? threads : 1), job_(0), parts_(0), running_(0),
+                                              done_(false)
+  {
+    for (unsigned int i = 1; i < size_; ++i)
+    {
+      workers_.push_back(std::thread(&WorkerPool::work, this, i));
+    }
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    start_.notify_all();
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+      workers_[i].join();
+    }
+  }
+
+  /** @returns number of threads, including the caller of run() */
+  unsigned int size() const
+  {
+    return size_;
+  }
+
+  /** \brief Run task(0) to task(parts - 1) and wait for all of them.
+   *
+   *  The parts must not throw.  Only one thread may call run() at a time.
+   */
+  void run(size_t parts, const std::function<void(size_t)>& task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = task;
+      parts_ = parts;
+      running_ = workers_.size();
+      ++job_;
+    }
+    start_.notify_all();
+
+    runParts(0, parts, task);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] { return running_ == 0; });
+    task_ = nullptr;
+  }
+
+private:
+  void runParts(unsigned int thread, size_t parts, const std::function<void(size_t)>& task)
+  {
+    for (size_t i = thread; i < parts; i += size_)
+    {
+      task(i);
+    }
+  }
+
+  void work(unsigned int thread)
+  {
+    uint64_t job = 0;
+    while (true)
+    {
+      size_t parts;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [this, job] { return done_ || job_ != job; });
+        if (done_)
+        {
+          return;
+        }
+        job = job_;
+        parts = parts_;
+      }
+
+      // task_ stays unchanged until every worker is finished
+      runParts(thread, parts, task_);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --running_;
+      }
+      finished_.notify_one();
+    }
+  }
+
+  const unsigned int size_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable finished_;
+  std::function<void(size_t)> task_;
+  uint64_t job_;    ///< incremented for every run()
+  size_t parts_;
+  size_t running_;  ///< workers still running the current job
+  bool done_;
+};
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_WORKER_POOL_H
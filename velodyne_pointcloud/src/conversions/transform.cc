@@ -20,6 +20,7 @@
 
 #include "velodyne_pointcloud/transform.h"
 
+#include <algorithm>
 #include <velodyne_pointcloud/pointcloudXYZIRT.h>
 #include <velodyne_pointcloud/organized_cloudXYZIRT.h>
 
@@ -42,9 +43,28 @@ namespace velodyne_pointcloud
       ROS_ERROR_STREAM("Could not load calibration file!");
     }
 
+    config_.motion_samples = velodyne_rawdata::DataContainerBase::DEFAULT_MOTION_SAMPLES;
+    private_nh.getParam("motion_samples", config_.motion_samples);
+    private_nh.param("tf_cache_resolution", config_.tf_cache_resolution, 0.0);
+    private_nh.param("decode_threads", config_.decode_threads, 1);
+    if (config_.decode_threads < 1)
+    {
+      config_.decode_threads = 1;
+    }
+    else if (config_.decode_threads > 1)
+    {
+      ROS_INFO_STREAM("Decoding scans with " << config_.decode_threads << " threads");
+      decode_pool_.reset(new velodyne_rawdata::WorkerPool(config_.decode_threads));
+    }
+
     // advertise output point cloud (before subscribing to input data)
     output_ = node.advertise<sensor_msgs::PointCloud2>("velodyne_points", 10);
 
+    // while one scan is decoded, the two before it may still wait for or
+    // be in serialization; messages held by nodelets are not recycled
+    publish_queue_.reset(new PublishQueue(
+        [this](const sensor_msgs::PointCloud2ConstPtr &cloud) { output_.publish(cloud); }, 2, 4));
+
     srv_ = boost::make_shared<dynamic_reconfigure::Server<TransformNodeCfg>> (private_nh);
     dynamic_reconfigure::Server<TransformNodeCfg>::CallbackType f;
     f = boost::bind (&Transform::reconfigure_callback, this, _1, _2);
@@ -64,13 +84,23 @@ namespace velodyne_pointcloud
                                                                &diag_max_freq_,
                                                                0.1, 10),
                                           TimeStampStatusParam()));
-
+    diagnostics_.add("Transform cache", this, &Transform::cacheDiagnostics);
   }
 
   void Transform::reconfigure_callback(
       velodyne_pointcloud::TransformNodeConfig &config, uint32_t level)
   {
     ROS_INFO_STREAM("Reconfigure request.");
+
+    // applied by processScan() between two scans, so that decoding
+    // never sees half of it; a newer request replaces a pending one
+    std::shared_ptr<const TransformNodeConfig> pending(new TransformNodeConfig(config));
+    std::atomic_store(&pending_config_, pending);
+  }
+
+  /** @brief Apply a reconfiguration, on the thread decoding scans. */
+  void Transform::applyConfig(const velodyne_pointcloud::TransformNodeConfig &config)
+  {
     data_->setParameters(config.min_range, config.max_range,
                          config.view_direction, config.view_width);
     config_.target_frame = config.target_frame;
@@ -80,28 +110,62 @@ namespace velodyne_pointcloud
     config_.min_range = config.min_range;
     config_.max_range = config.max_range;
 
-    boost::lock_guard<boost::mutex> guard(reconfigure_mtx_);
-
     if(first_rcfg_call || config.organize_cloud != config_.organize_cloud){
       first_rcfg_call = false;
       config_.organize_cloud = config.organize_cloud;
       if(config_.organize_cloud)
       {
         ROS_INFO_STREAM("Using the organized cloud format...");
-        container_ptr = boost::shared_ptr<OrganizedCloudXYZIRT>(
-            new OrganizedCloudXYZIRT(config_.max_range, config_.min_range,
-                                    config_.target_frame, config_.fixed_frame,
-                                    config_.num_lasers, data_->scansPerPacket()));
       }
-      else
+      container_ptr = createContainer();
+      container_ptr->setLinesPerPacket(data_->linesPerPacket());
+      region_containers_.clear();
+      for (int i = 1; i < config_.decode_threads; ++i)
       {
-        container_ptr = boost::shared_ptr<PointcloudXYZIRT>(
-            new PointcloudXYZIRT(config_.max_range, config_.min_range,
-                                config_.target_frame, config_.fixed_frame,
-                                data_->scansPerPacket()));
+        region_containers_.push_back(createContainer());
       }
     }
     container_ptr->configure(config_.max_range, config_.min_range, config_.fixed_frame, config_.target_frame);
+    container_ptr->setMotionSamples(config_.motion_samples);
+    container_ptr->setTransformCacheResolution(config_.tf_cache_resolution);
+  }
+
+  /** @brief Container for the configured cloud format. */
+  boost::shared_ptr<velodyne_rawdata::DataContainerBase> Transform::createContainer()
+  {
+    if(config_.organize_cloud)
+    {
+      return boost::shared_ptr<OrganizedCloudXYZIRT>(
+          new OrganizedCloudXYZIRT(config_.max_range, config_.min_range,
+                                  config_.target_frame, config_.fixed_frame,
+                                  config_.num_lasers, data_->scansPerPacket()));
+    }
+    return boost::shared_ptr<PointcloudXYZIRT>(
+        new PointcloudXYZIRT(config_.max_range, config_.min_range,
+                            config_.target_frame, config_.fixed_frame,
+                            data_->scansPerPacket()));
+  }
+
+  /** @brief Decode one of parts contiguous runs of the packets of a scan.
+   *
+   *  Part 0 goes to container_ptr, the others to the region containers,
+   *  which write into the same cloud.  Only reads data_, so the parts
+   *  can run in parallel.
+   */
+  void Transform::decodePackets(const velodyne_msgs::VelodyneScan &scan, size_t part, size_t parts)
+  {
+    velodyne_rawdata::DataContainerBase &container =
+        part == 0 ? *container_ptr : *region_containers_[part - 1];
+    const bool point_times = data_->hasTimings();
+    const size_t end = (part + 1) * scan.packets.size() / parts;
+    for (size_t i = part * scan.packets.size() / parts; i < end; ++i)
+    {
+      if(!point_times)
+      {
+        container.setPacketTime((scan.packets[i].stamp - scan.header.stamp).toSec());
+      }
+      data_->unpack(scan.packets[i], container, scan.header.stamp);
+    }
   }
 
   /** @brief Callback for raw scan messages.
@@ -112,11 +176,16 @@ namespace velodyne_pointcloud
   void
     Transform::processScan(const velodyne_msgs::VelodyneScan::ConstPtr &scanMsg)
   {
+    std::shared_ptr<const TransformNodeConfig> pending =
+        std::atomic_exchange(&pending_config_, std::shared_ptr<const TransformNodeConfig>());
+    if (pending)
+    {
+      applyConfig(*pending);
+    }
+
     if (output_.getNumSubscribers() == 0)      // no one listening?
       return;                                     // avoid much work
 
-    boost::lock_guard<boost::mutex> guard(reconfigure_mtx_);
-
     // allocate a point cloud with same time and frame ID as raw data
     container_ptr->setup(scanMsg);
 
@@ -127,23 +196,59 @@ namespace velodyne_pointcloud
       return;
     }
 
-    // process each packet provided by the driver
-    for (size_t i = 0; i < scanMsg->packets.size(); ++i)
+    // a few poses during the rotation, interpolated for every firing to
+    // account for ego motion
+    if(!container_ptr->computeMotionToFixed(*scanMsg))
     {
-      // calculate individual transform for each packet to account for ego
-      // during one rotation of the velodyne sensor
-      if(!container_ptr->computeTransformToFixed(scanMsg->packets[i].stamp))
+      // fixed frame not available
+      return;
+    }
+
+    // process each packet provided by the driver, in parallel parts
+    // written to the places of the cloud reserved for their packets
+    const size_t parts = std::min(region_containers_.size() + 1, scanMsg->packets.size());
+    if (parts > 1)
+    {
+      for (size_t part = 1; part < parts; ++part)
+      {
+        region_containers_[part - 1]->beginRegion(*container_ptr, part * scanMsg->packets.size() / parts);
+      }
+      const velodyne_msgs::VelodyneScan &scan = *scanMsg;
+      decode_pool_->run(parts, [this, &scan, parts](size_t part) { decodePackets(scan, part, parts); });
+      for (size_t part = 1; part < parts; ++part)
       {
-        // fixed frame not available
-        return;
+        container_ptr->appendRegion(*region_containers_[part - 1]);
       }
-      data_->unpack(scanMsg->packets[i], *container_ptr, scanMsg->header.stamp);
     }
-    // publish the accumulated cloud message
-    output_.publish(container_ptr->finishCloud());
+    else
+    {
+      decodePackets(*scanMsg, 0, 1);
+    }
+    // publish the accumulated cloud message from the publishing thread,
+    // without a copy, the container continues with a recycled buffer
+    container_ptr->finishCloud();
+    publish_queue_->push(container_ptr->cloud);
 
     diag_topic_->tick(scanMsg->header.stamp);
     diagnostics_.update();
   }
 
+  /** @brief Report how many transform lookups were avoided.
+   *
+   *  Runs within processScan(), like applyConfig().
+   */
+  void Transform::cacheDiagnostics(diagnostic_updater::DiagnosticStatusWrapper &status)
+  {
+    if (!container_ptr)
+    {
+      status.summary(diagnostic_msgs::DiagnosticStatus::OK, "not configured");
+      return;
+    }
+    const velodyne_rawdata::TransformCache& cache = container_ptr->transformCache();
+    status.summary(diagnostic_msgs::DiagnosticStatus::OK, "caching transforms");
+    status.add("hits", cache.hits());
+    status.add("misses", cache.misses());
+    status.add("static transforms", cache.staticPairs());
+  }
+
 } // namespace velodyne_pointcloud
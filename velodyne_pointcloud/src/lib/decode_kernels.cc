@@ -0,0 +1,103 @@
+/** @file
+
+    Scalar block decode kernel and run time kernel selection.
+
+    The scalar kernel is the reference implementation of the position
+    and intensity calculation for the 32 returns of a block, the SIMD
+    kernels in decode_kernels_sse41.cc and decode_kernels_avx2.cc must
+    reproduce its results bit for bit.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <velodyne_pointcloud/decode_kernels.h>
+
+namespace velodyne_rawdata
+{
+  void decodeBlockScalar(const DecodePlan& plan, const RangeGate& gate, int bank_origin, const uint8_t* data,
+                         float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch)
+  {
+    for (int j = 0, k = 0; j < KERNEL_BLOCK_SIZE; j++, k += 3)
+    {
+      // returns out of range are decoded like returns without a distance
+      uint16_t raw_distance = data[k] | (data[k + 1] << 8);
+      if (!gate.pass(j + bank_origin, raw_distance))
+      {
+        raw_distance = 0;
+      }
+      decodeReturn(plan, j + bank_origin, raw_distance, data[k + 2],
+                   distance_resolution, cos_rot, sin_rot, batch, j);
+    }
+  }
+
+  bool decodeKernelSupported(DecodeKernel kernel)
+  {
+    switch (kernel)
+    {
+      case DECODE_KERNEL_SCALAR:
+        return true;
+#ifdef VELODYNE_POINTCLOUD_X86_KERNELS
+      case DECODE_KERNEL_SSE41:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+      case DECODE_KERNEL_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+      default:
+        return false;
+    }
+  }
+
+  DecodeKernel bestDecodeKernel()
+  {
+    // allow forcing a narrower kernel, e.g. for comparisons
+    const char* env = getenv("VELODYNE_DECODE_KERNEL");
+    if (env != NULL && strcmp(env, "scalar") == 0)
+    {
+      return DECODE_KERNEL_SCALAR;
+    }
+    if (decodeKernelSupported(DECODE_KERNEL_AVX2) && !(env != NULL && strcmp(env, "sse4.1") == 0))
+    {
+      return DECODE_KERNEL_AVX2;
+    }
+    if (decodeKernelSupported(DECODE_KERNEL_SSE41))
+    {
+      return DECODE_KERNEL_SSE41;
+    }
+    return DECODE_KERNEL_SCALAR;
+  }
+
+  DecodeBlockFn decodeBlockKernel(DecodeKernel kernel)
+  {
+    if (!decodeKernelSupported(kernel))
+    {
+      return decodeBlockScalar;
+    }
+    switch (kernel)
+    {
+#ifdef VELODYNE_POINTCLOUD_X86_KERNELS
+      case DECODE_KERNEL_SSE41:
+        return decodeBlockSse41;
+      case DECODE_KERNEL_AVX2:
+        return decodeBlockAvx2;
+#endif
+      default:
+        return decodeBlockScalar;
+    }
+  }
+
+  const char* decodeKernelName(DecodeKernel kernel)
+  {
+    switch (kernel)
+    {
+      case DECODE_KERNEL_SSE41:
+        return "sse4.1";
+      case DECODE_KERNEL_AVX2:
+        return "avx2";
+      default:
+        return "scalar";
+    }
+  }
+}  // namespace velodyne_rawdata
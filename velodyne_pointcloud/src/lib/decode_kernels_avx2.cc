@@ -0,0 +1,49 @@
+/** @file
+
+    AVX2 block decode kernel, eight lasers per vector.
+
+    This file is compiled with -mavx2 and must only be called after
+    decodeKernelSupported(DECODE_KERNEL_AVX2) returned true.
+
+*/
+
+#include <immintrin.h>
+#include "decode_kernels_impl.h"
+
+namespace velodyne_rawdata
+{
+namespace
+{
+struct Avx2
+{
+  typedef __m256 vf;
+  static const int WIDTH = 8;
+
+  static inline vf set1(float v) { return _mm256_set1_ps(v); }
+  static inline vf load(const float* p) { return _mm256_loadu_ps(p); }
+  static inline vf loadMask(const uint32_t* p)
+  {
+    return _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+  }
+  static inline void store(float* p, vf v) { _mm256_storeu_ps(p, v); }
+  static inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+  static inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+  static inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+  static inline vf div(vf a, vf b) { return _mm256_div_ps(a, b); }
+  static inline vf max(vf a, vf b) { return _mm256_max_ps(a, b); }
+  static inline vf min(vf a, vf b) { return _mm256_min_ps(a, b); }
+  static inline vf abs(vf a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+  static inline vf negate(vf a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+  static inline vf bitAnd(vf a, vf b) { return _mm256_and_ps(a, b); }
+  static inline vf notEqual(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+  static inline vf select(vf mask, vf a, vf b) { return _mm256_blendv_ps(b, a, mask); }
+  static inline bool any(vf mask) { return _mm256_movemask_ps(mask) != 0; }
+};
+}  // namespace
+
+void decodeBlockAvx2(const DecodePlan& plan, const RangeGate& gate, int bank_origin, const uint8_t* data,
+                     float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch)
+{
+  decodeBlockLanes<Avx2>(plan, gate, bank_origin, data, distance_resolution, cos_rot, sin_rot, batch);
+}
+}  // namespace velodyne_rawdata
@@ -0,0 +1,132 @@
+/** @file
+
+    Block decode kernel body shared by the SIMD variants.
+
+    Each variant includes this file from its own translation unit,
+    compiled for its instruction set, and instantiates
+    decodeBlockLanes() with a vector type providing the operations
+    used below.  Every operation mirrors decodeReturn() in the
+    same order, so the results are bit-identical.  Everything here has
+    internal linkage, so code compiled for one instruction set can
+    never be picked up by another translation unit.
+
+*/
+
+#ifndef VELODYNE_POINTCLOUD_DECODE_KERNELS_IMPL_H
+#define VELODYNE_POINTCLOUD_DECODE_KERNELS_IMPL_H
+
+#include <math.h>
+#include <velodyne_pointcloud/decode_kernels.h>
+
+namespace velodyne_rawdata
+{
+namespace
+{
+template <class V>
+inline void decodeBlockLanes(const DecodePlan& p, const RangeGate& gate, int bank_origin, const uint8_t* data,
+                             float distance_resolution, float cos_rot_f, float sin_rot_f, PointBatch& batch)
+{
+  typedef typename V::vf vf;
+
+  // split the interleaved distance/intensity bytes into lanes, returns
+  // out of range become returns without a distance
+  alignas(32) float raw_distance[KERNEL_BLOCK_SIZE];
+  alignas(32) float raw_intensity[KERNEL_BLOCK_SIZE];
+  int in_range = 0;
+  for (int j = 0, k = 0; j < KERNEL_BLOCK_SIZE; j++, k += 3)
+  {
+    const uint16_t distance = data[k] | (data[k + 1] << 8);
+    const bool pass = gate.pass(j + bank_origin, distance);
+    raw_distance[j] = pass ? distance : 0.0f;
+    raw_intensity[j] = data[k + 2];
+    in_range += pass && distance != 0;
+  }
+
+  const vf invalid = V::set1(nanf(""));
+  if (in_range == 0)
+  {
+    for (int j = 0; j < KERNEL_BLOCK_SIZE; j += V::WIDTH)
+    {
+      V::store(batch.x + j, invalid);
+      V::store(batch.y + j, invalid);
+      V::store(batch.z + j, invalid);
+      V::store(batch.distance + j, invalid);
+      V::store(batch.intensity + j, invalid);
+    }
+    return;
+  }
+
+  const vf cos_rot = V::set1(cos_rot_f);
+  const vf sin_rot = V::set1(sin_rot_f);
+  const vf resolution = V::set1(distance_resolution);
+  const vf zero = V::set1(0.0f);
+  const vf one = V::set1(1.0f);
+  const vf focal_scale = V::set1(256.0f);
+
+  for (int j = 0; j < KERNEL_BLOCK_SIZE; j += V::WIDTH)
+  {
+    const int laser = j + bank_origin;
+    const vf raw = V::load(raw_distance + j);
+
+    const vf distance = V::add(V::mul(raw, resolution), V::load(p.dist_correction + laser));
+
+    const vf cos_vert_angle = V::load(p.cos_vert + laser);
+    const vf sin_vert_angle = V::load(p.sin_vert + laser);
+    const vf cos_rot_correction = V::load(p.cos_rot + laser);
+    const vf sin_rot_correction = V::load(p.sin_rot + laser);
+
+    const vf cos_rot_angle = V::add(V::mul(cos_rot, cos_rot_correction), V::mul(sin_rot, sin_rot_correction));
+    const vf sin_rot_angle = V::sub(V::mul(sin_rot, cos_rot_correction), V::mul(cos_rot, sin_rot_correction));
+
+    const vf horiz_offset = V::load(p.horiz_offset + laser);
+    const vf vert_offset_term = V::load(p.vert_offset_sin_vert + laser);
+
+    vf distance_corr_x = zero;
+    vf distance_corr_y = zero;
+    const vf two_pt = V::loadMask(p.two_pt_mask + laser);
+    if (V::any(two_pt))
+    {
+      const vf xy_distance = V::sub(V::mul(distance, cos_vert_angle), vert_offset_term);
+      const vf xx = V::abs(V::sub(V::mul(xy_distance, sin_rot_angle), V::mul(horiz_offset, cos_rot_angle)));
+      const vf yy = V::abs(V::add(V::mul(xy_distance, cos_rot_angle), V::mul(horiz_offset, sin_rot_angle)));
+
+      distance_corr_x = V::add(V::mul(V::load(p.two_pt_slope_x + laser),
+                                      V::sub(xx, V::set1(DecodePlan::TWO_PT_NEAR_X))),
+                               V::load(p.two_pt_offset_x + laser));
+      distance_corr_y = V::add(V::mul(V::load(p.two_pt_slope_y + laser),
+                                      V::sub(yy, V::set1(DecodePlan::TWO_PT_NEAR_Y))),
+                               V::load(p.two_pt_offset_y + laser));
+      distance_corr_x = V::bitAnd(two_pt, distance_corr_x);
+      distance_corr_y = V::bitAnd(two_pt, distance_corr_y);
+    }
+
+    const vf distance_x = V::add(distance, distance_corr_x);
+    const vf xy_distance_x = V::sub(V::mul(distance_x, cos_vert_angle), vert_offset_term);
+    const vf x = V::sub(V::mul(xy_distance_x, sin_rot_angle), V::mul(horiz_offset, cos_rot_angle));
+
+    const vf distance_y = V::add(distance, distance_corr_y);
+    const vf xy_distance_y = V::sub(V::mul(distance_y, cos_vert_angle), vert_offset_term);
+    const vf y = V::add(V::mul(xy_distance_y, cos_rot_angle), V::mul(horiz_offset, sin_rot_angle));
+
+    const vf z = V::add(V::mul(distance_y, sin_vert_angle), V::load(p.vert_offset_cos_vert + laser));
+
+    // intensity calculation
+    const vf scaled = V::sub(one, V::div(raw, V::set1(65535.0f)));
+    const vf focal_term = V::abs(V::sub(V::load(p.focal_offset + laser), V::mul(focal_scale, V::mul(scaled, scaled))));
+    vf intensity = V::add(V::load(raw_intensity + j), V::mul(V::load(p.focal_slope + laser), focal_term));
+    intensity = V::max(intensity, V::load(p.min_intensity + laser));
+    intensity = V::min(intensity, V::load(p.max_intensity + laser));
+
+    // no valid laser beam return, and standard ROS coordinate system (right-hand rule)
+    const vf valid = V::notEqual(raw, zero);
+    V::store(batch.x + j, V::select(valid, y, invalid));
+    V::store(batch.y + j, V::select(valid, V::negate(x), invalid));
+    V::store(batch.z + j, V::select(valid, z, invalid));
+    V::store(batch.distance + j, V::select(valid, distance, invalid));
+    V::store(batch.intensity + j, V::select(valid, intensity, invalid));
+  }
+}
+}  // namespace
+}  // namespace velodyne_rawdata
+
+#endif  // VELODYNE_POINTCLOUD_DECODE_KERNELS_IMPL_H
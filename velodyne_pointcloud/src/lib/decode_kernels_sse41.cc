@@ -0,0 +1,49 @@
+/** @file
+
+    SSE4.1 block decode kernel, four lasers per vector.
+
+    This file is compiled with -msse4.1 and must only be called after
+    decodeKernelSupported(DECODE_KERNEL_SSE41) returned true.
+
+*/
+
+#include <smmintrin.h>
+#include "decode_kernels_impl.h"
+
+namespace velodyne_rawdata
+{
+namespace
+{
+struct Sse41
+{
+  typedef __m128 vf;
+  static const int WIDTH = 4;
+
+  static inline vf set1(float v) { return _mm_set1_ps(v); }
+  static inline vf load(const float* p) { return _mm_loadu_ps(p); }
+  static inline vf loadMask(const uint32_t* p)
+  {
+    return _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+  }
+  static inline void store(float* p, vf v) { _mm_storeu_ps(p, v); }
+  static inline vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+  static inline vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+  static inline vf mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+  static inline vf div(vf a, vf b) { return _mm_div_ps(a, b); }
+  static inline vf max(vf a, vf b) { return _mm_max_ps(a, b); }
+  static inline vf min(vf a, vf b) { return _mm_min_ps(a, b); }
+  static inline vf abs(vf a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+  static inline vf negate(vf a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+  static inline vf bitAnd(vf a, vf b) { return _mm_and_ps(a, b); }
+  static inline vf notEqual(vf a, vf b) { return _mm_cmpneq_ps(a, b); }
+  static inline vf select(vf mask, vf a, vf b) { return _mm_blendv_ps(b, a, mask); }
+  static inline bool any(vf mask) { return _mm_movemask_ps(mask) != 0; }
+};
+}  // namespace
+
+void decodeBlockSse41(const DecodePlan& plan, const RangeGate& gate, int bank_origin, const uint8_t* data,
+                      float distance_resolution, float cos_rot, float sin_rot, PointBatch& batch)
+{
+  decodeBlockLanes<Sse41>(plan, gate, bank_origin, data, distance_resolution, cos_rot, sin_rot, batch);
+}
+}  // namespace velodyne_rawdata
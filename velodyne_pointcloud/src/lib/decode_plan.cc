@@ -0,0 +1,156 @@
+/** @file
+
+    Precompute the per-laser decode constants of a calibration.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <velodyne_pointcloud/decode_plan.h>
+
+namespace velodyne_rawdata
+{
+  namespace
+  {
+    /** distance of a raw distance, computed exactly like the decoders do */
+    float rawToDistance(uint32_t raw, float resolution, float correction)
+    {
+      float distance = static_cast<float>(raw) * resolution;
+      distance += correction;
+      return distance;
+    }
+  }
+
+  constexpr float DecodePlan::TWO_PT_NEAR_X;
+  constexpr float DecodePlan::TWO_PT_NEAR_Y;
+  constexpr float DecodePlan::TWO_PT_FAR;
+
+  void DecodePlan::build(const velodyne_pointcloud::Calibration& calibration)
+  {
+    memset(this, 0, sizeof(*this));
+    for (int laser = 0; laser < MAX_LASERS && laser < static_cast<int>(calibration.laser_corrections.size());
+         ++laser)
+    {
+      const velodyne_pointcloud::LaserCorrection& corrections = calibration.laser_corrections[laser];
+      cos_vert[laser] = corrections.cos_vert_correction;
+      sin_vert[laser] = corrections.sin_vert_correction;
+      cos_rot[laser] = corrections.cos_rot_correction;
+      sin_rot[laser] = corrections.sin_rot_correction;
+      horiz_offset[laser] = corrections.horiz_offset_correction;
+      vert_offset_sin_vert[laser] = corrections.vert_offset_correction * corrections.sin_vert_correction;
+      vert_offset_cos_vert[laser] = corrections.vert_offset_correction * corrections.cos_vert_correction;
+      dist_correction[laser] = corrections.dist_correction;
+
+      // Linear interpolation between the near correction (dist_correction_x/y)
+      // and the far one (dist_correction), relative to dist_correction which
+      // is already applied to every return.
+      if (corrections.two_pt_correction_available)
+      {
+        two_pt_mask[laser] = 0xffffffffu;
+        two_pt_slope_x[laser] = (corrections.dist_correction - corrections.dist_correction_x)
+                                / (TWO_PT_FAR - TWO_PT_NEAR_X);
+        two_pt_slope_y[laser] = (corrections.dist_correction - corrections.dist_correction_y)
+                                / (TWO_PT_FAR - TWO_PT_NEAR_Y);
+        two_pt_offset_x[laser] = corrections.dist_correction_x - corrections.dist_correction;
+        two_pt_offset_y[laser] = corrections.dist_correction_y - corrections.dist_correction;
+      }
+
+      focal_offset[laser] = 256
+                            * (1 - corrections.focal_distance / 13100)
+                            * (1 - corrections.focal_distance / 13100);
+      focal_slope[laser] = corrections.focal_slope;
+      min_intensity[laser] = corrections.min_intensity;
+      max_intensity[laser] = corrections.max_intensity;
+
+      ring[laser] = corrections.laser_ring;
+    }
+  }
+
+  boost::shared_ptr<DecodePlan> DecodePlan::create(const velodyne_pointcloud::Calibration& calibration)
+  {
+    boost::shared_ptr<DecodePlan> plan(new DecodePlan);
+    plan->build(calibration);
+    return plan;
+  }
+
+  void* DecodePlan::operator new(size_t size)
+  {
+    void* p = NULL;
+    if (posix_memalign(&p, 64, size) != 0)
+    {
+      throw std::bad_alloc();
+    }
+    return p;
+  }
+
+  void DecodePlan::operator delete(void* p)
+  {
+    free(p);
+  }
+
+  RangeGate::RangeGate()
+  {
+    for (int laser = 0; laser < DecodePlan::MAX_LASERS; ++laser)
+    {
+      min_raw[laser] = 0;
+      max_raw[laser] = 0xffff;
+    }
+  }
+
+  void RangeGate::build(const float* dist_correction, float distance_resolution, double min_range,
+                        double max_range)
+  {
+    for (int laser = 0; laser < DecodePlan::MAX_LASERS; ++laser)
+    {
+      const float correction = dist_correction != NULL ? dist_correction[laser] : 0.0f;
+
+      // distances grow with the raw distance, so both bounds are found
+      // by bisection: the first raw distance not below min_range ...
+      uint32_t low = 0;
+      uint32_t high = 0x10000;
+      while (low < high)
+      {
+        const uint32_t mid = (low + high) / 2;
+        if (rawToDistance(mid, distance_resolution, correction) >= min_range)
+        {
+          high = mid;
+        }
+        else
+        {
+          low = mid + 1;
+        }
+      }
+      const uint32_t first = low;
+
+      // ... and the first one above max_range
+      low = 0;
+      high = 0x10000;
+      while (low < high)
+      {
+        const uint32_t mid = (low + high) / 2;
+        if (rawToDistance(mid, distance_resolution, correction) > max_range)
+        {
+          high = mid;
+        }
+        else
+        {
+          low = mid + 1;
+        }
+      }
+      const uint32_t end = low;
+
+      if (first >= end)
+      {
+        // nothing in range
+        min_raw[laser] = 0xffff;
+        max_raw[laser] = 0;
+      }
+      else
+      {
+        min_raw[laser] = first;
+        max_raw[laser] = end - 1;
+      }
+    }
+  }
+}  // namespace velodyne_rawdata
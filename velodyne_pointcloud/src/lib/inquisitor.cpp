@@ -1,63 +1,152 @@
-// Include the ROS C++ APIs
+/** @file
+
+    Offline conversion of recorded velodyne_msgs/VelodyneScan messages
+    into sensor_msgs/PointCloud2 messages.
+
+    Every packet of every scan is decoded through RawData::unpack()
+    into a PointcloudXYZIRT container, exactly like the live Transform
+    node does.  Scans are spread across a pool of worker threads, each
+    owning its own RawData and container, while the main thread reads
+    the input bag and writes the results back in input order, so the
+    output bag is identical regardless of the number of threads, see
+    scan_converter.h.
+
+    usage: inquisitor <input.bag> <output.bag> [calibration.yaml] [model] [threads]
+
+    All messages which are not VelodyneScans are copied unchanged.
+*/
+
 #include <ros/ros.h>
+#include <ros/package.h>
 #include <rosbag/bag.h>
 #include <rosbag/view.h>
-#include <std_msgs/Int32.h>
-#include <std_msgs/String.h>
-#include <sensor_msgs/Imu.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <velodyne_msgs/VelodyneScan.h>
 #include <velodyne_pointcloud/rawdata.h>
-#include <velodyne_pointcloud/pointcloudXYZIRT.h>
-#include <velodyne_pointcloud/transform.h>
+#include <velodyne_pointcloud/scan_converter.h>
+
+#include <ctype.h>
+#include <errno.h>
 #include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    const char *OUTPUT_TOPIC = "/velodyne_points";
 
-#include <boost/foreach.hpp>
+    /** more threads than this are surely a typo */
+    const unsigned long MAX_THREADS = 1024;
 
-#define foreach BOOST_FOREACH
+    int usage(const char *program) {
+        std::cerr << "usage: " << program
+                  << " <input.bag> <output.bag> [calibration.yaml] [model] [threads]\n"
+                  << "  threads: 1 to " << MAX_THREADS << ", default: the number of CPU cores\n";
+        return 1;
+    }
+
+    /** @returns false unless arg is a whole number of threads in range */
+    bool parseThreads(const char *arg, unsigned int &threads) {
+        // strtoul() would also take leading blanks and a minus sign
+        if (!isdigit(static_cast<unsigned char>(arg[0]))) {
+            return false;
+        }
+        char *end = NULL;
+        errno = 0;
+        unsigned long value = strtoul(arg, &end, 10);
+        if (errno != 0 || *end != '\0' || value == 0 || value > MAX_THREADS) {
+            return false;
+        }
+        threads = static_cast<unsigned int>(value);
+        return true;
+    }
+}  // namespace
 
 // Standard C++ entry point
 int main(int argc, char **argv) {
-    std::string x(argv[1]);
-    std::string y(argv[2]);
-    velodyne_rawdata::RawData data;
+    if (argc < 3) {
+        return usage(argv[0]);
+    }
+    std::string input_file(argv[1]);
+    std::string output_file(argv[2]);
+    std::string calibration_file = (argc > 3) ? argv[3] :
+            ros::package::getPath("velodyne_pointcloud") + "/params/VeloView-VLP-32C.yaml";
+    std::string model = (argc > 4) ? argv[4] : "32C";
+    unsigned int threads = std::thread::hardware_concurrency();
+    if (argc > 5) {
+        if (!parseThreads(argv[5], threads)) {
+            std::cerr << "invalid number of threads: " << argv[5] << "\n";
+            return usage(argv[0]);
+        }
+    } else if (threads == 0) {
+        threads = 1;
+    }
+
     double min_range = 0.0;
     double max_range = 120.0;
+    velodyne_rawdata::RawData data;
     data.setParameters(min_range, max_range, 0, 2 * M_PI);
-    data.setupOffline("./src/velodyne/velodyne_pointcloud/params/VeloView-VLP-32C.yaml",
-                      max_range, min_range);
+    if (data.setupOffline(calibration_file, model, max_range, min_range) != 0) {
+        return 1;
+    }
+
     rosbag::Bag new_bag;
-    new_bag.open(y, rosbag::bagmode::Write);
+    new_bag.open(output_file, rosbag::bagmode::Write);
 
     rosbag::Bag bag;
-    bag.open(x, rosbag::bagmode::Read);
-    boost::shared_ptr <velodyne_rawdata::DataContainerBase> container_ptr;
+    bag.open(input_file, rosbag::bagmode::Read);
     rosbag::View view(bag);
-    int nth_msg = 0;
-    int prev_percentage = 0;
-    int percentage = 0;
-    foreach(rosbag::MessageInstance
-    const m, view)
-    {
-
-        velodyne_msgs::VelodyneScan::ConstPtr s = m.instantiate<velodyne_msgs::VelodyneScan>();
-        if (s != NULL) {
-            sensor_msgs::PointCloud2Ptr pts = data.unpackOffline(s->packets[0], s->header.stamp);
-            new_bag.write("/velodyne_points", s->header.stamp, *pts);
-        }
-        sensor_msgs::Imu::ConstPtr r = m.instantiate<sensor_msgs::Imu>();
-        if (r != NULL) {
-            new_bag.write("/gx5/imu/data", r->header.stamp, *r);
-        }
-        ++ nth_msg;
-        percentage = (100 * nth_msg) / view.size();
-        if (percentage != prev_percentage) {
-            std::cout << "Percentage of msgs processed: "<< percentage << "%\n";
-            prev_percentage = percentage;
-        }
 
+    std::cout << "Converting with " << threads << " threads\n";
+    velodyne_pointcloud::ScanConverterPool pool(data, max_range, min_range, threads);
+
+    // Bound the number of scans in flight, so memory use does not depend
+    // on the size of the bag, while keeping every thread busy.  Results
+    // are written strictly in order.
+    velodyne_pointcloud::OrderedConversion<rosbag::MessageInstance> conversion(
+            pool, 2 * threads,
+            [&new_bag](const ros::Time &stamp, const sensor_msgs::PointCloud2Ptr &cloud) {
+                new_bag.write(OUTPUT_TOPIC, stamp, cloud);
+            },
+            [&new_bag](const rosbag::MessageInstance &m) {
+                new_bag.write(m.getTopic(), m.getTime(), m, m.getConnectionHeader());
+            });
+
+    try {
+        size_t nth_msg = 0;
+        int prev_percentage = 0;
+        for (rosbag::View::iterator it = view.begin(); it != view.end(); ++it) {
+            const rosbag::MessageInstance &m = *it;
 
+            velodyne_msgs::VelodyneScan::ConstPtr s = m.instantiate<velodyne_msgs::VelodyneScan>();
+            if (s != NULL) {
+                conversion.addScan(s);
+            } else {
+                conversion.addMessage(m);
+            }
+
+            ++nth_msg;
+            int percentage = (100 * nth_msg) / view.size();
+            if (percentage != prev_percentage) {
+                std::cout << "Percentage of msgs processed: " << percentage << "%\n";
+                prev_percentage = percentage;
+            }
+        }
+        conversion.flush();
+    } catch (const std::exception &e) {
+        // keep what was written so far readable
+        std::cerr << "Converting message " << conversion.written() + 1 << " of " << input_file
+                  << " failed: " << e.what() << "\n";
+        new_bag.close();
+        bag.close();
+        return 1;
     }
+
     std::cout << "Saving bag\n";
+    new_bag.close();
     bag.close();
-}
\ No newline at end of file
+    return 0;
+}
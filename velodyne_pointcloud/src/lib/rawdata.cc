@@ -27,17 +27,37 @@
  *  HDL-64E S2 calibration support provided by Nick Hillier
  */
 
+#include <algorithm>
 #include <fstream>
 #include <math.h>
 #include <stdint.h>
+#include <string.h>
 #include <ros/ros.h>
 #include <ros/package.h>
 #include <angles/angles.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/decode_kernels.h>
 
 namespace velodyne_rawdata {
-    inline float SQR(float val) { return val * val; }
+    namespace {
+        /** ends lines which are not decoded, organized clouds keep a row for each */
+        void skipLines(DataContainerBase &data, int lines) {
+            for (int i = 0; i < lines; i++) {
+                data.skipLine();
+            }
+        }
+
+        // firing times of each model, computed by the compiler
+        constexpr BlockTimings VLP16_TIMINGS = makeTimingTable<12, 32>(timing::vlp16, false);
+        constexpr BlockTimings VLP16_DUAL_TIMINGS = makeTimingTable<12, 32>(timing::vlp16, true);
+        constexpr BlockTimings VLP32C_TIMINGS = makeTimingTable<12, 32>(timing::vlp32c, false);
+        constexpr BlockTimings VLP32C_DUAL_TIMINGS = makeTimingTable<12, 32>(timing::vlp32c, true);
+        constexpr BlockTimings HDL32E_TIMINGS = makeTimingTable<12, 32>(timing::hdl32e, false);
+        constexpr BlockTimings HDL32E_DUAL_TIMINGS = makeTimingTable<12, 32>(timing::hdl32e, true);
+        constexpr SequenceTimings VLS128_TIMINGS = makeTimingTable<3, 17>(timing::vls128, false);
+    }
+
 
     ////////////////////////////////////////////////////////////////////////
     //
@@ -45,7 +65,10 @@ namespace velodyne_rawdata {
     //
     ////////////////////////////////////////////////////////////////////////
 
-    RawData::RawData() {}
+    RawData::RawData() : decode_block_(decodeBlockScalar), timing_offsets(NULL), dual_timing_offsets(NULL),
+                         unpack_(&RawData::unpackBlocks<64>) {
+        config_.dual_returns = DUAL_RETURNS_BOTH;
+    }
 
     /** Update parameters: conversions and update */
     void RawData::setParameters(double min_range,
@@ -72,6 +95,38 @@ namespace velodyne_rawdata {
             config_.min_angle = 0;
             config_.max_angle = 36000;
         }
+        config_.view_width = config_.max_angle - config_.min_angle;
+        if (config_.view_width < 0) {
+            config_.view_width += ROTATION_MAX_UNITS;
+        }
+
+        setupRangeGate();
+    }
+
+    void RawData::setupRangeGate() {
+        if (!plan_) {
+            return;
+        }
+        if (calibration_.num_lasers == 128) {
+            // the VLS-128 decoder uses neither distance corrections nor the calibrated resolution
+            range_gate_.build(NULL, VLS128_DISTANCE_RESOLUTION, config_.min_range, config_.max_range);
+        } else {
+            range_gate_.build(plan_->dist_correction, calibration_.distance_resolution_m,
+                              config_.min_range, config_.max_range);
+        }
+    }
+
+    bool RawData::parseDualReturns(const std::string &name, DualReturns &returns) {
+        if (name == "both") {
+            returns = DUAL_RETURNS_BOTH;
+        } else if (name == "last") {
+            returns = DUAL_RETURNS_LAST;
+        } else if (name == "strongest") {
+            returns = DUAL_RETURNS_STRONGEST;
+        } else {
+            return false;
+        }
+        return true;
     }
 
     int RawData::scansPerPacket() const {
@@ -83,125 +138,37 @@ namespace velodyne_rawdata {
         }
     }
 
+    int RawData::linesPerPacket() const {
+        if (calibration_.num_lasers == 16) {
+            return BLOCKS_PER_PACKET * VLP16_FIRINGS_PER_BLOCK;
+        } else {
+            return BLOCKS_PER_PACKET;
+        }
+    }
+
     /**
-     * Build a timing table for each block/firing. Stores in timing_offsets vector
+     * Select the timing tables of the model, for each block/firing
      */
     bool RawData::buildTimings() {
-        // vlp16
         if (config_.model == "VLP16") {
-            // timing table calculation, from velodyne user manual
-            timing_offsets.resize(12);
-            for (size_t i = 0; i < timing_offsets.size(); ++i) {
-                timing_offsets[i].resize(32);
-            }
-            // constants
-            double full_firing_cycle = 55.296 * 1e-6; // seconds
-            double single_firing = 2.304 * 1e-6; // seconds
-            double dataBlockIndex, dataPointIndex;
-            bool dual_mode = false;
-            // compute timing offsets
-            for (size_t x = 0; x < timing_offsets.size(); ++x) {
-                for (size_t y = 0; y < timing_offsets[x].size(); ++y) {
-                    if (dual_mode) {
-                        dataBlockIndex = (x - (x % 2)) + (y / 16);
-                    } else {
-                        dataBlockIndex = (x * 2) + (y / 16);
-                    }
-                    dataPointIndex = y % 16;
-                    //timing_offsets[block][firing]
-                    timing_offsets[x][y] = (full_firing_cycle * dataBlockIndex) + (single_firing * dataPointIndex);
-                }
-            }
-        }
-            // vlp32
-        else if (config_.model == "32C") {
-            // timing table calculation, from velodyne user manual
-            timing_offsets.resize(12);
-            for (size_t i = 0; i < timing_offsets.size(); ++i) {
-                timing_offsets[i].resize(32);
-            }
-            // constants
-            double full_firing_cycle = 55.296 * 1e-6; // seconds
-            double single_firing = 2.304 * 1e-6; // seconds
-            double dataBlockIndex, dataPointIndex;
-            bool dual_mode = false;
-            // compute timing offsets
-            for (size_t x = 0; x < timing_offsets.size(); ++x) {
-                for (size_t y = 0; y < timing_offsets[x].size(); ++y) {
-                    if (dual_mode) {
-                        dataBlockIndex = x / 2;
-                    } else {
-                        dataBlockIndex = x;
-                    }
-                    dataPointIndex = y / 2;
-                    timing_offsets[x][y] = (full_firing_cycle * dataBlockIndex) + (single_firing * dataPointIndex);
-                }
-            }
-        }
-            // hdl32
-        else if (config_.model == "32E") {
-            // timing table calculation, from velodyne user manual
-            timing_offsets.resize(12);
-            for (size_t i = 0; i < timing_offsets.size(); ++i) {
-                timing_offsets[i].resize(32);
-            }
-            // constants
-            double full_firing_cycle = 46.080 * 1e-6; // seconds
-            double single_firing = 1.152 * 1e-6; // seconds
-            double dataBlockIndex, dataPointIndex;
-            bool dual_mode = false;
-            // compute timing offsets
-            for (size_t x = 0; x < timing_offsets.size(); ++x) {
-                for (size_t y = 0; y < timing_offsets[x].size(); ++y) {
-                    if (dual_mode) {
-                        dataBlockIndex = x / 2;
-                    } else {
-                        dataBlockIndex = x;
-                    }
-                    dataPointIndex = y / 2;
-                    timing_offsets[x][y] = (full_firing_cycle * dataBlockIndex) + (single_firing * dataPointIndex);
-                }
-            }
+            timing_offsets = VLP16_TIMINGS.offset;
+            dual_timing_offsets = VLP16_DUAL_TIMINGS.offset;
+        } else if (config_.model == "32C") {
+            timing_offsets = VLP32C_TIMINGS.offset;
+            dual_timing_offsets = VLP32C_DUAL_TIMINGS.offset;
+        } else if (config_.model == "32E") {
+            timing_offsets = HDL32E_TIMINGS.offset;
+            dual_timing_offsets = HDL32E_DUAL_TIMINGS.offset;
         } else if (config_.model == "VLS128") {
-
-            timing_offsets.resize(3);
-            for (size_t i = 0; i < timing_offsets.size(); ++i) {
-                timing_offsets[i].resize(17); // 17 (+1 for the maintenance time after firing group 8)
-            }
-
-            double full_firing_cycle = VLS128_SEQ_TDURATION * 1e-6; //seconds
-            double single_firing = VLS128_CHANNEL_TDURATION * 1e-6; // seconds
-            double offset_paket_time = VLS128_TOH_ADJUSTMENT * 1e-6; //seconds
-            double sequenceIndex, firingGroupIndex;
-            // Compute timing offsets
-            for (size_t x = 0; x < timing_offsets.size(); ++x) {
-                for (size_t y = 0; y < timing_offsets[x].size(); ++y) {
-
-                    sequenceIndex = x;
-                    firingGroupIndex = y;
-                    timing_offsets[x][y] = (full_firing_cycle * sequenceIndex) + (single_firing * firingGroupIndex) -
-                                           offset_paket_time;
-                    ROS_DEBUG(" firing_seque %lu firing_group %lu offset %f", x, y, timing_offsets[x][y]);
-                }
-            }
+            timing_offsets = VLS128_TIMINGS.offset;
+            dual_timing_offsets = NULL;
         } else {
-            timing_offsets.clear();
+            timing_offsets = NULL;
+            dual_timing_offsets = NULL;
             ROS_WARN("Timings not supported for model %s", config_.model.c_str());
+            return false;
         }
-
-        if (timing_offsets.size()) {
-            // ROS_INFO("VELODYNE TIMING TABLE:");
-            for (size_t x = 0; x < timing_offsets.size(); ++x) {
-                for (size_t y = 0; y < timing_offsets[x].size(); ++y) {
-                    printf("%04.3f ", timing_offsets[x][y] * 1e6);
-                }
-                printf("\n");
-            }
-            return true;
-        } else {
-            ROS_WARN("NO TIMING OFFSETS CALCULATED. ARE YOU USING A SUPPORTED VELODYNE SENSOR?");
-        }
-        return false;
+        return true;
     }
 
     /** Set up for on-line operation. */
@@ -215,6 +182,13 @@ namespace velodyne_rawdata {
 
         buildTimings();
 
+        std::string dual_returns("both");
+        private_nh.getParam("dual_returns", dual_returns);
+        if (!parseDualReturns(dual_returns, config_.dual_returns)) {
+            ROS_ERROR_STREAM("Unknown dual_returns " << dual_returns << ", decoding both returns.");
+            config_.dual_returns = DUAL_RETURNS_BOTH;
+        }
+
         // get path to angles.config file for this device
         if (!private_nh.getParam("calibration", config_.calibrationFile)) {
             ROS_ERROR_STREAM("No calibration angles specified! Using test values!");
@@ -233,12 +207,17 @@ namespace velodyne_rawdata {
 
         setupSinCosCache();
         setupAzimuthCache();
+        setupDecodePlan();
+        setupDecoder();
 
         return calibration_;
     }
 
     /** Set up for offline operation */
-    int RawData::setupOffline(std::string calibration_file, double max_range_, double min_range_) {
+    int RawData::setupOffline(std::string calibration_file, std::string model, double max_range_, double min_range_) {
+
+        config_.model = model;
+        buildTimings();
 
         config_.max_range = max_range_;
         config_.min_range = min_range_;
@@ -257,6 +236,8 @@ namespace velodyne_rawdata {
 
         setupSinCosCache();
         setupAzimuthCache();
+        setupDecodePlan();
+        setupDecoder();
 
         return 0;
     }
@@ -279,17 +260,10 @@ namespace velodyne_rawdata {
             cos_rot_table_[rot_index] = cosf(rotation);
             sin_rot_table_[rot_index] = sinf(rotation);
         }
-
-        if (config_.model == "VLS128") {
-            for (uint8_t i = 0; i < 16; i++) {
-                vls_128_laser_azimuth_cache[i] =
-                        (VLS128_CHANNEL_TDURATION / VLS128_SEQ_TDURATION) * (i + i / 8);
-            }
-        }
     }
 
     void RawData::setupAzimuthCache() {
-        if (config_.model == "VLS128") {
+        if (calibration_.num_lasers == 128) {
             for (uint8_t i = 0; i < 16; i++) {
                 vls_128_laser_azimuth_cache[i] =
                         (VLS128_CHANNEL_TDURATION / VLS128_SEQ_TDURATION) * (i + i / 8);
@@ -300,6 +274,82 @@ namespace velodyne_rawdata {
     }
 
 
+    void RawData::setupDecodePlan() {
+        plan_ = DecodePlan::create(calibration_);
+
+        DecodeKernel kernel = bestDecodeKernel();
+        decode_block_ = decodeBlockKernel(kernel);
+        ROS_INFO_STREAM("Decoding blocks with the " << decodeKernelName(kernel) << " kernel.");
+
+        setupRangeGate();
+    }
+
+    void RawData::setupDecoder() {
+        switch (calibration_.num_lasers) {
+            case 128:
+                unpack_ = &RawData::unpack_vls128;
+                break;
+            case 16:
+                unpack_ = &RawData::unpack_vlp16;
+                break;
+            case 32:
+                unpack_ = &RawData::unpackBlocks<32>;
+                break;
+            default:
+                unpack_ = &RawData::unpackBlocks<64>;
+                break;
+        }
+    }
+
+    const raw_block_t *RawData::selectReturns(const raw_packet_t *raw, int i, raw_block_t &merged) const {
+        const raw_block_t &last = raw->blocks[i & ~1];
+        const raw_block_t &strongest = raw->blocks[i | 1];
+        const bool is_last = (i & 1) == 0;
+
+        switch (config_.dual_returns) {
+            case DUAL_RETURNS_LAST:
+                return is_last ? &last : NULL;
+
+            case DUAL_RETURNS_STRONGEST:
+                if (is_last) {
+                    return NULL;
+                }
+                // if the last return is the strongest, the other block
+                // holds the second strongest instead
+                merged = strongest;
+                for (int k = 0; k < BLOCK_DATA_SIZE; k += RAW_SCAN_SIZE) {
+                    if (last.data[k + 2] >= strongest.data[k + 2]) {
+                        memcpy(&merged.data[k], &last.data[k], RAW_SCAN_SIZE);
+                    }
+                }
+                return &merged;
+
+            default:
+                if (is_last) {
+                    return &last;
+                }
+                // a strongest return repeating the last one is out of
+                // range with a distance of 0
+                merged = strongest;
+                for (int k = 0; k < BLOCK_DATA_SIZE; k += RAW_SCAN_SIZE) {
+                    if (last.data[k] == strongest.data[k] && last.data[k + 1] == strongest.data[k + 1]) {
+                        merged.data[k] = 0;
+                        merged.data[k + 1] = 0;
+                    }
+                }
+                return &merged;
+        }
+    }
+
+    bool RawData::packetInView(const raw_packet_t *raw) const {
+        const int first = raw->blocks[0].rotation;
+        const int span = (raw->blocks[BLOCKS_PER_PACKET - 1].rotation - first + ROTATION_MAX_UNITS) %
+                         ROTATION_MAX_UNITS;
+        // the firings of the last block rotate on, by less than the span of
+        // the blocks before it; packets spanning more are not trusted
+        return span > ROTATION_MAX_UNITS / 4 || arcInView(first, 2 * span);
+    }
+
     /** @brief convert raw packet to point cloud
      *
      *  @param pkt raw packet to unpack
@@ -307,185 +357,94 @@ namespace velodyne_rawdata {
      */
     void RawData::unpack(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase &data,
                          const ros::Time &scan_start_time) {
-        using velodyne_pointcloud::LaserCorrection;
         ROS_DEBUG_STREAM("Received packet, time: " << pkt.stamp);
 
-        /** special parsing for the VLS128 **/
-        if (pkt.data[1205] == VLS128_MODEL_ID) { // VLS 128
-            unpack_vls128(pkt, data, scan_start_time);
-            return;
-        }
-
-        /** special parsing for the VLP16 **/
-        if (calibration_.num_lasers == 16) {
-            unpack_vlp16(pkt, data, scan_start_time);
-            return;
-        }
+        (this->*unpack_)(pkt, data, scan_start_time);
+    }
 
+    /** @brief convert raw HDL-64E, HDL-32E or VLP-32C packet to point cloud
+     *
+     *  @param pkt raw packet to unpack
+     *  @param pc shared pointer to point cloud (points are appended)
+     */
+    template <int LASERS>
+    void RawData::unpackBlocks(const velodyne_msgs::VelodynePacket &pkt, DataContainerBase &data,
+                               const ros::Time &scan_start_time) {
         float time_diff_start_to_this_packet = (pkt.stamp - scan_start_time).toSec();
 
         const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
+        PointBatch batch;
+
+        // only 32 laser sensors pair up the blocks of both returns
+        const bool dual_return = LASERS == 32 && pkt.data[RETURN_MODE_OFFSET] == RETURN_MODE_DUAL;
+        const float *timings = dual_return ? dual_timing_offsets : timing_offsets;
+        raw_block_t merged;
+
+        // skip packets whose firings all lie outside the view window
+        if (!packetInView(raw)) {
+            skipLines(data, BLOCKS_PER_PACKET);
+            return;
+        }
 
         for (int i = 0; i < BLOCKS_PER_PACKET; i++) {
+            // all lasers of a block fire at its rotation, so blocks outside
+            // the view window are skipped before anything is decoded
+            if (!inView(raw->blocks[i].rotation)) {
+                data.skipLine();
+                continue;
+            }
+
+            // a line per block in every return mode, so the height of
+            // organized clouds does not depend on it
+            const raw_block_t *selected = &raw->blocks[i];
+            if (dual_return) {
+                selected = selectReturns(raw, i, merged);
+                if (selected == NULL) {
+                    data.skipLine();
+                    continue;
+                }
+            }
+            const raw_block_t &block = *selected;
 
             // upper bank lasers are numbered [0..31]
             // NOTE: this is a change from the old velodyne_common implementation
 
             int bank_origin = 0;
-            if (raw->blocks[i].header == LOWER_BANK) {
+            if (LASERS > 32 && block.header == LOWER_BANK) {
                 // lower bank lasers are [32..63]
                 bank_origin = 32;
             }
 
-            for (int j = 0, k = 0; j < SCANS_PER_BLOCK; j++, k += RAW_SCAN_SIZE) {
-
-                float x, y, z;
-                float intensity;
-                const uint8_t laser_number = j + bank_origin;
-                float time = 0;
-
-                const LaserCorrection &corrections = calibration_.laser_corrections[laser_number];
-
-                /** Position Calculation */
-                const raw_block_t &block = raw->blocks[i];
-                union two_bytes tmp;
-                tmp.bytes[0] = block.data[k];
-                tmp.bytes[1] = block.data[k + 1];
-
-                /*condition added to avoid calculating points which are not
-                  in the interesting defined area (min_angle < area < max_angle)*/
-                if ((block.rotation >= config_.min_angle
-                     && block.rotation <= config_.max_angle
-                     && config_.min_angle < config_.max_angle)
-                    || (config_.min_angle > config_.max_angle
-                        && (raw->blocks[i].rotation <= config_.max_angle
-                            || raw->blocks[i].rotation >= config_.min_angle))) {
-
-                    if (timing_offsets.size()) {
-                        time = timing_offsets[i][j] + time_diff_start_to_this_packet;
-                    }
-
-                    if (tmp.uint == 0) // no valid laser beam return
-                    {
-                        // call to addPoint is still required since output could be organized
-                        data.addPoint(nanf(""), nanf(""), nanf(""), corrections.laser_ring, raw->blocks[i].rotation,
-                                      nanf(""), nanf(""), time);
-                        continue;
-                    }
-
-                    float distance = tmp.uint * calibration_.distance_resolution_m;
-                    distance += corrections.dist_correction;
-
-                    float cos_vert_angle = corrections.cos_vert_correction;
-                    float sin_vert_angle = corrections.sin_vert_correction;
-                    float cos_rot_correction = corrections.cos_rot_correction;
-                    float sin_rot_correction = corrections.sin_rot_correction;
-
-                    // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-                    // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-                    float cos_rot_angle =
-                            cos_rot_table_[block.rotation] * cos_rot_correction +
-                            sin_rot_table_[block.rotation] * sin_rot_correction;
-                    float sin_rot_angle =
-                            sin_rot_table_[block.rotation] * cos_rot_correction -
-                            cos_rot_table_[block.rotation] * sin_rot_correction;
+            batch.clear();
 
-                    float horiz_offset = corrections.horiz_offset_correction;
-                    float vert_offset = corrections.vert_offset_correction;
+            // all lasers of the block share its rotation, so positions and
+            // intensities are computed for the whole block at once
+            decode_block_(*plan_, range_gate_, bank_origin, block.data, calibration_.distance_resolution_m,
+                          cos_rot_table_[block.rotation], sin_rot_table_[block.rotation], batch);
 
-                    // Compute the distance in the xy plane (w/o accounting for rotation)
-                    /**the new term of 'vert_offset * sin_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    float xy_distance = distance * cos_vert_angle - vert_offset * sin_vert_angle;
-
-                    // Calculate temporal X, use absolute value.
-                    float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-                    // Calculate temporal Y, use absolute value
-                    float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-                    if (xx < 0) xx = -xx;
-                    if (yy < 0) yy = -yy;
-
-                    // Get 2points calibration values,Linear interpolation to get distance
-                    // correction for X and Y, that means distance correction use
-                    // different value at different distance
-                    float distance_corr_x = 0;
-                    float distance_corr_y = 0;
-                    if (corrections.two_pt_correction_available) {
-                        distance_corr_x =
-                                (corrections.dist_correction - corrections.dist_correction_x)
-                                * (xx - 2.4) / (25.04 - 2.4)
-                                + corrections.dist_correction_x;
-                        distance_corr_x -= corrections.dist_correction;
-                        distance_corr_y =
-                                (corrections.dist_correction - corrections.dist_correction_y)
-                                * (yy - 1.93) / (25.04 - 1.93)
-                                + corrections.dist_correction_y;
-                        distance_corr_y -= corrections.dist_correction;
-                    }
-
-                    float distance_x = distance + distance_corr_x;
-                    /**the new term of 'vert_offset * sin_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    xy_distance = distance_x * cos_vert_angle - vert_offset * sin_vert_angle;
-                    ///the expression wiht '-' is proved to be better than the one with '+'
-                    x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-
-                    float distance_y = distance + distance_corr_y;
-                    xy_distance = distance_y * cos_vert_angle - vert_offset * sin_vert_angle;
-                    /**the new term of 'vert_offset * sin_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-
-                    // Using distance_y is not symmetric, but the velodyne manual
-                    // does this.
-                    /**the new term of 'vert_offset * cos_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    z = distance_y * sin_vert_angle + vert_offset * cos_vert_angle;
-
-                    /** Use standard ROS coordinate system (right-hand rule) */
-                    float x_coord = y;
-                    float y_coord = -x;
-                    float z_coord = z;
-
-                    /** Intensity Calculation */
-
-                    float min_intensity = corrections.min_intensity;
-                    float max_intensity = corrections.max_intensity;
-
-                    intensity = raw->blocks[i].data[k + 2];
-
-                    float focal_offset = 256
-                                         * (1 - corrections.focal_distance / 13100)
-                                         * (1 - corrections.focal_distance / 13100);
-                    float focal_slope = corrections.focal_slope;
-                    intensity += focal_slope * (std::abs(focal_offset - 256 *
-                                                                        SQR(1 - static_cast<float>(tmp.uint) / 65535)));
-                    intensity = (intensity < min_intensity) ? min_intensity : intensity;
-                    intensity = (intensity > max_intensity) ? max_intensity : intensity;
-
-                    data.addPoint(x_coord, y_coord, z_coord, corrections.laser_ring, raw->blocks[i].rotation, distance,
-                                  intensity, time);
+            // invalid returns are still added since output could be organized
+            for (int j = 0; j < SCANS_PER_BLOCK; j++) {
+                batch.ring[j] = plan_->ring[j + bank_origin];
+                batch.azimuth[j] = block.rotation;
+            }
+            if (timings) {
+                const float *row = timings + i * BlockTimings::cols;
+                for (int j = 0; j < SCANS_PER_BLOCK; j++) {
+                    batch.time[j] = row[j] + time_diff_start_to_this_packet;
                 }
+            } else {
+                std::fill(batch.time, batch.time + SCANS_PER_BLOCK, 0.0f);
             }
+            batch.size = SCANS_PER_BLOCK;
+            data.addPoints(batch);
             data.newLine();
         }
     }
 
     sensor_msgs::PointCloud2Ptr
     RawData::unpackOffline(const velodyne_msgs::VelodynePacket &pkt, const ros::Time &scan_start_time) {
-        using velodyne_pointcloud::LaserCorrection;
         ROS_DEBUG_STREAM("Received packet, time: " << pkt.stamp);
 
-        float time_diff_start_to_this_packet = (pkt.stamp - scan_start_time).toSec();
-
         const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
 
         sensor_msgs::PointCloud2Ptr points_msg = boost::make_shared<sensor_msgs::PointCloud2>();
@@ -507,150 +466,31 @@ namespace velodyne_rawdata {
         sensor_msgs::PointCloud2Iterator<float> iter_z(*points_msg, "z");
         sensor_msgs::PointCloud2Iterator<float> iter_i (*points_msg, "intensity");
 
-        int n_iterations = 0;
+        PointBatch batch;
         for (int i = 0; i < BLOCKS_PER_PACKET; i++) {
+            const raw_block_t &block = raw->blocks[i];
 
             // upper bank lasers are numbered [0..31]
             // NOTE: this is a change from the old velodyne_common implementation
 
             int bank_origin = 0;
-            if (raw->blocks[i].header == LOWER_BANK) {
+            if (block.header == LOWER_BANK) {
                 // lower bank lasers are [32..63]
                 bank_origin = 32;
             }
 
-            for (int j = 0, k = 0; j < SCANS_PER_BLOCK; j++, k += RAW_SCAN_SIZE) {
+            if (inView(block.rotation)) {
+                decode_block_(*plan_, range_gate_, bank_origin, block.data, calibration_.distance_resolution_m,
+                              cos_rot_table_[block.rotation], sin_rot_table_[block.rotation], batch);
 
-                float x, y, z;
-                float intensity;
-                const uint8_t laser_number = j + bank_origin;
-                float time = 0;
-
-                const LaserCorrection &corrections = calibration_.laser_corrections[laser_number];
-
-                /** Position Calculation */
-                const raw_block_t &block = raw->blocks[i];
-                union two_bytes tmp;
-                tmp.bytes[0] = block.data[k];
-                tmp.bytes[1] = block.data[k + 1];
-
-                /*condition added to avoid calculating points which are not
-                  in the interesting defined area (min_angle < area < max_angle)*/
-                if ((block.rotation >= config_.min_angle
-                     && block.rotation <= config_.max_angle
-                     && config_.min_angle < config_.max_angle)
-                    || (config_.min_angle > config_.max_angle
-                        && (raw->blocks[i].rotation <= config_.max_angle
-                            || raw->blocks[i].rotation >= config_.min_angle))) {
-
-                    if (timing_offsets.size()) {
-                        time = timing_offsets[i][j] + time_diff_start_to_this_packet;
-                    }
-
-                    float distance = tmp.uint * calibration_.distance_resolution_m;
-                    distance += corrections.dist_correction;
-
-                    float cos_vert_angle = corrections.cos_vert_correction;
-                    float sin_vert_angle = corrections.sin_vert_correction;
-                    float cos_rot_correction = corrections.cos_rot_correction;
-                    float sin_rot_correction = corrections.sin_rot_correction;
-
-                    // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-                    // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-                    float cos_rot_angle =
-                            cos_rot_table_[block.rotation] * cos_rot_correction +
-                            sin_rot_table_[block.rotation] * sin_rot_correction;
-                    float sin_rot_angle =
-                            sin_rot_table_[block.rotation] * cos_rot_correction -
-                            cos_rot_table_[block.rotation] * sin_rot_correction;
-
-                    float horiz_offset = corrections.horiz_offset_correction;
-                    float vert_offset = corrections.vert_offset_correction;
-
-                    // Compute the distance in the xy plane (w/o accounting for rotation)
-                    /**the new term of 'vert_offset * sin_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    float xy_distance = distance * cos_vert_angle - vert_offset * sin_vert_angle;
-
-                    // Calculate temporal X, use absolute value.
-                    float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-                    // Calculate temporal Y, use absolute value
-                    float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-                    if (xx < 0) xx = -xx;
-                    if (yy < 0) yy = -yy;
-
-                    // Get 2points calibration values,Linear interpolation to get distance
-                    // correction for X and Y, that means distance correction use
-                    // different value at different distance
-                    float distance_corr_x = 0;
-                    float distance_corr_y = 0;
-                    if (corrections.two_pt_correction_available) {
-                        distance_corr_x =
-                                (corrections.dist_correction - corrections.dist_correction_x)
-                                * (xx - 2.4) / (25.04 - 2.4)
-                                + corrections.dist_correction_x;
-                        distance_corr_x -= corrections.dist_correction;
-                        distance_corr_y =
-                                (corrections.dist_correction - corrections.dist_correction_y)
-                                * (yy - 1.93) / (25.04 - 1.93)
-                                + corrections.dist_correction_y;
-                        distance_corr_y -= corrections.dist_correction;
-                    }
-
-                    float distance_x = distance + distance_corr_x;
-                    /**the new term of 'vert_offset * sin_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    xy_distance = distance_x * cos_vert_angle - vert_offset * sin_vert_angle;
-                    ///the expression wiht '-' is proved to be better than the one with '+'
-                    x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-
-                    float distance_y = distance + distance_corr_y;
-                    xy_distance = distance_y * cos_vert_angle - vert_offset * sin_vert_angle;
-                    /**the new term of 'vert_offset * sin_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-
-                    // Using distance_y is not symmetric, but the velodyne manual
-                    // does this.
-                    /**the new term of 'vert_offset * cos_vert_angle'
-                     * was added to the expression due to the mathemathical
-                     * model we used.
-                     */
-                    z = distance_y * sin_vert_angle + vert_offset * cos_vert_angle;
-
-                    /** Use standard ROS coordinate system (right-hand rule) */
-                    float x_coord = y;
-                    float y_coord = -x;
-                    float z_coord = z;
-
-                    /** Intensity Calculation */
-
-                    float min_intensity = corrections.min_intensity;
-                    float max_intensity = corrections.max_intensity;
-
-                    intensity = raw->blocks[i].data[k + 2];
-
-                    float focal_offset = 256
-                                         * (1 - corrections.focal_distance / 13100)
-                                         * (1 - corrections.focal_distance / 13100);
-                    float focal_slope = corrections.focal_slope;
-                    intensity += focal_slope * (std::abs(focal_offset - 256 *
-                                                                        SQR(1 - static_cast<float>(tmp.uint) / 65535)));
-                    intensity = (intensity < min_intensity) ? min_intensity : intensity;
-                    intensity = (intensity > max_intensity) ? max_intensity : intensity;
-                    *iter_x = x_coord;
+                for (int j = 0; j < SCANS_PER_BLOCK; j++) {
+                    *iter_x = batch.x[j];
                     ++iter_x;
-                    *iter_y = y_coord;
+                    *iter_y = batch.y[j];
                     ++iter_y;
-                    *iter_z = z_coord;
+                    *iter_z = batch.z[j];
                     ++iter_z;
-                    *iter_i = intensity;
+                    *iter_i = batch.intensity[j];
                     ++iter_i;
                 }
             }
@@ -681,7 +521,14 @@ namespace velodyne_rawdata {
         float time_diff_start_to_this_packet = (pkt.stamp - scan_start_time).toSec();
 
         uint8_t laser_number, firing_order;
-        bool dual_return = (pkt.data[1204] == 57);
+        bool dual_return = (pkt.data[RETURN_MODE_OFFSET] == RETURN_MODE_DUAL);
+        PointBatch batch;
+
+        // skip packets whose firings all lie outside the view window
+        if (!packetInView(raw)) {
+            skipLines(data, BLOCKS_PER_PACKET - (4 * dual_return));
+            return;
+        }
 
         for (int block = 0; block < BLOCKS_PER_PACKET - (4 * dual_return); block++) {
             // cache block for use
@@ -735,61 +582,69 @@ namespace velodyne_rawdata {
                 azimuth_diff = (block == BLOCKS_PER_PACKET - (4 * dual_return) - 1) ? 0 : last_azimuth_diff;
             }
 
-            // condition added to avoid calculating points which are not in the interesting defined area (min_angle < area < max_angle)
-            if ((config_.min_angle < config_.max_angle && azimuth >= config_.min_angle &&
-                 azimuth <= config_.max_angle) || (config_.min_angle > config_.max_angle)) {
-                for (int j = 0, k = 0; j < SCANS_PER_BLOCK; j++, k += RAW_SCAN_SIZE) {
-                    // distance extraction
-                    tmp.bytes[0] = current_block.data[k];
-                    tmp.bytes[1] = current_block.data[k + 1];
+            // the lasers of the block fire while rotating from its azimuth on,
+            // by up to azimuth_diff; blocks outside the view window are skipped
+            const int span = (int) ceilf(azimuth_diff);
+            if (!arcInView(azimuth, span)) {
+                data.skipLine();
+                continue;
+            }
+            const bool whole_block = arcWithinView(azimuth, span);
+
+            batch.clear();
+            for (int j = 0, k = 0; j < SCANS_PER_BLOCK; j++, k += RAW_SCAN_SIZE) {
+                // distance extraction
+                tmp.bytes[0] = current_block.data[k];
+                tmp.bytes[1] = current_block.data[k + 1];
+
+                // returns out of range are dropped before anything is computed
+                if (range_gate_.pass(j + bank_origin, tmp.uint)) {
                     distance = tmp.uint * VLS128_DISTANCE_RESOLUTION;
+                    laser_number = j + bank_origin;   // Offset the laser in this block by which block it's in
+                    firing_order = laser_number / 8;  // VLS-128 fires 8 lasers at a time
 
+                    if (timing_offsets) {
+                        time = timing_offsets[(block / 4) * SequenceTimings::cols + firing_order +
+                                              laser_number / 64] + time_diff_start_to_this_packet;
+                    }
 
-                    if (pointInRange(distance)) {
-                        laser_number = j + bank_origin;   // Offset the laser in this block by which block it's in
-                        firing_order = laser_number / 8;  // VLS-128 fires 8 lasers at a time
-
-                        if (timing_offsets.size()) {
-                            time = timing_offsets[block / 4][firing_order + laser_number / 64] +
-                                   time_diff_start_to_this_packet;
-                        }
-
-                        velodyne_pointcloud::LaserCorrection &corrections = calibration_.laser_corrections[laser_number];
-
-                        // correct for the laser rotation as a function of timing during the firings
-                        azimuth_corrected_f = azimuth + (azimuth_diff * vls_128_laser_azimuth_cache[firing_order]);
-                        azimuth_corrected = ((uint16_t) round(azimuth_corrected_f)) % 36000;
-
-                        // convert polar coordinates to Euclidean XYZ
-                        cos_vert_angle = corrections.cos_vert_correction;
-                        sin_vert_angle = corrections.sin_vert_correction;
-                        cos_rot_correction = corrections.cos_rot_correction;
-                        sin_rot_correction = corrections.sin_rot_correction;
-
-                        // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-                        // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-                        cos_rot_angle =
-                                cos_rot_table_[azimuth_corrected] * cos_rot_correction +
-                                sin_rot_table_[azimuth_corrected] * sin_rot_correction;
-                        sin_rot_angle =
-                                sin_rot_table_[azimuth_corrected] * cos_rot_correction -
-                                cos_rot_table_[azimuth_corrected] * sin_rot_correction;
-
-                        // Compute the distance in the xy plane (w/o accounting for rotation)
-                        xy_distance = distance * cos_vert_angle;
-
-                        data.addPoint(xy_distance * cos_rot_angle,
-                                      -(xy_distance * sin_rot_angle),
-                                      distance * sin_vert_angle,
-                                      corrections.laser_ring,
-                                      azimuth_corrected,
-                                      distance,
-                                      current_block.data[k + 2],
-                                      time);
+                    // correct for the laser rotation as a function of timing during the firings
+                    azimuth_corrected_f = azimuth + (azimuth_diff * vls_128_laser_azimuth_cache[firing_order]);
+                    azimuth_corrected = ((uint16_t) round(azimuth_corrected_f)) % 36000;
+                    if (!whole_block && !inView(azimuth_corrected)) {
+                        continue;
                     }
+
+                    // convert polar coordinates to Euclidean XYZ
+                    cos_vert_angle = plan_->cos_vert[laser_number];
+                    sin_vert_angle = plan_->sin_vert[laser_number];
+                    cos_rot_correction = plan_->cos_rot[laser_number];
+                    sin_rot_correction = plan_->sin_rot[laser_number];
+
+                    // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
+                    // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
+                    cos_rot_angle =
+                            cos_rot_table_[azimuth_corrected] * cos_rot_correction +
+                            sin_rot_table_[azimuth_corrected] * sin_rot_correction;
+                    sin_rot_angle =
+                            sin_rot_table_[azimuth_corrected] * cos_rot_correction -
+                            cos_rot_table_[azimuth_corrected] * sin_rot_correction;
+
+                    // Compute the distance in the xy plane (w/o accounting for rotation)
+                    xy_distance = distance * cos_vert_angle;
+
+                    batch.add(xy_distance * cos_rot_angle,
+                              -(xy_distance * sin_rot_angle),
+                              distance * sin_vert_angle,
+                              plan_->ring[laser_number],
+                              azimuth_corrected,
+                              distance,
+                              current_block.data[k + 2],
+                              time);
                 }
-                data.newLine();
             }
+            data.addPoints(batch);
+            data.newLine();
         }
     }
 
@@ -806,12 +661,23 @@ namespace velodyne_rawdata {
         float last_azimuth_diff = 0;
         float azimuth_corrected_f;
         int azimuth_corrected;
-        float x, y, z;
-        float intensity;
 
         float time_diff_start_to_this_packet = (pkt.stamp - scan_start_time).toSec();
 
         const raw_packet_t *raw = (const raw_packet_t *) &pkt.data[0];
+        PointBatch batch;
+
+        // both blocks of a dual return pair have the rotation of the same firings
+        const bool dual_return = pkt.data[RETURN_MODE_OFFSET] == RETURN_MODE_DUAL;
+        const int next = dual_return ? 2 : 1;
+        const float *timings = dual_return ? dual_timing_offsets : timing_offsets;
+        raw_block_t merged;
+
+        // skip packets whose firings all lie outside the view window
+        if (!packetInView(raw)) {
+            skipLines(data, BLOCKS_PER_PACKET * VLP16_FIRINGS_PER_BLOCK);
+            return;
+        }
 
         for (int block = 0; block < BLOCKS_PER_PACKET; block++) {
 
@@ -826,15 +692,20 @@ namespace velodyne_rawdata {
             }
 
             // Calculate difference between current and next block's azimuth angle.
+            const raw_block_t *selected = &raw->blocks[block];
+            if (dual_return) {
+                selected = selectReturns(raw, block, merged);
+            }
+
             azimuth = (float) (raw->blocks[block].rotation);
-            if (block < (BLOCKS_PER_PACKET - 1)) {
-                raw_azimuth_diff = raw->blocks[block + 1].rotation - raw->blocks[block].rotation;
+            if (block < (BLOCKS_PER_PACKET - next)) {
+                raw_azimuth_diff = raw->blocks[block + next].rotation - raw->blocks[block].rotation;
                 azimuth_diff = (float) ((36000 + raw_azimuth_diff) % 36000);
                 // some packets contain an angle overflow where azimuth_diff < 0
                 if (raw_azimuth_diff < 0)//raw->blocks[block+1].rotation - raw->blocks[block].rotation < 0)
                 {
                     ROS_WARN_STREAM_THROTTLE(60, "Packet containing angle overflow, first angle: "
-                            << raw->blocks[block].rotation << " second angle: " << raw->blocks[block + 1].rotation);
+                            << raw->blocks[block].rotation << " second angle: " << raw->blocks[block + next].rotation);
                     // if last_azimuth_diff was not zero, we can assume that the velodyne's speed did not change very much and use the same difference
                     if (last_azimuth_diff > 0) {
                         azimuth_diff = last_azimuth_diff;
@@ -842,6 +713,7 @@ namespace velodyne_rawdata {
                         // otherwise we are not able to use this data
                         // TODO: we might just not use the second 16 firings
                     else {
+                        skipLines(data, VLP16_FIRINGS_PER_BLOCK);
                         continue;
                     }
                 }
@@ -850,14 +722,31 @@ namespace velodyne_rawdata {
                 azimuth_diff = last_azimuth_diff;
             }
 
+            // skipped only now, the azimuth difference is still needed;
+            // its lines are kept, so the height of organized clouds does
+            // not depend on the return mode
+            if (selected == NULL) {
+                skipLines(data, VLP16_FIRINGS_PER_BLOCK);
+                continue;
+            }
+
+            // both firings of the block rotate from its azimuth on, by less
+            // than azimuth_diff; blocks outside the view window are skipped
+            const int span = (int) ceilf(azimuth_diff);
+            if (!arcInView(raw->blocks[block].rotation, span)) {
+                skipLines(data, VLP16_FIRINGS_PER_BLOCK);
+                continue;
+            }
+            const bool whole_block = arcWithinView(raw->blocks[block].rotation, span);
+
             for (int firing = 0, k = 0; firing < VLP16_FIRINGS_PER_BLOCK; firing++) {
+                batch.clear();
                 for (int dsr = 0; dsr < VLP16_SCANS_PER_FIRING; dsr++, k += RAW_SCAN_SIZE) {
-                    velodyne_pointcloud::LaserCorrection &corrections = calibration_.laser_corrections[dsr];
-
-                    /** Position Calculation */
-                    union two_bytes tmp;
-                    tmp.bytes[0] = raw->blocks[block].data[k];
-                    tmp.bytes[1] = raw->blocks[block].data[k + 1];
+                    uint16_t raw_distance = selected->data[k] | (selected->data[k + 1] << 8);
+                    // returns out of range are decoded like returns without a distance
+                    if (!range_gate_.pass(dsr, raw_distance)) {
+                        raw_distance = 0;
+                    }
 
                     /** correct for the laser rotation as a function of timing during the firings **/
                     azimuth_corrected_f = azimuth + (azimuth_diff *
@@ -865,119 +754,26 @@ namespace velodyne_rawdata {
                                                      VLP16_BLOCK_TDURATION);
                     azimuth_corrected = ((int) round(azimuth_corrected_f)) % 36000;
 
-                    /*condition added to avoid calculating points which are not
-                      in the interesting defined area (min_angle < area < max_angle)*/
-                    if ((azimuth_corrected >= config_.min_angle
-                         && azimuth_corrected <= config_.max_angle
-                         && config_.min_angle < config_.max_angle)
-                        || (config_.min_angle > config_.max_angle
-                            && (azimuth_corrected <= config_.max_angle
-                                || azimuth_corrected >= config_.min_angle))) {
-
-                        // convert polar coordinates to Euclidean XYZ
-                        float distance = tmp.uint * calibration_.distance_resolution_m;
-                        distance += corrections.dist_correction;
-
-                        float cos_vert_angle = corrections.cos_vert_correction;
-                        float sin_vert_angle = corrections.sin_vert_correction;
-                        float cos_rot_correction = corrections.cos_rot_correction;
-                        float sin_rot_correction = corrections.sin_rot_correction;
-
-                        // cos(a-b) = cos(a)*cos(b) + sin(a)*sin(b)
-                        // sin(a-b) = sin(a)*cos(b) - cos(a)*sin(b)
-                        float cos_rot_angle =
-                                cos_rot_table_[azimuth_corrected] * cos_rot_correction +
-                                sin_rot_table_[azimuth_corrected] * sin_rot_correction;
-                        float sin_rot_angle =
-                                sin_rot_table_[azimuth_corrected] * cos_rot_correction -
-                                cos_rot_table_[azimuth_corrected] * sin_rot_correction;
-
-                        float horiz_offset = corrections.horiz_offset_correction;
-                        float vert_offset = corrections.vert_offset_correction;
-
-                        // Compute the distance in the xy plane (w/o accounting for rotation)
-                        /**the new term of 'vert_offset * sin_vert_angle'
-                         * was added to the expression due to the mathemathical
-                         * model we used.
-                         */
-                        float xy_distance = distance * cos_vert_angle - vert_offset * sin_vert_angle;
-
-                        // Calculate temporal X, use absolute value.
-                        float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-                        // Calculate temporal Y, use absolute value
-                        float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-                        if (xx < 0) xx = -xx;
-                        if (yy < 0) yy = -yy;
-
-                        // Get 2points calibration values,Linear interpolation to get distance
-                        // correction for X and Y, that means distance correction use
-                        // different value at different distance
-                        float distance_corr_x = 0;
-                        float distance_corr_y = 0;
-                        if (corrections.two_pt_correction_available) {
-                            distance_corr_x =
-                                    (corrections.dist_correction - corrections.dist_correction_x)
-                                    * (xx - 2.4) / (25.04 - 2.4)
-                                    + corrections.dist_correction_x;
-                            distance_corr_x -= corrections.dist_correction;
-                            distance_corr_y =
-                                    (corrections.dist_correction - corrections.dist_correction_y)
-                                    * (yy - 1.93) / (25.04 - 1.93)
-                                    + corrections.dist_correction_y;
-                            distance_corr_y -= corrections.dist_correction;
-                        }
-
-                        float distance_x = distance + distance_corr_x;
-                        /**the new term of 'vert_offset * sin_vert_angle'
-                         * was added to the expression due to the mathemathical
-                         * model we used.
-                         */
-                        xy_distance = distance_x * cos_vert_angle - vert_offset * sin_vert_angle;
-                        x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
-
-                        float distance_y = distance + distance_corr_y;
-                        /**the new term of 'vert_offset * sin_vert_angle'
-                         * was added to the expression due to the mathemathical
-                         * model we used.
-                         */
-                        xy_distance = distance_y * cos_vert_angle - vert_offset * sin_vert_angle;
-                        y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
-
-                        // Using distance_y is not symmetric, but the velodyne manual
-                        // does this.
-                        /**the new term of 'vert_offset * cos_vert_angle'
-                         * was added to the expression due to the mathemathical
-                         * model we used.
-                         */
-                        z = distance_y * sin_vert_angle + vert_offset * cos_vert_angle;
-
-
-                        /** Use standard ROS coordinate system (right-hand rule) */
-                        float x_coord = y;
-                        float y_coord = -x;
-                        float z_coord = z;
-
-                        /** Intensity Calculation */
-                        float min_intensity = corrections.min_intensity;
-                        float max_intensity = corrections.max_intensity;
-
-                        intensity = raw->blocks[block].data[k + 2];
-
-                        float focal_offset = 256 * SQR(1 - corrections.focal_distance / 13100);
-                        float focal_slope = corrections.focal_slope;
-                        intensity += focal_slope * (std::abs(focal_offset - 256 *
-                                                                            SQR(1 - tmp.uint / 65535)));
-                        intensity = (intensity < min_intensity) ? min_intensity : intensity;
-                        intensity = (intensity > max_intensity) ? max_intensity : intensity;
-
-                        float time = 0;
-                        if (timing_offsets.size())
-                            time = timing_offsets[block][firing * 16 + dsr] + time_diff_start_to_this_packet;
-
-                        data.addPoint(x_coord, y_coord, z_coord, corrections.laser_ring, azimuth_corrected, distance,
-                                      intensity, time);
+                    // only blocks partly in the view window are checked return
+                    // by return, returns outside it are invalid as well
+                    if (!whole_block && !inView(azimuth_corrected)) {
+                        raw_distance = 0;
                     }
+
+                    // every return has its own rotation, so decode them one by one
+                    int i = batch.size;
+                    decodeReturn(*plan_, dsr, raw_distance, selected->data[k + 2],
+                                 calibration_.distance_resolution_m,
+                                 cos_rot_table_[azimuth_corrected], sin_rot_table_[azimuth_corrected], batch, i);
+                    batch.ring[i] = plan_->ring[dsr];
+                    batch.azimuth[i] = azimuth_corrected;
+                    batch.time[i] = 0;
+                    if (timings)
+                        batch.time[i] = timings[block * BlockTimings::cols + firing * 16 + dsr] +
+                                        time_diff_start_to_this_packet;
+                    ++batch.size;
                 }
+                data.addPoints(batch);
                 data.newLine();
             }
         }
@@ -0,0 +1,74 @@
+/** @file
+
+    Single core throughput of the block decode kernels.
+
+    usage: bench_decode_kernels [calibration.yaml] [blocks]
+
+    Decodes the same set of pseudo-random blocks with every kernel the
+    CPU supports and prints the achieved points per second.
+*/
+
+#include <ros/package.h>
+#include <velodyne_pointcloud/calibration.h>
+#include <velodyne_pointcloud/decode_kernels.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace velodyne_rawdata;  // NOLINT
+
+int main(int argc, char **argv)
+{
+  std::string calibration_file = (argc > 1) ? argv[1] :
+      ros::package::getPath("velodyne_pointcloud") + "/params/64e_utexas.yaml";
+  long blocks = (argc > 2) ? atol(argv[2]) : 2000000;
+
+  velodyne_pointcloud::Calibration calibration(calibration_file, false);
+  if (!calibration.initialized)
+  {
+    fprintf(stderr, "unable to read calibration %s\n", calibration_file.c_str());
+    return 1;
+  }
+  boost::shared_ptr<DecodePlan> plan = DecodePlan::create(calibration);
+  RangeGate gate;
+
+  // a working set of blocks which stays in the L1 cache
+  const int SAMPLES = 64;
+  std::vector<uint8_t> data(SAMPLES * 3 * KERNEL_BLOCK_SIZE);
+  unsigned int seed = 1;
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    data[i] = rand_r(&seed) % 256;
+  }
+
+  for (int kernel = DECODE_KERNEL_SCALAR; kernel <= DECODE_KERNEL_AVX2; ++kernel)
+  {
+    if (!decodeKernelSupported(static_cast<DecodeKernel>(kernel)))
+    {
+      continue;
+    }
+    DecodeBlockFn decode = decodeBlockKernel(static_cast<DecodeKernel>(kernel));
+    PointBatch batch;
+    float checksum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long n = 0; n < blocks; ++n)
+    {
+      int sample = n % SAMPLES;
+      int bank_origin = (calibration.num_lasers > KERNEL_BLOCK_SIZE) ? KERNEL_BLOCK_SIZE * (n % 2) : 0;
+      float rotation = (n % 36000) * 0.01f * M_PI / 180;
+      decode(*plan, gate, bank_origin, &data[sample * 3 * KERNEL_BLOCK_SIZE], calibration.distance_resolution_m,
+             cosf(rotation), sinf(rotation), batch);
+      checksum += batch.intensity[n % KERNEL_BLOCK_SIZE];
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%-8s %8.1f Mpoints/s  (checksum %g)\n", decodeKernelName(static_cast<DecodeKernel>(kernel)),
+           blocks * KERNEL_BLOCK_SIZE / seconds * 1e-6, checksum);
+  }
+  return 0;
+}
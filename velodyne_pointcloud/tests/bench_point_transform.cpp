@@ -0,0 +1,106 @@
+/** @file
+
+    Single core throughput of the point transforms.
+
+    usage: bench_point_transform [batches]
+
+    Transforms batches of 32 points to a target frame, with ego motion
+    compensation, one point at a time through two Affine3f multiplies,
+    and batched with one composed matrix, or two blended ones.
+*/
+
+#include <velodyne_pointcloud/point_batch.h>
+#include <velodyne_pointcloud/point_transform.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace velodyne_rawdata;  // NOLINT
+
+namespace
+{
+const int SAMPLES = 64;
+
+double elapsed(const std::chrono::steady_clock::time_point& start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* name, long batches, double seconds, float checksum)
+{
+  printf("%-10s %8.1f Mpoints/s  (checksum %g)\n", name, batches * PointBatch::CAPACITY / seconds * 1e-6, checksum);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  long batches = (argc > 1) ? atol(argv[1]) : 2000000;
+
+  // a working set of batches which stays in the L1 cache
+  static PointBatch input[SAMPLES];
+  unsigned int seed = 1;
+  for (int i = 0; i < SAMPLES; ++i)
+  {
+    for (int j = 0; j < PointBatch::CAPACITY; ++j)
+    {
+      input[i].add(rand_r(&seed) % 10000 * 0.01f - 50.0f, rand_r(&seed) % 10000 * 0.01f - 50.0f,
+                   rand_r(&seed) % 1000 * 0.01f - 5.0f, j, 0, 10.0f, 100.0f, j * 1.5e-6f);
+    }
+  }
+
+  const Eigen::Affine3f to_fixed = Eigen::Translation3f(10.0f, 20.0f, 0.5f)
+                                   * Eigen::AngleAxisf(0.3f, Eigen::Vector3f::UnitZ());
+  const Eigen::Affine3f to_target = Eigen::Translation3f(-1.0f, 0.0f, 2.0f)
+                                    * Eigen::AngleAxisf(0.1f, Eigen::Vector3f::UnitX());
+  alignas(32) float x[PointBatch::CAPACITY];
+  alignas(32) float y[PointBatch::CAPACITY];
+  alignas(32) float z[PointBatch::CAPACITY];
+
+  // per point, as DataContainerBase::transformPoint() used to
+  float checksum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (long n = 0; n < batches; ++n)
+  {
+    const PointBatch& batch = input[n % SAMPLES];
+    for (int i = 0; i < batch.size; ++i)
+    {
+      Eigen::Vector3f p = Eigen::Vector3f(batch.x[i], batch.y[i], batch.z[i]);
+      p = to_fixed * p;
+      p = to_target * p;
+      x[i] = p.x();
+      y[i] = p.y();
+      z[i] = p.z();
+    }
+    checksum += x[n % PointBatch::CAPACITY];
+  }
+  report("per point", batches, elapsed(start), checksum);
+
+  // one composed matrix
+  const PointTransform composed = (to_target * to_fixed).matrix().topRows<3>();
+  checksum = 0;
+  start = std::chrono::steady_clock::now();
+  for (long n = 0; n < batches; ++n)
+  {
+    const PointBatch& batch = input[n % SAMPLES];
+    transformPoints(composed, batch.x, batch.y, batch.z, batch.size, x, y, z);
+    checksum += x[n % PointBatch::CAPACITY];
+  }
+  report("batched", batches, elapsed(start), checksum);
+
+  // two matrices blended over the firing times of the batch
+  const PointTransform later = (to_target * Eigen::Translation3f(0.001f, 0.0f, 0.0f) * to_fixed).matrix().topRows<3>();
+  checksum = 0;
+  start = std::chrono::steady_clock::now();
+  for (long n = 0; n < batches; ++n)
+  {
+    const PointBatch& batch = input[n % SAMPLES];
+    alignas(32) float s[PointBatch::CAPACITY];
+    Eigen::Map<Eigen::ArrayXf>(s, batch.size) = Eigen::Map<const Eigen::ArrayXf>(batch.time, batch.size)
+                                                / batch.time[batch.size - 1];
+    transformPointsBlended(composed, later, s, batch.x, batch.y, batch.z, batch.size, x, y, z);
+    checksum += x[n % PointBatch::CAPACITY];
+  }
+  report("blended", batches, elapsed(start), checksum);
+  return 0;
+}
@@ -0,0 +1,492 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <ros/package.h>
+#include <velodyne_pointcloud/calibration.h>
+#include <velodyne_pointcloud/decode_kernels.h>
+
+#include <math.h>
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using namespace velodyne_pointcloud;  // NOLINT
+using namespace velodyne_rawdata;     // NOLINT
+
+std::string get_package_path()
+{
+  std::string g_package_name("velodyne_pointcloud");
+  return ros::package::getPath(g_package_name);
+}
+
+/** fill a block with pseudo-random returns, some of them invalid */
+void randomBlock(uint8_t* data, unsigned int* seed)
+{
+  for (int k = 0; k < 3 * KERNEL_BLOCK_SIZE; k += 3)
+  {
+    uint16_t distance = (rand_r(seed) % 8 == 0) ? 0 : rand_r(seed) % 65536;
+    data[k] = distance & 0xff;
+    data[k + 1] = distance >> 8;
+    data[k + 2] = rand_r(seed) % 256;
+  }
+}
+
+/** compare every kernel the CPU supports with the scalar reference, bit for bit */
+void expectKernelsMatchScalar(const Calibration& calibration)
+{
+  boost::shared_ptr<DecodePlan> plan = DecodePlan::create(calibration);
+
+  // every return, some of them, none at all
+  RangeGate gates[3];
+  gates[1].build(plan->dist_correction, calibration.distance_resolution_m, 2.0, 60.0);
+  gates[2].build(plan->dist_correction, calibration.distance_resolution_m, 200.0, 300.0);
+
+  unsigned int seed = 42;
+  for (int kernel = DECODE_KERNEL_SSE41; kernel <= DECODE_KERNEL_AVX2; ++kernel)
+  {
+    if (!decodeKernelSupported(static_cast<DecodeKernel>(kernel)))
+    {
+      continue;
+    }
+    SCOPED_TRACE(decodeKernelName(static_cast<DecodeKernel>(kernel)));
+    DecodeBlockFn decode = decodeBlockKernel(static_cast<DecodeKernel>(kernel));
+
+    for (int n = 0; n < 2000; ++n)
+    {
+      uint8_t data[3 * KERNEL_BLOCK_SIZE];
+      randomBlock(data, &seed);
+      int bank_origin = (calibration.num_lasers > KERNEL_BLOCK_SIZE && n % 2) ? KERNEL_BLOCK_SIZE : 0;
+      float rotation = (rand_r(&seed) % 36000) * 0.01f * M_PI / 180;
+
+      const RangeGate& gate = gates[n % 3];
+
+      PointBatch expected;
+      PointBatch actual;
+      decodeBlockScalar(*plan, gate, bank_origin, data, calibration.distance_resolution_m,
+                        cosf(rotation), sinf(rotation), expected);
+      decode(*plan, gate, bank_origin, data, calibration.distance_resolution_m,
+             cosf(rotation), sinf(rotation), actual);
+
+      size_t bytes = KERNEL_BLOCK_SIZE * sizeof(float);
+      ASSERT_EQ(0, memcmp(expected.x, actual.x, bytes));
+      ASSERT_EQ(0, memcmp(expected.y, actual.y, bytes));
+      ASSERT_EQ(0, memcmp(expected.z, actual.z, bytes));
+      ASSERT_EQ(0, memcmp(expected.distance, actual.distance, bytes));
+      ASSERT_EQ(0, memcmp(expected.intensity, actual.intensity, bytes));
+    }
+  }
+}
+
+/** one decoded return */
+struct Return
+{
+  float x, y, z, distance, intensity;
+};
+
+/** \brief The per-point computation of RawData::unpack() before the
+ *  decode kernels, kept verbatim as the reference for all of them.
+ */
+Return baselineReturn(const LaserCorrection& corrections, uint16_t raw_distance, uint8_t raw_intensity,
+                      float distance_resolution, float cos_rot, float sin_rot)
+{
+  Return r;
+  if (raw_distance == 0)  // no valid laser beam return
+  {
+    r.x = r.y = r.z = r.distance = r.intensity = nanf("");
+    return r;
+  }
+
+  float distance = raw_distance * distance_resolution;
+  distance += corrections.dist_correction;
+
+  float cos_vert_angle = corrections.cos_vert_correction;
+  float sin_vert_angle = corrections.sin_vert_correction;
+  float cos_rot_correction = corrections.cos_rot_correction;
+  float sin_rot_correction = corrections.sin_rot_correction;
+
+  float cos_rot_angle = cos_rot * cos_rot_correction + sin_rot * sin_rot_correction;
+  float sin_rot_angle = sin_rot * cos_rot_correction - cos_rot * sin_rot_correction;
+
+  float horiz_offset = corrections.horiz_offset_correction;
+  float vert_offset = corrections.vert_offset_correction;
+
+  float xy_distance = distance * cos_vert_angle - vert_offset * sin_vert_angle;
+
+  float xx = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
+  float yy = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
+  if (xx < 0) xx = -xx;
+  if (yy < 0) yy = -yy;
+
+  float distance_corr_x = 0;
+  float distance_corr_y = 0;
+  if (corrections.two_pt_correction_available)
+  {
+    distance_corr_x = (corrections.dist_correction - corrections.dist_correction_x) * (xx - 2.4) / (25.04 - 2.4) +
+                      corrections.dist_correction_x;
+    distance_corr_x -= corrections.dist_correction;
+    distance_corr_y = (corrections.dist_correction - corrections.dist_correction_y) * (yy - 1.93) / (25.04 - 1.93) +
+                      corrections.dist_correction_y;
+    distance_corr_y -= corrections.dist_correction;
+  }
+
+  float distance_x = distance + distance_corr_x;
+  xy_distance = distance_x * cos_vert_angle - vert_offset * sin_vert_angle;
+  float x = xy_distance * sin_rot_angle - horiz_offset * cos_rot_angle;
+
+  float distance_y = distance + distance_corr_y;
+  xy_distance = distance_y * cos_vert_angle - vert_offset * sin_vert_angle;
+  float y = xy_distance * cos_rot_angle + horiz_offset * sin_rot_angle;
+
+  float z = distance_y * sin_vert_angle + vert_offset * cos_vert_angle;
+
+  float min_intensity = corrections.min_intensity;
+  float max_intensity = corrections.max_intensity;
+
+  float intensity = raw_intensity;
+
+  float focal_offset = 256 * (1 - corrections.focal_distance / 13100) * (1 - corrections.focal_distance / 13100);
+  float focal_slope = corrections.focal_slope;
+  float scaled = 1 - static_cast<float>(raw_distance) / 65535;
+  intensity += focal_slope * (std::abs(focal_offset - 256 * (scaled * scaled)));
+  intensity = (intensity < min_intensity) ? min_intensity : intensity;
+  intensity = (intensity > max_intensity) ? max_intensity : intensity;
+
+  // standard ROS coordinate system (right-hand rule)
+  r.x = y;
+  r.y = -x;
+  r.z = z;
+  r.distance = distance;
+  r.intensity = intensity;
+  return r;
+}
+
+/** @returns a and b are the same float, NaN included */
+bool sameFloat(float a, float b)
+{
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+/** \brief Expect a decoded return to match the baseline.
+ *
+ *  Bit for bit without two point correction.  The baseline computes
+ *  the two point correction in double, the decoders in float from
+ *  precomputed slopes, so with it positions may differ by up to
+ *  max_ulps units in the last place of the distance.
+ */
+void expectBaseline(const Return& expected, const PointBatch& batch, int i, int max_ulps)
+{
+  if (max_ulps == 0 || std::isnan(expected.distance))
+  {
+    EXPECT_TRUE(sameFloat(expected.x, batch.x[i])) << expected.x << " " << batch.x[i];
+    EXPECT_TRUE(sameFloat(expected.y, batch.y[i])) << expected.y << " " << batch.y[i];
+    EXPECT_TRUE(sameFloat(expected.z, batch.z[i])) << expected.z << " " << batch.z[i];
+  }
+  else
+  {
+    const float tolerance = max_ulps * (nextafterf(fabsf(expected.distance), INFINITY) - fabsf(expected.distance));
+    EXPECT_NEAR(expected.x, batch.x[i], tolerance);
+    EXPECT_NEAR(expected.y, batch.y[i], tolerance);
+    EXPECT_NEAR(expected.z, batch.z[i], tolerance);
+  }
+  EXPECT_TRUE(sameFloat(expected.distance, batch.distance[i])) << expected.distance << " " << batch.distance[i];
+  EXPECT_TRUE(sameFloat(expected.intensity, batch.intensity[i])) << expected.intensity << " " << batch.intensity[i];
+}
+
+/** compare every kernel, and decodeReturn() for each laser, with the baseline */
+void expectKernelsMatchBaseline(const Calibration& calibration, int max_ulps)
+{
+  boost::shared_ptr<DecodePlan> plan = DecodePlan::create(calibration);
+  RangeGate gate;
+
+  unsigned int seed = 7;
+  for (int n = 0; n < 500; ++n)
+  {
+    uint8_t data[3 * KERNEL_BLOCK_SIZE];
+    randomBlock(data, &seed);
+    float rotation = (rand_r(&seed) % 36000) * 0.01f * M_PI / 180;
+    float cos_rot = cosf(rotation);
+    float sin_rot = sinf(rotation);
+
+    // one return per laser, like the VLP-16 decoder
+    PointBatch batch;
+    for (int laser = 0; laser < calibration.num_lasers; ++laser)
+    {
+      int k = 3 * (laser % KERNEL_BLOCK_SIZE);
+      uint16_t raw_distance = data[k] | (data[k + 1] << 8);
+      decodeReturn(*plan, laser, raw_distance, data[k + 2], calibration.distance_resolution_m, cos_rot, sin_rot,
+                   batch, 0);
+      SCOPED_TRACE(laser);
+      expectBaseline(baselineReturn(calibration.laser_corrections[laser], raw_distance, data[k + 2],
+                                    calibration.distance_resolution_m, cos_rot, sin_rot),
+                     batch, 0, max_ulps);
+    }
+
+    // whole blocks, of sensors with 32 lasers per block
+    if (calibration.num_lasers < KERNEL_BLOCK_SIZE)
+    {
+      continue;
+    }
+    for (int kernel = DECODE_KERNEL_SCALAR; kernel <= DECODE_KERNEL_AVX2; ++kernel)
+    {
+      if (!decodeKernelSupported(static_cast<DecodeKernel>(kernel)))
+      {
+        continue;
+      }
+      SCOPED_TRACE(decodeKernelName(static_cast<DecodeKernel>(kernel)));
+      int bank_origin = (calibration.num_lasers > KERNEL_BLOCK_SIZE && n % 2) ? KERNEL_BLOCK_SIZE : 0;
+      decodeBlockKernel(static_cast<DecodeKernel>(kernel))(*plan, gate, bank_origin, data,
+                                                          calibration.distance_resolution_m, cos_rot, sin_rot,
+                                                          batch);
+      for (int j = 0, k = 0; j < KERNEL_BLOCK_SIZE; j++, k += 3)
+      {
+        SCOPED_TRACE(j + bank_origin);
+        expectBaseline(baselineReturn(calibration.laser_corrections[j + bank_origin], data[k] | (data[k + 1] << 8),
+                                      data[k + 2], calibration.distance_resolution_m, cos_rot, sin_rot),
+                       batch, j, max_ulps);
+      }
+    }
+    if (::testing::Test::HasFailure())
+    {
+      return;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////
+// Test cases
+///////////////////////////////////////////////////////////////
+
+TEST(DecodeKernels, scalar_always_supported)
+{
+  EXPECT_TRUE(decodeKernelSupported(DECODE_KERNEL_SCALAR));
+  EXPECT_TRUE(decodeKernelSupported(bestDecodeKernel()));
+}
+
+TEST(DecodeKernels, vlp32c)
+{
+  Calibration calibration(get_package_path() + "/params/VeloView-VLP-32C.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  expectKernelsMatchScalar(calibration);
+}
+
+TEST(DecodeKernels, hdl32e)
+{
+  Calibration calibration(get_package_path() + "/params/32db.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  expectKernelsMatchScalar(calibration);
+}
+
+TEST(DecodeKernels, hdl64e_s2_1)
+{
+  Calibration calibration(get_package_path() + "/params/64e_s2.1-sztaki.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  expectKernelsMatchScalar(calibration);
+}
+
+TEST(DecodeKernels, two_point_correction)
+{
+  Calibration calibration(get_package_path() + "/params/64e_utexas.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+
+  // none of the shipped calibrations uses it, so enable it for every other laser
+  for (size_t i = 0; i < calibration.laser_corrections.size(); i += 2)
+  {
+    LaserCorrection& laser = calibration.laser_corrections[i];
+    laser.two_pt_correction_available = true;
+    laser.dist_correction_x = laser.dist_correction + 0.01f * (i % 7);
+    laser.dist_correction_y = laser.dist_correction - 0.01f * (i % 5);
+  }
+  expectKernelsMatchScalar(calibration);
+}
+
+TEST(DecodeBaseline, vlp16)
+{
+  Calibration calibration(get_package_path() + "/params/VLP16db.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  expectKernelsMatchBaseline(calibration, 0);
+}
+
+TEST(DecodeBaseline, vlp32c)
+{
+  Calibration calibration(get_package_path() + "/params/VeloView-VLP-32C.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  expectKernelsMatchBaseline(calibration, 0);
+}
+
+TEST(DecodeBaseline, hdl32e)
+{
+  Calibration calibration(get_package_path() + "/params/32db.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  expectKernelsMatchBaseline(calibration, 0);
+}
+
+TEST(DecodeBaseline, hdl64e)
+{
+  const char* files[] = { "/params/64e_s2.1-sztaki.yaml", "/params/64e_s3-xiesc.yaml", "/params/64e_utexas.yaml" };
+  for (size_t i = 0; i < 3; ++i)
+  {
+    SCOPED_TRACE(files[i]);
+    Calibration calibration(get_package_path() + files[i], false);
+    ASSERT_TRUE(calibration.initialized);
+    expectKernelsMatchBaseline(calibration, 0);
+  }
+}
+
+TEST(DecodeBaseline, two_point_correction)
+{
+  Calibration calibration(get_package_path() + "/params/64e_utexas.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  for (size_t i = 0; i < calibration.laser_corrections.size(); i += 2)
+  {
+    LaserCorrection& laser = calibration.laser_corrections[i];
+    laser.two_pt_correction_available = true;
+    laser.dist_correction_x = laser.dist_correction + 0.01f * (i % 7);
+    laser.dist_correction_y = laser.dist_correction - 0.01f * (i % 5);
+  }
+  expectKernelsMatchBaseline(calibration, 1);
+}
+
+TEST(DecodePlan, derived_constants)
+{
+  Calibration calibration(get_package_path() + "/params/64e_utexas.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  boost::shared_ptr<DecodePlan> plan = DecodePlan::create(calibration);
+
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(plan.get()) % 64);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(plan->focal_offset) % 64);
+  for (int laser = 0; laser < calibration.num_lasers; ++laser)
+  {
+    const LaserCorrection& corrections = calibration.laser_corrections[laser];
+    float focal = 1 - corrections.focal_distance / 13100;
+    EXPECT_FLOAT_EQ(256 * focal * focal, plan->focal_offset[laser]);
+    EXPECT_FLOAT_EQ(corrections.vert_offset_correction * corrections.sin_vert_correction,
+                    plan->vert_offset_sin_vert[laser]);
+    EXPECT_EQ(corrections.laser_ring, plan->ring[laser]);
+    EXPECT_EQ(0u, plan->two_pt_mask[laser]);
+  }
+}
+
+TEST(DecodePlan, two_point_slope)
+{
+  Calibration calibration(get_package_path() + "/params/64e_utexas.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  LaserCorrection& laser = calibration.laser_corrections[0];
+  laser.two_pt_correction_available = true;
+  laser.dist_correction_x = laser.dist_correction + 0.05f;
+  laser.dist_correction_y = laser.dist_correction - 0.03f;
+  boost::shared_ptr<DecodePlan> plan = DecodePlan::create(calibration);
+
+  // the interpolated correction must match the original formula
+  for (float xx = 0.0f; xx < 100.0f; xx += 0.25f)
+  {
+    double expected = (laser.dist_correction - laser.dist_correction_x) * (xx - 2.4) / (25.04 - 2.4)
+                      + laser.dist_correction_x - laser.dist_correction;
+    EXPECT_NEAR(expected, plan->two_pt_slope_x[0] * (xx - DecodePlan::TWO_PT_NEAR_X) + plan->two_pt_offset_x[0],
+                1e-6);
+  }
+  for (float yy = 0.0f; yy < 100.0f; yy += 0.25f)
+  {
+    double expected = (laser.dist_correction - laser.dist_correction_y) * (yy - 1.93) / (25.04 - 1.93)
+                      + laser.dist_correction_y - laser.dist_correction;
+    EXPECT_NEAR(expected, plan->two_pt_slope_y[0] * (yy - DecodePlan::TWO_PT_NEAR_Y) + plan->two_pt_offset_y[0],
+                1e-6);
+  }
+}
+
+TEST(RangeGate, passes_every_return_by_default)
+{
+  RangeGate gate;
+  for (int laser = 0; laser < DecodePlan::MAX_LASERS; ++laser)
+  {
+    EXPECT_TRUE(gate.pass(laser, 0));
+    EXPECT_TRUE(gate.pass(laser, 1));
+    EXPECT_TRUE(gate.pass(laser, 0xffff));
+  }
+}
+
+TEST(RangeGate, exact_raw_bounds)
+{
+  Calibration calibration(get_package_path() + "/params/64e_utexas.yaml", false);
+  ASSERT_TRUE(calibration.initialized);
+  boost::shared_ptr<DecodePlan> plan = DecodePlan::create(calibration);
+  RangeGate gate;
+  gate.build(plan->dist_correction, calibration.distance_resolution_m, 2.0, 60.0);
+
+  // a return passes exactly if the distance decoded from it is in range
+  PointBatch batch;
+  for (int laser = 0; laser < calibration.num_lasers; ++laser)
+  {
+    for (uint32_t raw = 1; raw <= 0xffff; ++raw)
+    {
+      decodeReturn(*plan, laser, raw, 0, calibration.distance_resolution_m, 1.0f, 0.0f, batch, 0);
+      bool in_range = batch.distance[0] >= 2.0 && batch.distance[0] <= 60.0;
+      ASSERT_EQ(in_range, gate.pass(laser, raw)) << "laser " << laser << " raw " << raw;
+    }
+  }
+}
+
+TEST(RangeGate, lower_bound_from_min_range_only)
+{
+  // raw distance 0 is in a range starting at 0, with an exact resolution
+  RangeGate gate;
+  gate.build(NULL, 0.25f, 0.0, 100.0);
+  EXPECT_TRUE(gate.pass(0, 0));
+  EXPECT_TRUE(gate.pass(0, 400));
+  EXPECT_FALSE(gate.pass(0, 401));
+
+  // and out of one starting above it
+  gate.build(NULL, 0.25f, 0.25, 100.0);
+  EXPECT_FALSE(gate.pass(0, 0));
+  EXPECT_TRUE(gate.pass(0, 1));
+
+  // with a distance correction, raw 0 decodes to the correction
+  float correction[DecodePlan::MAX_LASERS] = { 0.5f };
+  gate.build(correction, 0.25f, 0.4, 100.0);
+  EXPECT_TRUE(gate.pass(0, 0));
+  gate.build(correction, 0.25f, 0.6, 100.0);
+  EXPECT_FALSE(gate.pass(0, 0));
+
+  // nothing is in a range below every raw distance
+  gate.build(correction, 0.25f, 0.0, 0.4);
+  EXPECT_FALSE(gate.pass(0, 0));
+  EXPECT_FALSE(gate.pass(0, 0xffff));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
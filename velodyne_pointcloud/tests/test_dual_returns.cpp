@@ -0,0 +1,246 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <ros/package.h>
+#include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/pointcloudXYZIRT.h>
+#include <velodyne_pointcloud/organized_cloudXYZIRT.h>
+
+#include <string.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using velodyne_pointcloud::OrganizedCloudXYZIRT;
+using velodyne_pointcloud::PointcloudXYZIRT;
+using namespace velodyne_rawdata;  // NOLINT
+
+namespace
+{
+std::string get_package_path()
+{
+  std::string g_package_name("velodyne_pointcloud");
+  return ros::package::getPath(g_package_name);
+}
+
+void setReturn(raw_block_t& block, int laser, uint16_t distance, uint8_t intensity)
+{
+  block.data[laser * RAW_SCAN_SIZE] = distance & 0xff;
+  block.data[laser * RAW_SCAN_SIZE + 1] = distance >> 8;
+  block.data[laser * RAW_SCAN_SIZE + 2] = intensity;
+}
+
+/** HDL-32E dual return packet, the strongest return of the odd lasers repeats the last one */
+velodyne_msgs::VelodynePacket dualPacket()
+{
+  velodyne_msgs::VelodynePacket packet;
+  memset(&packet.data[0], 0, packet.data.size());
+  raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+  for (int i = 0; i < BLOCKS_PER_PACKET; ++i)
+  {
+    raw_block_t& block = raw->blocks[i];
+    block.header = UPPER_BANK;
+    block.rotation = 1000 + 20 * (i / 2);
+    for (int laser = 0; laser < SCANS_PER_BLOCK; ++laser)
+    {
+      if (i % 2 == 0)
+      {
+        setReturn(block, laser, 2500, 50);  // last: 5 m
+      }
+      else if (laser % 2 == 1)
+      {
+        setReturn(block, laser, 2500, 50);  // repeated
+      }
+      else
+      {
+        setReturn(block, laser, 1500, 80);  // strongest: 3 m, brighter
+      }
+    }
+  }
+  packet.data[RETURN_MODE_OFFSET] = RETURN_MODE_DUAL;
+  return packet;
+}
+
+class DualReturnPacket : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    raw_.setParameters(0.4, 130.0, 0.0, 2 * M_PI);
+    ASSERT_EQ(0, raw_.setupOffline(get_package_path() + "/params/32db.yaml", "32E", 130.0, 0.4));
+    scan_.reset(new velodyne_msgs::VelodyneScan);
+    scan_->header.frame_id = "velodyne";
+    scan_->packets.push_back(dualPacket());
+  }
+
+  const sensor_msgs::PointCloud2& decode(DualReturns returns)
+  {
+    raw_.setDualReturns(returns);
+    container_.reset(new PointcloudXYZIRT(130.0, 0.4, "", "", raw_.scansPerPacket()));
+    container_->setup(scan_);
+    raw_.unpack(scan_->packets[0], *container_, scan_->header.stamp);
+    return container_->finishCloud();
+  }
+
+  const sensor_msgs::PointCloud2& decodeOrganized(DualReturns returns, unsigned int lasers)
+  {
+    raw_.setDualReturns(returns);
+    container_.reset(new OrganizedCloudXYZIRT(130.0, 0.4, "", "", lasers, raw_.scansPerPacket()));
+    container_->setLinesPerPacket(raw_.linesPerPacket());
+    container_->setup(scan_);
+    raw_.unpack(scan_->packets[0], *container_, scan_->header.stamp);
+    return container_->finishCloud();
+  }
+
+  /** a row per line in every return mode, with valid points in lines of them */
+  void expectOrganizedRows(DualReturns returns, unsigned int lasers, size_t lines)
+  {
+    const sensor_msgs::PointCloud2& cloud = decodeOrganized(returns, lasers);
+    ASSERT_EQ(static_cast<uint32_t>(raw_.linesPerPacket()), cloud.height);
+    ASSERT_EQ(lasers, cloud.width);
+    size_t valid_rows = 0;
+    for (size_t row = 0; row < cloud.height; ++row)
+    {
+      size_t valid = 0;
+      for (size_t column = 0; column < cloud.width; ++column)
+      {
+        valid += !std::isnan(field(cloud, row * cloud.width + column, 0));
+      }
+      valid_rows += (valid > 0);
+    }
+    EXPECT_EQ(lines, valid_rows);
+  }
+
+  float field(const sensor_msgs::PointCloud2& cloud, size_t point, int offset)
+  {
+    float value;
+    memcpy(&value, &cloud.data[point * cloud.point_step + offset], sizeof(value));
+    return value;
+  }
+
+  RawData raw_;
+  velodyne_msgs::VelodyneScan::Ptr scan_;
+  boost::shared_ptr<DataContainerBase> container_;
+};
+}  // namespace
+
+TEST_F(DualReturnPacket, bothWithoutRepeatedReturns)
+{
+  const sensor_msgs::PointCloud2& cloud = decode(DUAL_RETURNS_BOTH);
+  EXPECT_EQ(6u * 32u + 6u * 16u, cloud.width);
+}
+
+TEST_F(DualReturnPacket, lastOnly)
+{
+  const sensor_msgs::PointCloud2& cloud = decode(DUAL_RETURNS_LAST);
+  ASSERT_EQ(6u * 32u, cloud.width);
+  for (size_t i = 0; i < cloud.width; ++i)
+  {
+    EXPECT_FLOAT_EQ(50.0f, field(cloud, i, 12)) << "point " << i;
+  }
+}
+
+TEST_F(DualReturnPacket, strongestOnly)
+{
+  const sensor_msgs::PointCloud2& cloud = decode(DUAL_RETURNS_STRONGEST);
+  ASSERT_EQ(6u * 32u, cloud.width);
+  for (size_t i = 0; i < cloud.width; ++i)
+  {
+    // the last return where it is the strongest one
+    EXPECT_FLOAT_EQ(i % 2 == 0 ? 80.0f : 50.0f, field(cloud, i, 12)) << "point " << i;
+  }
+}
+
+TEST_F(DualReturnPacket, pairsShareFiringTimes)
+{
+  const sensor_msgs::PointCloud2& cloud = decode(DUAL_RETURNS_BOTH);
+  ASSERT_EQ(6u * 32u + 6u * 16u, cloud.width);
+
+  // the first points of both blocks of the second pair
+  const size_t first_last = 32 + 16;
+  const size_t first_strongest = 32 + 16 + 32;
+  const float last_time = field(cloud, first_last, 18);
+  EXPECT_NEAR(46.080e-6f, last_time, 1e-9f);
+  EXPECT_FLOAT_EQ(last_time, field(cloud, first_strongest, 18));
+}
+
+TEST_F(DualReturnPacket, vlp16LastOnly)
+{
+  ASSERT_EQ(0, raw_.setupOffline(get_package_path() + "/params/VLP16db.yaml", "VLP16", 130.0, 0.4));
+  const sensor_msgs::PointCloud2& cloud = decode(DUAL_RETURNS_LAST);
+  ASSERT_EQ(6u * 32u, cloud.width);
+
+  // the second firing of a block follows one firing cycle later
+  EXPECT_FLOAT_EQ(field(cloud, 0, 18) + 55.296e-6f, field(cloud, 16, 18));
+}
+
+TEST_F(DualReturnPacket, organizedBoth)
+{
+  expectOrganizedRows(DUAL_RETURNS_BOTH, 32, 12);
+  ASSERT_EQ(0, raw_.setupOffline(get_package_path() + "/params/VLP16db.yaml", "VLP16", 130.0, 0.4));
+  expectOrganizedRows(DUAL_RETURNS_BOTH, 16, 24);
+}
+
+TEST_F(DualReturnPacket, organizedLast)
+{
+  expectOrganizedRows(DUAL_RETURNS_LAST, 32, 6);
+  ASSERT_EQ(0, raw_.setupOffline(get_package_path() + "/params/VLP16db.yaml", "VLP16", 130.0, 0.4));
+  expectOrganizedRows(DUAL_RETURNS_LAST, 16, 12);
+}
+
+TEST_F(DualReturnPacket, organizedStrongest)
+{
+  expectOrganizedRows(DUAL_RETURNS_STRONGEST, 32, 6);
+  ASSERT_EQ(0, raw_.setupOffline(get_package_path() + "/params/VLP16db.yaml", "VLP16", 130.0, 0.4));
+  expectOrganizedRows(DUAL_RETURNS_STRONGEST, 16, 12);
+}
+
+TEST(DualReturnNames, parses)
+{
+  DualReturns returns = DUAL_RETURNS_BOTH;
+  EXPECT_TRUE(RawData::parseDualReturns("strongest", returns));
+  EXPECT_EQ(DUAL_RETURNS_STRONGEST, returns);
+  EXPECT_TRUE(RawData::parseDualReturns("last", returns));
+  EXPECT_EQ(DUAL_RETURNS_LAST, returns);
+  EXPECT_TRUE(RawData::parseDualReturns("both", returns));
+  EXPECT_EQ(DUAL_RETURNS_BOTH, returns);
+  EXPECT_FALSE(RawData::parseDualReturns("first", returns));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,151 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/point_transform.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+using velodyne_rawdata::PointTransform;
+
+namespace
+{
+const float TOLERANCE = 1e-4f;
+
+Eigen::Affine3f pose(float angle, float x)
+{
+  return Eigen::Translation3f(x, 2.0f, -1.0f) * Eigen::AngleAxisf(angle, Eigen::Vector3f(0.3f, 0.4f, 0.866f).normalized());
+}
+
+struct Points
+{
+  explicit Points(int n) : x(n), y(n), z(n)
+  {
+    unsigned int seed = 1;
+    for (int i = 0; i < n; ++i)
+    {
+      x[i] = rand_r(&seed) % 10000 * 0.01f - 50.0f;
+      y[i] = rand_r(&seed) % 10000 * 0.01f - 50.0f;
+      z[i] = rand_r(&seed) % 1000 * 0.01f - 5.0f;
+    }
+  }
+  std::vector<float> x, y, z;
+};
+}  // namespace
+
+TEST(PointTransform, matches_affine)
+{
+  // more than one chunk, not a multiple of the chunk size
+  const int n = 77;
+  const Eigen::Affine3f m = pose(0.7f, 3.0f);
+  Points in(n);
+  Points out(n);
+  velodyne_rawdata::transformPoints(m.matrix().topRows<3>(), &in.x[0], &in.y[0], &in.z[0], n,
+                                    &out.x[0], &out.y[0], &out.z[0]);
+  for (int i = 0; i < n; ++i)
+  {
+    Eigen::Vector3f p = m * Eigen::Vector3f(in.x[i], in.y[i], in.z[i]);
+    EXPECT_NEAR(p.x(), out.x[i], TOLERANCE);
+    EXPECT_NEAR(p.y(), out.y[i], TOLERANCE);
+    EXPECT_NEAR(p.z(), out.z[i], TOLERANCE);
+  }
+}
+
+TEST(PointTransform, in_place)
+{
+  const int n = 32;
+  const Eigen::Affine3f m = pose(-1.2f, 0.5f);
+  Points in(n);
+  Points out(n);
+  velodyne_rawdata::transformPoints(m.matrix().topRows<3>(), &out.x[0], &out.y[0], &out.z[0], n,
+                                    &out.x[0], &out.y[0], &out.z[0]);
+  for (int i = 0; i < n; ++i)
+  {
+    Eigen::Vector3f p = m * Eigen::Vector3f(in.x[i], in.y[i], in.z[i]);
+    EXPECT_NEAR(p.x(), out.x[i], TOLERANCE);
+    EXPECT_NEAR(p.y(), out.y[i], TOLERANCE);
+    EXPECT_NEAR(p.z(), out.z[i], TOLERANCE);
+  }
+}
+
+TEST(PointTransform, blended_ends_are_exact)
+{
+  const int n = 2;
+  const PointTransform m0 = pose(0.1f, 1.0f).matrix().topRows<3>();
+  const PointTransform m1 = pose(0.2f, 2.0f).matrix().topRows<3>();
+  const float s[n] = {0.0f, 1.0f};
+  Points in(n);
+  Points out(n);
+  velodyne_rawdata::transformPointsBlended(m0, m1, s, &in.x[0], &in.y[0], &in.z[0], n, &out.x[0], &out.y[0],
+                                           &out.z[0]);
+  Eigen::Vector3f p = m0 * Eigen::Vector3f(in.x[0], in.y[0], in.z[0]).homogeneous();
+  EXPECT_NEAR(p.x(), out.x[0], TOLERANCE);
+  EXPECT_NEAR(p.z(), out.z[0], TOLERANCE);
+  p = m1 * Eigen::Vector3f(in.x[1], in.y[1], in.z[1]).homogeneous();
+  EXPECT_NEAR(p.y(), out.y[1], TOLERANCE);
+  EXPECT_NEAR(p.z(), out.z[1], TOLERANCE);
+}
+
+TEST(PointTransform, blending_during_a_block)
+{
+  // a block lasts about 50 us, turning at 1 rad/s and driving at 30 m/s
+  const int n = 32;
+  const float duration = 50e-6f;
+  const Eigen::Affine3f m0 = pose(0.0f, 0.0f);
+  std::vector<float> s(n);
+  Points in(n);
+  Points out(n);
+  for (int i = 0; i < n; ++i)
+  {
+    s[i] = i / (n - 1.0f);
+  }
+  velodyne_rawdata::transformPointsBlended(m0.matrix().topRows<3>(),
+                                           pose(duration, 30.0f * duration).matrix().topRows<3>(), &s[0],
+                                           &in.x[0], &in.y[0], &in.z[0], n, &out.x[0], &out.y[0], &out.z[0]);
+  for (int i = 0; i < n; ++i)
+  {
+    Eigen::Vector3f p = pose(s[i] * duration, s[i] * 30.0f * duration) * Eigen::Vector3f(in.x[i], in.y[i], in.z[i]);
+    EXPECT_NEAR(p.x(), out.x[i], TOLERANCE);
+    EXPECT_NEAR(p.y(), out.y[i], TOLERANCE);
+    EXPECT_NEAR(p.z(), out.z[i], TOLERANCE);
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
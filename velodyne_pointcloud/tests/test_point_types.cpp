@@ -0,0 +1,162 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/point_types.h>
+#include <velodyne_pointcloud/pointcloudXYZIRT.h>
+#include <velodyne_pointcloud/organized_cloudXYZIRT.h>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using velodyne_rawdata::PointBatch;
+namespace layout = velodyne_pointcloud::layout;
+
+namespace
+{
+const sensor_msgs::PointField* findField(const sensor_msgs::PointCloud2& cloud, const std::string& name)
+{
+  for (size_t i = 0; i < cloud.fields.size(); ++i)
+  {
+    if (cloud.fields[i].name == name)
+    {
+      return &cloud.fields[i];
+    }
+  }
+  return NULL;
+}
+
+template <typename T>
+T readField(const sensor_msgs::PointCloud2& cloud, size_t point, const std::string& name)
+{
+  T value;
+  std::memcpy(&value, &cloud.data[point * cloud.point_step + findField(cloud, name)->offset], sizeof(T));
+  return value;
+}
+
+velodyne_msgs::VelodyneScan::Ptr scanOf(size_t packets)
+{
+  velodyne_msgs::VelodyneScan::Ptr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.frame_id = "velodyne";
+  scan->packets.resize(packets);
+  return scan;
+}
+
+PointBatch batchOf(int points)
+{
+  PointBatch batch;
+  batch.clear();
+  for (int i = 0; i < points; ++i)
+  {
+    // every third return out of range, gated by the decoder
+    batch.add(i, 2 * i, 3 * i, i, 100 + i, i % 3 == 0 ? nanf("") : 10.0f, 0.5f * i, 1e-6f * i);
+  }
+  return batch;
+}
+}  // namespace
+
+TEST(PointTypes, keepsXYZIRTLayout)
+{
+  // as built from varargs PointFields before
+  velodyne_pointcloud::PointcloudXYZIRT container(100.0, 1.0, "", "", 384);
+  const sensor_msgs::PointCloud2& cloud = container.cloud;
+  ASSERT_EQ(6u, cloud.fields.size());
+  EXPECT_EQ(22u, cloud.point_step);
+  const char* names[] = { "x", "y", "z", "intensity", "ring", "time" };
+  const uint32_t offsets[] = { 0, 4, 8, 12, 16, 18 };
+  for (int i = 0; i < 6; ++i)
+  {
+    EXPECT_EQ(names[i], cloud.fields[i].name);
+    EXPECT_EQ(offsets[i], cloud.fields[i].offset);
+    EXPECT_EQ(1u, cloud.fields[i].count);
+  }
+  EXPECT_EQ(sensor_msgs::PointField::UINT16, cloud.fields[4].datatype);
+  EXPECT_EQ(sensor_msgs::PointField::FLOAT32, cloud.fields[5].datatype);
+}
+
+TEST(PointTypes, describesOwnFieldsOnly)
+{
+  std::vector<sensor_msgs::PointField> fields;
+  layout::PointXYZ::describe(fields);
+  EXPECT_EQ(3u, fields.size());
+  EXPECT_EQ(12u, sizeof(layout::PointXYZ));
+
+  fields.clear();
+  layout::PointXYZIRTA::describe(fields);
+  ASSERT_EQ(7u, fields.size());
+  EXPECT_EQ("azimuth", fields[6].name);
+  EXPECT_EQ(22u, fields[6].offset);
+  EXPECT_EQ(24u, sizeof(layout::PointXYZIRTA));
+}
+
+TEST(PointTypes, densePointsInRange)
+{
+  velodyne_pointcloud::DensePointcloud<layout::PointXYZIRTA> container(100.0, 1.0, "", "", 384);
+  container.setup(scanOf(1));
+  container.addPoints(batchOf(9));
+  const sensor_msgs::PointCloud2& cloud = container.finishCloud();
+
+  ASSERT_EQ(6u, cloud.width);
+  EXPECT_EQ(1u, cloud.height);
+  EXPECT_EQ(6u * 24u, cloud.data.size());
+  EXPECT_FLOAT_EQ(1.0f, readField<float>(cloud, 0, "x"));
+  EXPECT_FLOAT_EQ(4.0f, readField<float>(cloud, 1, "y"));
+  EXPECT_EQ(2, readField<uint16_t>(cloud, 1, "ring"));
+  EXPECT_EQ(108, readField<uint16_t>(cloud, 5, "azimuth"));
+  EXPECT_FLOAT_EQ(2.5f, readField<float>(cloud, 3, "intensity"));
+}
+
+TEST(PointTypes, organizedKeepsOutOfRangeAsNaN)
+{
+  velodyne_pointcloud::OrganizedPointcloud<layout::PointXYZ> container(100.0, 1.0, "", "", 4, 384);
+  container.setup(scanOf(1));
+  container.addPoints(batchOf(4));
+  container.newLine();
+  const sensor_msgs::PointCloud2& cloud = container.finishCloud();
+
+  ASSERT_EQ(4u, cloud.width);
+  EXPECT_EQ(1u, cloud.height);
+  EXPECT_EQ(4u * 12u, cloud.data.size());
+  EXPECT_TRUE(std::isnan(readField<float>(cloud, 0, "x")));
+  EXPECT_FLOAT_EQ(6.0f, readField<float>(cloud, 2, "z"));
+  EXPECT_TRUE(std::isnan(readField<float>(cloud, 3, "z")));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
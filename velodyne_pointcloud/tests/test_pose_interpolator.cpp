@@ -0,0 +1,119 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/pose_interpolator.h>
+
+#include <math.h>
+
+using velodyne_rawdata::PoseInterpolator;
+
+namespace
+{
+const float TOLERANCE = 1e-5f;
+
+// a vehicle driving 1 m along x and turning 90 degrees about z
+void driveAndTurn(PoseInterpolator& motion)
+{
+  motion.addSample(-0.1f, Eigen::Quaternionf::Identity(), Eigen::Vector3f(0, 0, 0));
+  motion.addSample(0.0f, Eigen::Quaternionf(Eigen::AngleAxisf(M_PI / 2, Eigen::Vector3f::UnitZ())),
+                   Eigen::Vector3f(1, 0, 0));
+}
+}  // namespace
+
+TEST(PoseInterpolator, identity_without_samples)
+{
+  PoseInterpolator motion;
+  EXPECT_TRUE(motion.empty());
+  EXPECT_TRUE(motion.poseAt(0.0f).isApprox(Eigen::Affine3f::Identity()));
+}
+
+TEST(PoseInterpolator, samples_are_exact)
+{
+  PoseInterpolator motion;
+  driveAndTurn(motion);
+  ASSERT_EQ(2u, motion.size());
+
+  Eigen::Vector3f p = motion.poseAt(-0.1f) * Eigen::Vector3f(1, 0, 0);
+  EXPECT_NEAR(1.0f, p.x(), TOLERANCE);
+  EXPECT_NEAR(0.0f, p.y(), TOLERANCE);
+
+  p = motion.poseAt(0.0f) * Eigen::Vector3f(1, 0, 0);
+  EXPECT_NEAR(1.0f, p.x(), TOLERANCE);
+  EXPECT_NEAR(1.0f, p.y(), TOLERANCE);
+}
+
+TEST(PoseInterpolator, interpolates_between_samples)
+{
+  PoseInterpolator motion;
+  driveAndTurn(motion);
+
+  const Eigen::Affine3f& pose = motion.poseAt(-0.05f);
+  EXPECT_NEAR(0.5f, pose.translation().x(), TOLERANCE);
+  EXPECT_NEAR(M_PI / 4, Eigen::AngleAxisf(pose.linear()).angle(), TOLERANCE);
+  EXPECT_NEAR(1.0f, Eigen::AngleAxisf(pose.linear()).axis().z(), TOLERANCE);
+
+  // going back in time
+  EXPECT_NEAR(0.25f, motion.poseAt(-0.075f).translation().x(), TOLERANCE);
+}
+
+TEST(PoseInterpolator, holds_nearest_sample_outside)
+{
+  PoseInterpolator motion;
+  driveAndTurn(motion);
+  EXPECT_NEAR(0.0f, motion.poseAt(-0.2f).translation().x(), TOLERANCE);
+  EXPECT_NEAR(1.0f, motion.poseAt(0.001f).translation().x(), TOLERANCE);
+}
+
+TEST(PoseInterpolator, finds_segments)
+{
+  PoseInterpolator motion;
+  for (int i = 0; i < 5; ++i)
+  {
+    motion.addSample(0.025f * i, Eigen::Quaternionf::Identity(), Eigen::Vector3f(i * i, 0, 0));
+  }
+  // out of order samples are ignored
+  motion.addSample(0.05f, Eigen::Quaternionf::Identity(), Eigen::Vector3f(100, 0, 0));
+  EXPECT_EQ(5u, motion.size());
+
+  EXPECT_NEAR(12.5f, motion.poseAt(0.0875f).translation().x(), 1e-4f);
+  EXPECT_NEAR(0.5f, motion.poseAt(0.0125f).translation().x(), 1e-4f);
+  EXPECT_NEAR(6.5f, motion.poseAt(0.0625f).translation().x(), 1e-4f);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
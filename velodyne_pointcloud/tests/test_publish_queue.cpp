@@ -0,0 +1,198 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/publish_queue.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using velodyne_pointcloud::PublishQueue;
+
+namespace
+{
+/** Records what was published, blocked until released. */
+class Subscriber
+{
+public:
+  Subscriber() : released_(0)
+  {
+  }
+
+  void publish(const sensor_msgs::PointCloud2ConstPtr& cloud)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    release_.wait(lock, [this] { return released_ > 0; });
+    --released_;
+    clouds_.push_back(cloud);
+    published_.notify_all();
+  }
+
+  void release(int clouds)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    released_ += clouds;
+    release_.notify_all();
+  }
+
+  void waitFor(size_t clouds)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    published_.wait(lock, [this, clouds] { return clouds_.size() >= clouds; });
+  }
+
+  PublishQueue::Publish callback()
+  {
+    return [this](const sensor_msgs::PointCloud2ConstPtr& cloud) { publish(cloud); };
+  }
+
+  std::vector<sensor_msgs::PointCloud2ConstPtr> clouds_;
+
+private:
+  std::mutex mutex_;
+  std::condition_variable release_;
+  std::condition_variable published_;
+  int released_;
+};
+
+void fill(sensor_msgs::PointCloud2& cloud, uint32_t width)
+{
+  cloud.width = width;
+  cloud.height = 1;
+  cloud.point_step = 1;
+  cloud.data.assign(width, static_cast<uint8_t>(width));
+}
+}  // namespace
+
+TEST(PublishQueue, publishesInOrder)
+{
+  Subscriber subscriber;
+  subscriber.release(100);
+  {
+    PublishQueue queue(subscriber.callback(), 2, 4);
+    sensor_msgs::PointCloud2 cloud;
+    for (uint32_t i = 1; i <= 10; ++i)
+    {
+      fill(cloud, i);
+      queue.push(cloud);
+    }
+    subscriber.waitFor(10);
+  }
+
+  ASSERT_EQ(10u, subscriber.clouds_.size());
+  for (uint32_t i = 1; i <= 10; ++i)
+  {
+    EXPECT_EQ(i, subscriber.clouds_[i - 1]->width);
+    EXPECT_EQ(std::vector<uint8_t>(i, i), subscriber.clouds_[i - 1]->data);
+  }
+}
+
+TEST(PublishQueue, publishesWithoutCopy)
+{
+  Subscriber subscriber;
+  subscriber.release(1);
+  PublishQueue queue(subscriber.callback(), 1, 4);
+  sensor_msgs::PointCloud2 cloud;
+  fill(cloud, 1000);
+  const uint8_t* points = cloud.data.data();
+  queue.push(cloud);
+  subscriber.waitFor(1);
+  EXPECT_EQ(points, subscriber.clouds_[0]->data.data());
+}
+
+TEST(PublishQueue, recyclesReleasedMessages)
+{
+  Subscriber subscriber;
+  subscriber.release(3);
+  PublishQueue queue(subscriber.callback(), 1, 4);
+  sensor_msgs::PointCloud2 cloud;
+  fill(cloud, 1000);
+  const uint8_t* first = cloud.data.data();
+  queue.push(cloud);
+  subscriber.waitFor(1);
+
+  // still held by the subscriber, so the cloud gets a new buffer
+  fill(cloud, 1000);
+  queue.push(cloud);
+  subscriber.waitFor(2);
+  EXPECT_TRUE(cloud.data.empty());
+  EXPECT_EQ(std::vector<uint8_t>(1000, static_cast<uint8_t>(1000)), subscriber.clouds_[0]->data);
+
+  // once released, its buffer is used again
+  subscriber.clouds_.clear();
+  fill(cloud, 10);
+  queue.push(cloud);
+  EXPECT_EQ(first, cloud.data.data());
+}
+
+TEST(PublishQueue, keepsPoolBounded)
+{
+  Subscriber subscriber;
+  subscriber.release(100);
+  PublishQueue queue(subscriber.callback(), 1, 0);
+  sensor_msgs::PointCloud2 cloud;
+  fill(cloud, 10);
+  queue.push(cloud);
+  subscriber.waitFor(1);
+  subscriber.clouds_.clear();
+
+  // nothing kept for recycling
+  fill(cloud, 10);
+  queue.push(cloud);
+  EXPECT_TRUE(cloud.data.empty());
+  subscriber.waitFor(1);
+}
+
+TEST(PublishQueue, stopsWithCloudsQueued)
+{
+  Subscriber subscriber;
+  subscriber.release(3);
+  {
+    PublishQueue queue(subscriber.callback(), 3, 4);
+    sensor_msgs::PointCloud2 cloud;
+    for (uint32_t i = 1; i <= 3; ++i)
+    {
+      fill(cloud, i);
+      queue.push(cloud);
+    }
+  }
+  EXPECT_GE(3u, subscriber.clouds_.size());
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
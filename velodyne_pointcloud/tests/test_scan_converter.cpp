@@ -0,0 +1,212 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <ros/package.h>
+#include <velodyne_pointcloud/scan_converter.h>
+
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using velodyne_pointcloud::OrderedConversion;
+using velodyne_pointcloud::PointcloudXYZIRT;
+using velodyne_pointcloud::ScanConverterPool;
+using namespace velodyne_rawdata;  // NOLINT
+
+namespace
+{
+std::string get_package_path()
+{
+  std::string g_package_name("velodyne_pointcloud");
+  return ros::package::getPath(g_package_name);
+}
+
+/** HDL-32E scan of pseudo-random returns */
+velodyne_msgs::VelodyneScan::ConstPtr randomScan(int n, unsigned int* seed)
+{
+  velodyne_msgs::VelodyneScan::Ptr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.frame_id = "velodyne";
+  scan->header.stamp = ros::Time(100 + n, 0);
+  for (int p = 0; p < 10; ++p)
+  {
+    velodyne_msgs::VelodynePacket packet;
+    packet.stamp = scan->header.stamp;
+    raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+    for (int i = 0; i < BLOCKS_PER_PACKET; ++i)
+    {
+      raw->blocks[i].header = UPPER_BANK;
+      raw->blocks[i].rotation = (p * BLOCKS_PER_PACKET + i) * 20;
+      for (int k = 0; k < BLOCK_DATA_SIZE; ++k)
+      {
+        raw->blocks[i].data[k] = rand_r(seed) % 256;
+      }
+    }
+    scan->packets.push_back(packet);
+  }
+  return scan;
+}
+
+/** a scan converted to a cloud, or a copied message */
+struct Output
+{
+  bool is_cloud;
+  ros::Time stamp;
+  std::vector<uint8_t> data;
+  int message;
+};
+
+class ScanConversion : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    data_.setParameters(0.4, 130.0, 0.0, 2 * M_PI);
+    ASSERT_EQ(0, data_.setupOffline(get_package_path() + "/params/32db.yaml", "32E", 130.0, 0.4));
+
+    unsigned int seed = 7;
+    for (int n = 0; n < 8; ++n)
+    {
+      scans_.push_back(randomScan(n, &seed));
+    }
+  }
+
+  /** converts every scan on the calling thread, each followed by 100
+   *  messages of a busy topic, like an IMU */
+  std::vector<Output> convertSequentially()
+  {
+    std::vector<Output> outputs;
+    PointcloudXYZIRT container(130.0, 0.4, "", "", data_.scansPerPacket());
+    for (size_t n = 0; n < scans_.size(); ++n)
+    {
+      container.setup(scans_[n]);
+      for (size_t i = 0; i < scans_[n]->packets.size(); ++i)
+      {
+        data_.unpack(scans_[n]->packets[i], container, scans_[n]->header.stamp);
+      }
+      const sensor_msgs::PointCloud2& cloud = container.finishCloud();
+      EXPECT_LT(0u, cloud.width);
+      Output output = { true, scans_[n]->header.stamp, cloud.data, 0 };
+      outputs.push_back(output);
+      for (int m = 0; m < 100; ++m)
+      {
+        Output copied = { false, ros::Time(), std::vector<uint8_t>(), 100 * static_cast<int>(n) + m };
+        outputs.push_back(copied);
+      }
+    }
+    return outputs;
+  }
+
+  std::vector<Output> convert(unsigned int threads, size_t max_scans)
+  {
+    std::vector<Output> outputs;
+    ScanConverterPool pool(data_, 130.0, 0.4, threads);
+    OrderedConversion<int> conversion(
+        pool, max_scans,
+        [&outputs](const ros::Time& stamp, const sensor_msgs::PointCloud2Ptr& cloud) {
+          Output output = { true, stamp, cloud->data, 0 };
+          outputs.push_back(output);
+        },
+        [&outputs](const int& message) {
+          Output output = { false, ros::Time(), std::vector<uint8_t>(), message };
+          outputs.push_back(output);
+        });
+    for (size_t n = 0; n < scans_.size(); ++n)
+    {
+      conversion.addScan(scans_[n]);
+      for (int m = 0; m < 100; ++m)
+      {
+        conversion.addMessage(100 * n + m);
+      }
+    }
+    conversion.flush();
+    EXPECT_EQ(scans_.size() * 101, conversion.written());
+    return outputs;
+  }
+
+  RawData data_;
+  std::vector<velodyne_msgs::VelodyneScan::ConstPtr> scans_;
+};
+}  // namespace
+
+TEST_F(ScanConversion, matchesSequentialConversion)
+{
+  const std::vector<Output> expected = convertSequentially();
+  const unsigned int threads[] = { 1, 2, 4 };
+  for (size_t t = 0; t < 3; ++t)
+  {
+    SCOPED_TRACE(threads[t]);
+    const std::vector<Output> actual = convert(threads[t], 2 * threads[t]);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+      ASSERT_EQ(expected[i].is_cloud, actual[i].is_cloud) << "output " << i;
+      EXPECT_EQ(expected[i].stamp, actual[i].stamp) << "output " << i;
+      EXPECT_EQ(expected[i].message, actual[i].message) << "output " << i;
+      EXPECT_TRUE(expected[i].data == actual[i].data) << "output " << i;
+    }
+  }
+}
+
+TEST_F(ScanConversion, reportsFailedInput)
+{
+  ScanConverterPool pool(data_, 130.0, 0.4, 2);
+  OrderedConversion<int> conversion(
+      pool, 4, [](const ros::Time&, const sensor_msgs::PointCloud2Ptr&) {},
+      [](const int& message) {
+        if (message == 3)
+        {
+          throw std::runtime_error("cannot write");
+        }
+      });
+  conversion.addScan(scans_[0]);
+  conversion.addMessage(1);
+  conversion.addMessage(2);
+  EXPECT_THROW(
+      {
+        conversion.addMessage(3);
+        conversion.flush();
+      },
+      std::runtime_error);
+  // the scan and two messages before
+  EXPECT_EQ(3u, conversion.written());
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,85 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/timing_tables.h>
+
+using velodyne_rawdata::BlockTimings;
+using velodyne_rawdata::SequenceTimings;
+using velodyne_rawdata::makeTimingTable;
+namespace timing = velodyne_rawdata::timing;
+
+// tables are generated by the compiler
+constexpr BlockTimings VLP16 = makeTimingTable<12, 32>(timing::vlp16, false);
+constexpr BlockTimings VLP16_DUAL = makeTimingTable<12, 32>(timing::vlp16, true);
+constexpr BlockTimings HDL32E_DUAL = makeTimingTable<12, 32>(timing::hdl32e, true);
+constexpr SequenceTimings VLS128 = makeTimingTable<3, 17>(timing::vls128, false);
+static_assert(VLP16.offset[0] == 0.0f, "first firing is at the packet time");
+
+TEST(TimingTables, layout)
+{
+  EXPECT_EQ(12 * 32 * sizeof(float), sizeof(BlockTimings));
+  EXPECT_EQ(0u, reinterpret_cast<size_t>(VLP16.offset) % 64);
+  EXPECT_EQ(&VLP16.offset[3 * 32], VLP16.row(3));
+  EXPECT_EQ(&VLS128.offset[2 * 17], VLS128.row(2));
+}
+
+TEST(TimingTables, vlp16)
+{
+  // block 1 holds firings 2 and 3, lasers fire 2.304 us apart
+  EXPECT_FLOAT_EQ(2 * 55.296e-6 + 5 * 2.304e-6, VLP16.row(1)[5]);
+  EXPECT_FLOAT_EQ(3 * 55.296e-6 + 5 * 2.304e-6, VLP16.row(1)[16 + 5]);
+  // both returns of a firing share its time
+  EXPECT_FLOAT_EQ(VLP16_DUAL.row(2)[7], VLP16_DUAL.row(3)[7]);
+  EXPECT_FLOAT_EQ(VLP16.row(1)[16 + 5], VLP16_DUAL.row(2)[16 + 5]);
+}
+
+TEST(TimingTables, hdl32e)
+{
+  // lasers fire in pairs, blocks of both returns in pairs too
+  EXPECT_FLOAT_EQ(HDL32E_DUAL.row(4)[6], HDL32E_DUAL.row(5)[7]);
+  EXPECT_FLOAT_EQ(2 * 46.080e-6 + 3 * 1.152e-6, HDL32E_DUAL.row(5)[7]);
+}
+
+TEST(TimingTables, vls128)
+{
+  EXPECT_FLOAT_EQ(-8.7e-6, VLS128.row(0)[0]);
+  EXPECT_FLOAT_EQ(2 * 53.3e-6 + 16 * 2.665e-6 - 8.7e-6, VLS128.row(2)[16]);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,116 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/transform_cache.h>
+
+#include <string>
+
+using velodyne_rawdata::TransformCache;
+
+namespace
+{
+const std::string TARGET = "base_link";
+const std::string SOURCE = "velodyne";
+
+Eigen::Affine3f shifted(float x)
+{
+  return Eigen::Affine3f(Eigen::Translation3f(x, 0.0f, 0.0f));
+}
+}  // namespace
+
+TEST(TransformCache, empty_misses)
+{
+  TransformCache cache;
+  Eigen::Affine3f matrix;
+  EXPECT_FALSE(cache.find(TARGET, SOURCE, ros::Time(10.0), matrix));
+  EXPECT_TRUE(cache.staticCheckDue(TARGET, SOURCE, ros::Time(10.0)));
+  EXPECT_EQ(0u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+}
+
+TEST(TransformCache, static_transforms_hit_at_any_time)
+{
+  TransformCache cache;
+  cache.setStatic(TARGET, SOURCE, ros::Time(10.0), true, shifted(1.0f));
+  EXPECT_TRUE(cache.isStatic(TARGET, SOURCE));
+  EXPECT_EQ(1u, cache.staticPairs());
+
+  Eigen::Affine3f matrix;
+  ASSERT_TRUE(cache.find(TARGET, SOURCE, ros::Time(10.5), matrix));
+  EXPECT_FLOAT_EQ(1.0f, matrix.translation().x());
+  EXPECT_TRUE(cache.find(TARGET, SOURCE, ros::Time(9.5), matrix));
+  EXPECT_FALSE(cache.find(SOURCE, TARGET, ros::Time(10.0), matrix));
+  EXPECT_EQ(2u, cache.hits());
+  EXPECT_EQ(1u, cache.misses());
+
+  // checked again later
+  EXPECT_FALSE(cache.find(TARGET, SOURCE, ros::Time(11.5), matrix));
+  EXPECT_TRUE(cache.staticCheckDue(TARGET, SOURCE, ros::Time(11.5)));
+}
+
+TEST(TransformCache, dynamic_transforms_hit_at_the_same_time)
+{
+  TransformCache cache;
+  cache.setStatic(TARGET, SOURCE, ros::Time(10.0), false, Eigen::Affine3f::Identity());
+  EXPECT_FALSE(cache.staticCheckDue(TARGET, SOURCE, ros::Time(10.5)));
+  cache.insert(TARGET, SOURCE, ros::Time(10.1), shifted(2.0f));
+
+  Eigen::Affine3f matrix;
+  ASSERT_TRUE(cache.find(TARGET, SOURCE, ros::Time(10.1), matrix));
+  EXPECT_FLOAT_EQ(2.0f, matrix.translation().x());
+  EXPECT_FALSE(cache.find(TARGET, SOURCE, ros::Time(10.1001), matrix));
+}
+
+TEST(TransformCache, dynamic_transforms_hit_in_buckets)
+{
+  TransformCache cache(0.01);
+  for (int i = 0; i < 10; ++i)
+  {
+    cache.insert(TARGET, SOURCE, ros::Time(100, i * 10000000), shifted(i));
+  }
+
+  // only the most recent buckets are kept
+  Eigen::Affine3f matrix;
+  ASSERT_TRUE(cache.find(TARGET, SOURCE, ros::Time(100, 95100000), matrix));
+  EXPECT_FLOAT_EQ(9.0f, matrix.translation().x());
+  EXPECT_TRUE(cache.find(TARGET, SOURCE, ros::Time(100, 25000000), matrix));
+  EXPECT_FALSE(cache.find(TARGET, SOURCE, ros::Time(100, 5000000), matrix));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,216 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <ros/package.h>
+#include <velodyne_pointcloud/rawdata.h>
+#include <velodyne_pointcloud/pointcloudXYZIRT.h>
+#include <velodyne_pointcloud/organized_cloudXYZIRT.h>
+
+#include <stddef.h>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+using velodyne_pointcloud::layout::PointXYZIRTA;
+using namespace velodyne_rawdata;  // NOLINT
+
+namespace
+{
+std::string get_package_path()
+{
+  std::string g_package_name("velodyne_pointcloud");
+  return ros::package::getPath(g_package_name);
+}
+
+/** single return packet, blocks 0.4 degrees apart from rotation on, all returns at 5 m */
+velodyne_msgs::VelodynePacket packet(int rotation)
+{
+  velodyne_msgs::VelodynePacket packet;
+  memset(&packet.data[0], 0, packet.data.size());
+  raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+  for (int i = 0; i < BLOCKS_PER_PACKET; ++i)
+  {
+    raw_block_t& block = raw->blocks[i];
+    block.header = UPPER_BANK;
+    block.rotation = (rotation + 40 * i) % ROTATION_MAX_UNITS;
+    for (int k = 0; k < BLOCK_DATA_SIZE; k += RAW_SCAN_SIZE)
+    {
+      block.data[k] = 2500 & 0xff;
+      block.data[k + 1] = 2500 >> 8;
+      block.data[k + 2] = 50;
+    }
+  }
+  return packet;
+}
+
+/** VLS-128 single return packet, four banks per firing sequence 0.2 degrees apart */
+velodyne_msgs::VelodynePacket vls128Packet(int rotation)
+{
+  const uint16_t banks[] = { VLS128_BANK_1, VLS128_BANK_2, VLS128_BANK_3, VLS128_BANK_4 };
+  velodyne_msgs::VelodynePacket packet = ::packet(rotation);
+  raw_packet_t* raw = reinterpret_cast<raw_packet_t*>(&packet.data[0]);
+  for (int i = 0; i < BLOCKS_PER_PACKET; ++i)
+  {
+    raw->blocks[i].header = banks[i % 4];
+    raw->blocks[i].rotation = (rotation + 20 * (i / 4)) % ROTATION_MAX_UNITS;
+  }
+  return packet;
+}
+
+/** writes a VLS-128 calibration, none is shipped */
+std::string writeVls128Calibration()
+{
+  char name[] = "/tmp/test_view_window_XXXXXX";
+  int fd = mkstemp(name);
+  EXPECT_GE(fd, 0);
+  FILE* file = fdopen(fd, "w");
+  fprintf(file, "lasers:\n");
+  for (int laser = 0; laser < 128; ++laser)
+  {
+    fprintf(file,
+            "- {dist_correction: 0.0, dist_correction_x: 0.0, dist_correction_y: 0.0, focal_distance: 0.0,\n"
+            "  focal_slope: 0.0, horiz_offset_correction: 0.0, laser_id: %d, rot_correction: 0.0,\n"
+            "  vert_correction: %f, vert_offset_correction: 0.0}\n",
+            laser, (laser - 64) * 0.003);
+  }
+  fprintf(file, "num_lasers: 128\ndistance_resolution: 0.004\n");
+  fclose(file);
+  return name;
+}
+
+class ViewWindow : public ::testing::TestWithParam<const char*>
+{
+protected:
+  /** decodes a packet from rotation on, within view_width around view_direction */
+  const sensor_msgs::PointCloud2& decode(int rotation, double view_direction, double view_width)
+  {
+    const std::string model = GetParam();
+    const std::string calibration = model == "VLP16" ? "/params/VLP16db.yaml" : "/params/32db.yaml";
+    raw_.setParameters(0.4, 130.0, view_direction, view_width);
+    EXPECT_EQ(0, raw_.setupOffline(get_package_path() + calibration, model, 130.0, 0.4));
+
+    velodyne_msgs::VelodyneScan::Ptr scan(new velodyne_msgs::VelodyneScan);
+    scan->header.frame_id = "velodyne";
+    scan->packets.push_back(packet(rotation));
+    container_.reset(
+        new velodyne_pointcloud::DensePointcloud<PointXYZIRTA>(130.0, 0.4, "", "", raw_.scansPerPacket()));
+    container_->setup(scan);
+    raw_.unpack(scan->packets[0], *container_, scan->header.stamp);
+    return container_->finishCloud();
+  }
+
+  uint16_t azimuth(const sensor_msgs::PointCloud2& cloud, size_t point)
+  {
+    uint16_t value;
+    memcpy(&value, &cloud.data[point * cloud.point_step + offsetof(PointXYZIRTA, azimuth)], sizeof(value));
+    return value;
+  }
+
+  RawData raw_;
+  boost::shared_ptr<velodyne_pointcloud::DensePointcloud<PointXYZIRTA>> container_;
+};
+}  // namespace
+
+TEST_P(ViewWindow, fullView)
+{
+  EXPECT_EQ(12u * 32u, decode(10000, 0.0, 2 * M_PI).width);
+}
+
+// forward 90 degrees are rotations 315 to 45 degrees
+TEST_P(ViewWindow, packetOutside)
+{
+  EXPECT_EQ(0u, decode(9000, 0.0, M_PI / 2).width);
+}
+
+TEST_P(ViewWindow, packetAcrossZero)
+{
+  EXPECT_EQ(12u * 32u, decode(35900, 0.0, M_PI / 2).width);
+}
+
+// backward 90 degrees are rotations 135 to 225 degrees
+TEST_P(ViewWindow, packetAcrossBorder)
+{
+  const sensor_msgs::PointCloud2& cloud = decode(22300, M_PI, M_PI / 2);
+  EXPECT_LT(0u, cloud.width);
+  EXPECT_GT(12u * 32u, cloud.width);
+  for (size_t i = 0; i < cloud.width; ++i)
+  {
+    EXPECT_LE(13500, azimuth(cloud, i)) << "point " << i;
+    EXPECT_GE(22500, azimuth(cloud, i)) << "point " << i;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Models, ViewWindow, ::testing::Values("32E", "VLP16"));
+
+// organized clouds get a row per block, also for packets outside the window
+TEST(ViewWindowVls128, organizedPacketOutside)
+{
+  std::string calibration = writeVls128Calibration();
+  RawData raw;
+  raw.setParameters(0.4, 130.0, 0.0, M_PI / 2);
+  ASSERT_EQ(0, raw.setupOffline(calibration, "VLS128", 130.0, 0.4));
+  unlink(calibration.c_str());
+
+  velodyne_msgs::VelodyneScan::Ptr scan(new velodyne_msgs::VelodyneScan);
+  scan->header.frame_id = "velodyne";
+  scan->packets.push_back(vls128Packet(35950));
+  scan->packets.push_back(vls128Packet(9000));
+  velodyne_pointcloud::OrganizedCloudXYZIRT container(130.0, 0.4, "", "", 128, raw.scansPerPacket());
+  container.setLinesPerPacket(raw.linesPerPacket());
+  container.setup(scan);
+
+  raw.unpack(scan->packets[0], container, scan->header.stamp);
+  EXPECT_EQ(static_cast<uint32_t>(BLOCKS_PER_PACKET), container.cloud.height);
+  raw.unpack(scan->packets[1], container, scan->header.stamp);
+  EXPECT_EQ(static_cast<uint32_t>(2 * BLOCKS_PER_PACKET), container.cloud.height);
+
+  // the rows of the packet outside hold invalid points only
+  const sensor_msgs::PointCloud2& cloud = container.finishCloud();
+  for (size_t i = BLOCKS_PER_PACKET * cloud.width; i < cloud.height * cloud.width; ++i)
+  {
+    float x;
+    memcpy(&x, &cloud.data[i * cloud.point_step], sizeof(x));
+    EXPECT_TRUE(std::isnan(x)) << "point " << i;
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,102 @@
+// Copyright (C) 2019 Austin Robot Technology
+// All rights reserved.
+//
+// Software License Agreement (BSD License 2.0)
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above
+//    copyright notice, this list of conditions and the following
+//    disclaimer in the documentation and/or other materials provided
+//    with the distribution.
+//  * Neither the name of {copyright_holder} nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <velodyne_pointcloud/worker_pool.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using velodyne_rawdata::WorkerPool;
+
+TEST(WorkerPool, runsEveryPartOnce)
+{
+  WorkerPool pool(4);
+  EXPECT_EQ(4u, pool.size());
+
+  std::vector<int> runs(10, 0);
+  pool.run(runs.size(), [&runs](size_t part) { ++runs[part]; });
+  for (size_t i = 0; i < runs.size(); ++i)
+  {
+    EXPECT_EQ(1, runs[i]) << "part " << i;
+  }
+}
+
+TEST(WorkerPool, callerRunsFirstPart)
+{
+  WorkerPool pool(3);
+  std::vector<std::thread::id> ids(3);
+  pool.run(ids.size(), [&ids](size_t part) { ids[part] = std::this_thread::get_id(); });
+  EXPECT_EQ(std::this_thread::get_id(), ids[0]);
+  EXPECT_NE(ids[0], ids[1]);
+  EXPECT_NE(ids[1], ids[2]);
+}
+
+TEST(WorkerPool, runsRepeatedJobs)
+{
+  WorkerPool pool(4);
+  std::atomic<int> total(0);
+  for (int job = 0; job < 1000; ++job)
+  {
+    pool.run(job % 7, [&total](size_t part) { total += part + 1; });
+  }
+
+  int expected = 0;
+  for (int job = 0; job < 1000; ++job)
+  {
+    const int parts = job % 7;
+    expected += parts * (parts + 1) / 2;
+  }
+  EXPECT_EQ(expected, total.load());
+}
+
+TEST(WorkerPool, singleThreadRunsInline)
+{
+  WorkerPool pool(0);
+  EXPECT_EQ(1u, pool.size());
+
+  std::vector<std::thread::id> ids(3);
+  pool.run(ids.size(), [&ids](size_t part) { ids[part] = std::this_thread::get_id(); });
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    EXPECT_EQ(std::this_thread::get_id(), ids[i]);
+  }
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}